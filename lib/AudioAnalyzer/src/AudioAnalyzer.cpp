@@ -0,0 +1,58 @@
+#include "AudioAnalyzer.h"
+
+/// @brief Clears the analysis, call when a new sound starts
+void AudioAnalyzer::reset() {
+	bass = 0;
+	envelope = 0;
+	bass_envelope = 0;
+	treble_envelope = 0;
+	peak = 0;
+}
+
+/// @brief Adds a sample of the sound being played. Called for every sample, so keep it cheap.
+/// @param left The left channel sample
+/// @param right The right channel sample
+void AudioAnalyzer::addSample(int16_t left, int16_t right) {
+	int32_t mono = ((int32_t)left + right) >> 1;
+	// One-pole low-pass splits the signal into bass and treble
+	bass += ((mono << 8) - bass) >> AUDIO_ANALYZER_BASS_SHIFT;
+	int32_t low = bass >> 8;
+	int32_t high = mono - low;
+	envelope = Follow(envelope, abs(mono));
+	bass_envelope = Follow(bass_envelope, abs(low));
+	treble_envelope = Follow(treble_envelope, abs(high));
+	if (envelope > peak) {
+		peak = envelope;
+	} else {
+		peak -= peak >> AUDIO_ANALYZER_PEAK_SHIFT;
+	}
+}
+
+/// @brief Gets how loud the sound is right now, relative to the loudest part of the sound so far
+/// @return The level, from 0 (silent) to 255 (loudest)
+uint8_t AudioAnalyzer::getLevel() {
+	uint32_t current = envelope >> 16;
+	uint32_t loudest = max(peak >> 16, (uint32_t)AUDIO_ANALYZER_MIN_PEAK);
+	return min(current * 255 / loudest, (uint32_t)255);
+}
+
+/// @brief Gets the tone of the sound right now
+/// @return The balance, from 0 (all bass) to 255 (all treble)
+uint8_t AudioAnalyzer::getBalance() {
+	uint32_t low = bass_envelope >> 16;
+	uint32_t high = treble_envelope >> 16;
+	if (low + high == 0)
+		return 0;
+	return high * 255 / (low + high);
+}
+
+/// @brief Moves an envelope towards the current sample magnitude, rising quickly and falling slowly
+/// @param envelope The envelope, in 16.16 fixed point
+/// @param input The magnitude of the current sample
+/// @return The new envelope
+uint32_t AudioAnalyzer::Follow(uint32_t envelope, uint32_t input) {
+	uint32_t target = input << 16;
+	if (target > envelope)
+		return envelope + ((target - envelope) >> AUDIO_ANALYZER_ATTACK_SHIFT);
+	return envelope - ((envelope - target) >> AUDIO_ANALYZER_RELEASE_SHIFT);
+}
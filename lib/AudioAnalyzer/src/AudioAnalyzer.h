@@ -0,0 +1,50 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <Arduino.h>
+
+/// @brief Tracks the loudness and tone of the audio being played using a few integer operations per sample
+class AudioAnalyzer {
+	public:
+		void reset();
+		void addSample(int16_t left, int16_t right);
+		uint8_t getLevel();
+		uint8_t getBalance();
+
+	private:
+		/// @brief Shift of the bass low-pass filter, cuts off around 400Hz at 44.1kHz
+		#define AUDIO_ANALYZER_BASS_SHIFT 4
+
+		/// @brief Shift of the envelope attack, a few samples
+		#define AUDIO_ANALYZER_ATTACK_SHIFT 3
+
+		/// @brief Shift of the envelope release, around 50ms at 44.1kHz
+		#define AUDIO_ANALYZER_RELEASE_SHIFT 11
+
+		/// @brief Shift of the peak decay, a few seconds at 44.1kHz
+		#define AUDIO_ANALYZER_PEAK_SHIFT 17
+
+		/// @brief Smallest peak used to scale the level, keeps silence and hiss dark
+		#define AUDIO_ANALYZER_MIN_PEAK 512
+
+		/// @brief Low-passed signal, in 16.8 fixed point
+		int32_t bass = 0;
+
+		/// @brief Envelope of the whole signal, in 16.16 fixed point
+		volatile uint32_t envelope = 0;
+
+		/// @brief Envelope of the signal below the bass cutoff, in 16.16 fixed point
+		volatile uint32_t bass_envelope = 0;
+
+		/// @brief Envelope of the signal above the bass cutoff, in 16.16 fixed point
+		volatile uint32_t treble_envelope = 0;
+
+		/// @brief Slowly decaying peak of the envelope, used to scale the level to the loudness of the sound
+		volatile uint32_t peak = 0;
+
+		static uint32_t Follow(uint32_t envelope, uint32_t input);
+};
@@ -0,0 +1,43 @@
+#include "Arduino.h"
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+/// @brief Gets the time since the program started
+/// @return The time in nanoseconds
+static uint64_t uptimeNanos() {
+	static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+unsigned long millis() {
+	return uptimeNanos() / 1000000;
+}
+
+unsigned long micros() {
+	return uptimeNanos() / 1000;
+}
+
+void delay(uint32_t ms) {
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+	return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+	if (!enabled) {
+		return size;
+	}
+	return fwrite(buffer, 1, size, stdout);
+}
+
+/// @brief Gets a cycle count for profiling, wraps like the ESP32's
+/// @return The time since the program started in nanoseconds, a 1GHz clock
+uint32_t EspClass::getCycleCount() {
+	return (uint32_t)uptimeNanos();
+}
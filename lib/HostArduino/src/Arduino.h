@@ -0,0 +1,68 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+
+/// @brief The parts of the ESP32 Arduino core used by the libraries built in the native environment, for tests and benchmarks on a PC.
+/// Only builds for the native platform, see library.json.
+
+using std::abs;
+using std::max;
+using std::min;
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+
+/// @brief There is no PSRAM on a PC, so large buffers come from the heap
+/// @return Always false
+inline bool psramFound() { return false; }
+inline void* ps_malloc(size_t size) { return malloc(size); }
+inline void* ps_realloc(void* ptr, size_t size) { return realloc(ptr, size); }
+
+/// @brief Serial output, goes to stdout once begin() is called so tests and benchmarks stay quiet by default
+class HardwareSerial : public Stream {
+	public:
+		void begin(unsigned long baud) { enabled = true; }
+		size_t write(uint8_t c);
+		size_t write(const uint8_t* buffer, size_t size);
+		using Print::write;
+		int available() { return 0; }
+		int read() { return -1; }
+		int peek() { return -1; }
+
+	private:
+		/// @brief Whether output is printed
+		bool enabled = false;
+};
+
+extern HardwareSerial Serial;
+
+/// @brief The parts of the ESP class used for profiling
+class EspClass {
+	public:
+		uint32_t getCycleCount();
+		/// @brief Gets the clock the cycle count runs at
+		/// @return 1000, the cycle count is in nanoseconds on a PC
+		uint32_t getCpuFreqMHz() { return 1000; }
+};
+
+extern EspClass ESP;
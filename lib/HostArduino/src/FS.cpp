@@ -0,0 +1,178 @@
+#include "FS.h"
+#include "FSImpl.h"
+
+using namespace fs;
+
+size_t File::write(uint8_t c) {
+	if (!*this) {
+		return 0;
+	}
+	return _p->write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buf, size_t size) {
+	if (!*this) {
+		return 0;
+	}
+	return _p->write(buf, size);
+}
+
+int File::available() {
+	if (!*this) {
+		return 0;
+	}
+	return _p->size() - _p->position();
+}
+
+int File::read() {
+	if (!*this) {
+		return -1;
+	}
+	uint8_t result;
+	if (_p->read(&result, 1) != 1) {
+		return -1;
+	}
+	return result;
+}
+
+size_t File::read(uint8_t* buf, size_t size) {
+	if (!*this) {
+		return 0;
+	}
+	return _p->read(buf, size);
+}
+
+int File::peek() {
+	if (!*this) {
+		return -1;
+	}
+	size_t position = _p->position();
+	int result = read();
+	seek(position, SeekSet);
+	return result;
+}
+
+void File::flush() {
+	if (*this) {
+		_p->flush();
+	}
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+	return *this && _p->seek(pos, mode);
+}
+
+size_t File::position() const {
+	return *this ? _p->position() : 0;
+}
+
+size_t File::size() const {
+	return *this ? _p->size() : 0;
+}
+
+bool File::setBufferSize(size_t size) {
+	return *this && _p->setBufferSize(size);
+}
+
+void File::close() {
+	if (_p) {
+		_p->close();
+		_p.reset();
+	}
+}
+
+File::operator bool() const {
+	return _p && (bool)*_p;
+}
+
+time_t File::getLastWrite() {
+	return *this ? _p->getLastWrite() : 0;
+}
+
+const char* File::path() const {
+	return *this ? _p->path() : NULL;
+}
+
+const char* File::name() const {
+	return *this ? _p->name() : NULL;
+}
+
+boolean File::isDirectory(void) {
+	return *this && _p->isDirectory();
+}
+
+boolean File::seekDir(long position) {
+	return _p && _p->seekDir(position);
+}
+
+File File::openNextFile(const char* mode) {
+	if (!*this) {
+		return File();
+	}
+	return _p->openNextFile(mode);
+}
+
+String File::getNextFileName(void) {
+	return _p ? _p->getNextFileName() : String();
+}
+
+String File::getNextFileName(bool* isDir) {
+	return _p ? _p->getNextFileName(isDir) : String();
+}
+
+void File::rewindDirectory(void) {
+	if (*this) {
+		_p->rewindDirectory();
+	}
+}
+
+File FS::open(const String& path, const char* mode, const bool create) {
+	return open(path.c_str(), mode, create);
+}
+
+File FS::open(const char* path, const char* mode, const bool create) {
+	if (!_impl) {
+		return File();
+	}
+	return File(_impl->open(path, mode, create));
+}
+
+bool FS::exists(const char* path) {
+	return _impl && _impl->exists(path);
+}
+
+bool FS::exists(const String& path) {
+	return exists(path.c_str());
+}
+
+bool FS::remove(const char* path) {
+	return _impl && _impl->remove(path);
+}
+
+bool FS::remove(const String& path) {
+	return remove(path.c_str());
+}
+
+bool FS::rename(const char* pathFrom, const char* pathTo) {
+	return _impl && _impl->rename(pathFrom, pathTo);
+}
+
+bool FS::rename(const String& pathFrom, const String& pathTo) {
+	return rename(pathFrom.c_str(), pathTo.c_str());
+}
+
+bool FS::mkdir(const char* path) {
+	return _impl && _impl->mkdir(path);
+}
+
+bool FS::mkdir(const String& path) {
+	return mkdir(path.c_str());
+}
+
+bool FS::rmdir(const char* path) {
+	return _impl && _impl->rmdir(path);
+}
+
+bool FS::rmdir(const String& path) {
+	return rmdir(path.c_str());
+}
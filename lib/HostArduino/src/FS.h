@@ -0,0 +1,95 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <memory>
+#include <time.h>
+#include <Arduino.h>
+
+/// @brief The file system wrapper of the ESP32 core, so backends written against fs::FSImpl build unchanged on a PC
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+	class File;
+
+	class FileImpl;
+	typedef std::shared_ptr<FileImpl> FileImplPtr;
+	class FSImpl;
+	typedef std::shared_ptr<FSImpl> FSImplPtr;
+
+	enum SeekMode {
+		SeekSet = 0,
+		SeekCur = 1,
+		SeekEnd = 2
+	};
+
+	/// @brief An open file or directory
+	class File : public Stream {
+		public:
+			File(FileImplPtr p = FileImplPtr()) : _p(p) {}
+			size_t write(uint8_t c);
+			size_t write(const uint8_t* buf, size_t size);
+			using Print::write;
+			int available();
+			int read();
+			int peek();
+			void flush();
+			size_t read(uint8_t* buf, size_t size);
+			size_t readBytes(char* buffer, size_t length) { return read((uint8_t*)buffer, length); }
+			bool seek(uint32_t pos, SeekMode mode);
+			bool seek(uint32_t pos) { return seek(pos, SeekSet); }
+			size_t position() const;
+			size_t size() const;
+			bool setBufferSize(size_t size);
+			void close();
+			operator bool() const;
+			time_t getLastWrite();
+			const char* path() const;
+			const char* name() const;
+			boolean isDirectory(void);
+			boolean seekDir(long position);
+			File openNextFile(const char* mode = FILE_READ);
+			String getNextFileName(void);
+			String getNextFileName(bool* isDir);
+			void rewindDirectory(void);
+
+		protected:
+			/// @brief The implementation of the file, NULL if it isn't open
+			FileImplPtr _p;
+	};
+
+	/// @brief A file system
+	class FS {
+		public:
+			FS(FSImplPtr impl) : _impl(impl) {}
+			File open(const char* path, const char* mode = FILE_READ, const bool create = false);
+			File open(const String& path, const char* mode = FILE_READ, const bool create = false);
+			bool exists(const char* path);
+			bool exists(const String& path);
+			bool remove(const char* path);
+			bool remove(const String& path);
+			bool rename(const char* pathFrom, const char* pathTo);
+			bool rename(const String& pathFrom, const String& pathTo);
+			bool mkdir(const char* path);
+			bool mkdir(const String& path);
+			bool rmdir(const char* path);
+			bool rmdir(const String& path);
+
+		protected:
+			/// @brief The implementation of the file system
+			FSImplPtr _impl;
+	};
+}
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
@@ -0,0 +1,36 @@
+#include "Print.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+	size_t written = 0;
+	while (size-- && write(*buffer++)) {
+		written++;
+	}
+	return written;
+}
+
+size_t Print::printf(const char* format, ...) {
+	char small[64];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(small, sizeof(small), format, args);
+	va_end(args);
+	if (length < 0) {
+		return 0;
+	}
+	if ((size_t)length < sizeof(small)) {
+		return write((const uint8_t*)small, length);
+	}
+	char* large = (char*)malloc(length + 1);
+	if (large == NULL) {
+		return 0;
+	}
+	va_start(args, format);
+	vsnprintf(large, length + 1, format, args);
+	va_end(args);
+	size_t written = write((const uint8_t*)large, length);
+	free(large);
+	return written;
+}
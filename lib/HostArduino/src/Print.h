@@ -0,0 +1,32 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "WString.h"
+
+/// @brief Writes text and data, like the ESP32 core's Print
+class Print {
+	public:
+		virtual ~Print() {}
+		virtual size_t write(uint8_t c) = 0;
+		virtual size_t write(const uint8_t* buffer, size_t size);
+		size_t write(const char* str) { return str == NULL ? 0 : write((const uint8_t*)str, strlen(str)); }
+		virtual void flush() {}
+		size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+		size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+		size_t print(const char* str) { return write(str); }
+		size_t print(char c) { return write((uint8_t)c); }
+		size_t print(int n) { return printf("%d", n); }
+		size_t print(unsigned int n) { return printf("%u", n); }
+		size_t print(long n) { return printf("%ld", n); }
+		size_t print(unsigned long n) { return printf("%lu", n); }
+		size_t print(double n, int digits = 2) { return printf("%.*f", digits, n); }
+		template <typename T> size_t println(const T& value) { return print(value) + println(); }
+		size_t println() { return write("\r\n"); }
+};
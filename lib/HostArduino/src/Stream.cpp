@@ -0,0 +1,40 @@
+#include "Stream.h"
+#include "Arduino.h"
+
+/// @brief Reads a character, waiting up to the timeout for one
+/// @return The character, or -1 on timeout
+int Stream::timedRead() {
+	unsigned long start = millis();
+	do {
+		int c = read();
+		if (c >= 0) {
+			return c;
+		}
+	} while (millis() - start < _timeout);
+	return -1;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+	size_t count = 0;
+	while (count < length) {
+		int c = timedRead();
+		if (c < 0) {
+			break;
+		}
+		*buffer++ = (char)c;
+		count++;
+	}
+	return count;
+}
+
+/// @brief Reads characters until the timeout, one at a time like the ESP32 core
+/// @return The characters read
+String Stream::readString() {
+	String ret;
+	int c = timedRead();
+	while (c >= 0) {
+		ret += (char)c;
+		c = timedRead();
+	}
+	return ret;
+}
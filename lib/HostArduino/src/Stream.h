@@ -0,0 +1,27 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include "Print.h"
+
+/// @brief Reads and writes text and data, like the ESP32 core's Stream
+class Stream : public Print {
+	public:
+		virtual int available() = 0;
+		virtual int read() = 0;
+		virtual int peek() = 0;
+		void setTimeout(unsigned long timeout) { _timeout = timeout; }
+		unsigned long getTimeout() { return _timeout; }
+		virtual size_t readBytes(char* buffer, size_t length);
+		size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+		String readString();
+
+	protected:
+		/// @brief Milliseconds to wait for more data, the ESP32 core waits this long at the end of a file too
+		unsigned long _timeout = 1000;
+
+		int timedRead();
+};
@@ -0,0 +1,200 @@
+#include "WString.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+String::String(const char* cstr) {
+	if (cstr != NULL) {
+		copy(cstr, strlen(cstr));
+	}
+}
+
+String::String(const char* cstr, size_t length) {
+	copy(cstr, length);
+}
+
+String::String(const String& str) {
+	copy(str.c_str(), str.len);
+}
+
+String::String(String&& str) : buffer(str.buffer), capacity(str.capacity), len(str.len) {
+	str.buffer = NULL;
+	str.capacity = 0;
+	str.len = 0;
+}
+
+String::String(char c) {
+	copy(&c, 1);
+}
+
+String::String(int value) : String((long)value) {}
+
+String::String(unsigned int value) : String((unsigned long)value) {}
+
+String::String(long value) {
+	char text[24];
+	copy(text, snprintf(text, sizeof(text), "%ld", value));
+}
+
+String::String(unsigned long value) {
+	char text[24];
+	copy(text, snprintf(text, sizeof(text), "%lu", value));
+}
+
+String::String(double value, unsigned int decimals) {
+	char text[48];
+	copy(text, snprintf(text, sizeof(text), "%.*f", decimals, value));
+}
+
+String::~String() {
+	free(buffer);
+}
+
+String& String::operator=(const String& rhs) {
+	if (this != &rhs) {
+		copy(rhs.c_str(), rhs.len);
+	}
+	return *this;
+}
+
+String& String::operator=(String&& rhs) {
+	if (this != &rhs) {
+		free(buffer);
+		buffer = rhs.buffer;
+		capacity = rhs.capacity;
+		len = rhs.len;
+		rhs.buffer = NULL;
+		rhs.capacity = 0;
+		rhs.len = 0;
+	}
+	return *this;
+}
+
+String& String::operator=(const char* cstr) {
+	copy(cstr, cstr == NULL ? 0 : strlen(cstr));
+	return *this;
+}
+
+/// @brief Makes room for a number of characters, resizing the buffer to exactly that many like the ESP32 core
+/// @param size The number of characters
+/// @return True on success
+bool String::reserve(size_t size) {
+	if (buffer != NULL && capacity >= size) {
+		return true;
+	}
+	char* resized = (char*)realloc(buffer, size + 1);
+	if (resized == NULL) {
+		return false;
+	}
+	if (buffer == NULL) {
+		resized[0] = '\0';
+	}
+	buffer = resized;
+	capacity = size;
+	return true;
+}
+
+bool String::concat(const char* cstr, size_t length) {
+	if (length == 0) {
+		return true;
+	}
+	if (cstr == NULL || !reserve(len + length)) {
+		return false;
+	}
+	memmove(buffer + len, cstr, length);
+	len += length;
+	buffer[len] = '\0';
+	return true;
+}
+
+bool String::concat(const char* cstr) {
+	return cstr != NULL && concat(cstr, strlen(cstr));
+}
+
+bool String::equals(const char* cstr) const {
+	return strcmp(c_str(), cstr == NULL ? "" : cstr) == 0;
+}
+
+bool String::operator<(const String& rhs) const {
+	return strcmp(c_str(), rhs.c_str()) < 0;
+}
+
+bool String::startsWith(const String& prefix) const {
+	return prefix.len <= len && strncmp(c_str(), prefix.c_str(), prefix.len) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+	return suffix.len <= len && strcmp(c_str() + len - suffix.len, suffix.c_str()) == 0;
+}
+
+int String::indexOf(char c, size_t from) const {
+	if (from >= len) {
+		return -1;
+	}
+	const char* found = strchr(buffer + from, c);
+	return found == NULL ? -1 : found - buffer;
+}
+
+int String::lastIndexOf(char c) const {
+	const char* found = strrchr(c_str(), c);
+	return found == NULL ? -1 : found - c_str();
+}
+
+String String::substring(size_t from, size_t to) const {
+	if (to > len) {
+		to = len;
+	}
+	if (from >= to) {
+		return String();
+	}
+	return String(buffer + from, to - from);
+}
+
+long String::toInt() const {
+	return atol(c_str());
+}
+
+/// @brief Replaces the contents of the string
+/// @param cstr The new characters
+/// @param length The number of characters
+/// @return True on success
+bool String::copy(const char* cstr, size_t length) {
+	if (length == 0) {
+		len = 0;
+		if (buffer != NULL) {
+			buffer[0] = '\0';
+		}
+		return true;
+	}
+	if (!reserve(length)) {
+		return false;
+	}
+	memmove(buffer, cstr, length);
+	len = length;
+	buffer[len] = '\0';
+	return true;
+}
+
+String operator+(const String& lhs, const String& rhs) {
+	String sum(lhs);
+	sum += rhs;
+	return sum;
+}
+
+String operator+(const String& lhs, const char* rhs) {
+	String sum(lhs);
+	sum += rhs;
+	return sum;
+}
+
+String operator+(const char* lhs, const String& rhs) {
+	String sum(lhs);
+	sum += rhs;
+	return sum;
+}
+
+String operator+(const String& lhs, char rhs) {
+	String sum(lhs);
+	sum += rhs;
+	return sum;
+}
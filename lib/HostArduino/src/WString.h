@@ -0,0 +1,70 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/// @brief A heap string like the ESP32 core's String. Each reserve resizes the buffer to exactly the length needed,
+/// as the core does, so benchmarks see the same allocations as the device.
+class String {
+	public:
+		String(const char* cstr = "");
+		String(const char* cstr, size_t length);
+		String(const String& str);
+		String(String&& str);
+		explicit String(char c);
+		explicit String(int value);
+		explicit String(unsigned int value);
+		explicit String(long value);
+		explicit String(unsigned long value);
+		explicit String(double value, unsigned int decimals = 2);
+		~String();
+		String& operator=(const String& rhs);
+		String& operator=(String&& rhs);
+		String& operator=(const char* cstr);
+		bool reserve(size_t size);
+		size_t length() const { return len; }
+		bool isEmpty() const { return len == 0; }
+		const char* c_str() const { return buffer ? buffer : ""; }
+		bool concat(const char* cstr, size_t length);
+		bool concat(const char* cstr);
+		bool concat(const String& str) { return concat(str.c_str(), str.len); }
+		bool concat(char c) { return concat(&c, 1); }
+		String& operator+=(const String& rhs) { concat(rhs); return *this; }
+		String& operator+=(const char* cstr) { concat(cstr); return *this; }
+		String& operator+=(char c) { concat(c); return *this; }
+		bool equals(const char* cstr) const;
+		bool operator==(const String& rhs) const { return equals(rhs.c_str()); }
+		bool operator==(const char* cstr) const { return equals(cstr); }
+		bool operator!=(const String& rhs) const { return !equals(rhs.c_str()); }
+		bool operator!=(const char* cstr) const { return !equals(cstr); }
+		bool operator<(const String& rhs) const;
+		char operator[](size_t index) const { return index < len ? buffer[index] : 0; }
+		bool startsWith(const String& prefix) const;
+		bool endsWith(const String& suffix) const;
+		int indexOf(char c, size_t from = 0) const;
+		int lastIndexOf(char c) const;
+		String substring(size_t from, size_t to = (size_t)-1) const;
+		long toInt() const;
+
+	private:
+		/// @brief The characters followed by a null, NULL until something is stored
+		char* buffer = NULL;
+
+		/// @brief Number of characters that fit in buffer, not counting the null
+		size_t capacity = 0;
+
+		/// @brief Number of characters in the string
+		size_t len = 0;
+
+		bool copy(const char* cstr, size_t length);
+};
+
+String operator+(const String& lhs, const String& rhs);
+String operator+(const String& lhs, const char* rhs);
+String operator+(const char* lhs, const String& rhs);
+String operator+(const String& lhs, char rhs);
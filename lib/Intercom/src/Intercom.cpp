@@ -0,0 +1,172 @@
+#include "Intercom.h"
+
+/// @brief Creates an intercom
+/// @param Server Pointer to the web server the WebSocket is added to
+Intercom::Intercom(AsyncWebServer* Server) : socket("/intercom"), ring(INTERCOM_RING_SAMPLES) {
+	server = Server;
+	listeners_mutex = xSemaphoreCreateMutex();
+}
+
+/// @brief Starts the microphone and the tasks that capture and stream it
+/// @param I2S_BCLK BCLK pin number
+/// @param I2S_WS WS pin number
+/// @param I2S_DIN Data in pin number
+/// @return True on success
+bool Intercom::begin(int I2S_BCLK, int I2S_WS, int I2S_DIN) {
+	// Set field by field, the layout of these structures changes between IDF versions
+	i2s_config_t config = {};
+	config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX);
+	config.sample_rate = INTERCOM_SAMPLE_RATE;
+	config.bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT;
+	config.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+	config.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+	config.intr_alloc_flags = ESP_INTR_FLAG_LEVEL1;
+	config.dma_buf_count = 4;
+	config.dma_buf_len = INTERCOM_READ_SAMPLES;
+	config.use_apll = false;
+	i2s_pin_config_t pins = {};
+	pins.mck_io_num = I2S_PIN_NO_CHANGE;
+	pins.bck_io_num = I2S_BCLK;
+	pins.ws_io_num = I2S_WS;
+	pins.data_out_num = I2S_PIN_NO_CHANGE;
+	pins.data_in_num = I2S_DIN;
+	if (i2s_driver_install(INTERCOM_I2S_PORT, &config, 0, NULL) != ESP_OK) {
+		return false;
+	}
+	if (i2s_set_pin(INTERCOM_I2S_PORT, &pins) != ESP_OK) {
+		i2s_driver_uninstall(INTERCOM_I2S_PORT);
+		return false;
+	}
+	// Nothing is captured until a browser listens
+	i2s_stop(INTERCOM_I2S_PORT);
+	socket.onEvent([this](AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len) {
+		onEvent(client, type);
+	});
+	server->addHandler(&socket);
+	xTaskCreatePinnedToCore(Intercom::streamTaskWrapper, "Intercom Stream", 4096, this, 1, &stream_task, 0);
+	xTaskCreatePinnedToCore(Intercom::captureTaskWrapper, "Intercom Capture", 4096, this, 2, NULL, 1);
+	return true;
+}
+
+/// @brief Wraps the capture task for static access.
+/// @param arg The Intercom object.
+void Intercom::captureTaskWrapper(void* arg) {
+	static_cast<Intercom*>(arg)->capture();
+}
+
+/// @brief Wraps the stream task for static access.
+/// @param arg The Intercom object.
+void Intercom::streamTaskWrapper(void* arg) {
+	static_cast<Intercom*>(arg)->stream();
+}
+
+/// @brief Reads the microphone into the ring buffer as an infinite loop
+void Intercom::capture() {
+	int32_t raw[INTERCOM_READ_SAMPLES];
+	int16_t samples[INTERCOM_READ_SAMPLES];
+	bool running = false;
+	while (true) {
+		if (listening != running) {
+			running = listening;
+			if (running) {
+				i2s_start(INTERCOM_I2S_PORT);
+			} else {
+				i2s_stop(INTERCOM_I2S_PORT);
+			}
+		}
+		if (!running) {
+			vTaskDelay(pdMS_TO_TICKS(50));
+			continue;
+		}
+		size_t bytes = 0;
+		i2s_read(INTERCOM_I2S_PORT, raw, sizeof(raw), &bytes, pdMS_TO_TICKS(100));
+		size_t count = bytes / sizeof(int32_t);
+		for (size_t i = 0; i < count; i++) {
+			// Remove the microphone's DC offset with a slow high-pass
+			int32_t sample = raw[i] >> INTERCOM_SAMPLE_SHIFT;
+			dc_offset += ((sample << 8) - dc_offset) >> 10;
+			sample -= dc_offset >> 8;
+			samples[i] = sample > 32767 ? 32767 : (sample < -32768 ? -32768 : sample);
+		}
+		overruns += count - ring.write(samples, count);
+		if (ring.available() >= INTERCOM_BLOCK_SAMPLES) {
+			xTaskNotifyGive(stream_task);
+		}
+	}
+}
+
+/// @brief Encodes the ring buffer and sends it to the listening browsers as an infinite loop
+void Intercom::stream() {
+	int16_t samples[INTERCOM_BLOCK_SAMPLES];
+	uint8_t block[INTERCOM_BLOCK_BYTES];
+	while (true) {
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+		socket.cleanupClients(INTERCOM_MAX_LISTENERS);
+		if (listening && socket.count() == 0) {
+			// The last browser left, stop capturing
+			listening = false;
+			Serial.println("Intercom: " + String(sent) + " blocks sent, " + String(dropped) + " not sent to slow listeners, " 
+				+ String(skipped) + " samples skipped to bound the delay, " + String(overruns) + " lost to overruns");
+			sent = 0;
+			dropped = 0;
+			skipped = 0;
+			overruns = 0;
+			ring.skip(ring.available());
+			continue;
+		}
+		size_t queued = ring.available();
+		if (queued > INTERCOM_MAX_QUEUED_SAMPLES) {
+			// Fell behind, drop the oldest audio so the delay doesn't grow
+			skipped += ring.skip(queued - INTERCOM_BLOCK_SAMPLES);
+		}
+		while (ring.available() >= INTERCOM_BLOCK_SAMPLES) {
+			ring.read(samples, INTERCOM_BLOCK_SAMPLES);
+			ChimeConverter::encodeAdpcm(samples, INTERCOM_BLOCK_SAMPLES, 1, adpcm_index, block);
+			// Every block can be decoded on its own, so a browser that's behind just misses some without holding up the others
+			uint32_t ids[INTERCOM_MAX_LISTENERS];
+			xSemaphoreTake(listeners_mutex, portMAX_DELAY);
+			size_t count = listener_count;
+			memcpy(ids, listeners, count * sizeof(uint32_t));
+			xSemaphoreGive(listeners_mutex);
+			for (size_t i = 0; i < count; i++) {
+				if (socket.availableForWrite(ids[i])) {
+					socket.binary(ids[i], block, INTERCOM_BLOCK_BYTES);
+					sent++;
+				} else {
+					dropped++;
+				}
+			}
+		}
+	}
+}
+
+/// @brief Handles browsers connecting to and disconnecting from the WebSocket
+/// @param client The browser
+/// @param type The event
+void Intercom::onEvent(AsyncWebSocketClient* client, AwsEventType type) {
+	if (type == WS_EVT_CONNECT) {
+		if (socket.count() > INTERCOM_MAX_LISTENERS) {
+			client->close();
+			return;
+		}
+		Serial.println("Intercom listener connected");
+		client->text("{\"sampleRate\":" + String(INTERCOM_SAMPLE_RATE) + ",\"blockSamples\":" + String(INTERCOM_BLOCK_SAMPLES) + "}");
+		xSemaphoreTake(listeners_mutex, portMAX_DELAY);
+		if (listener_count < INTERCOM_MAX_LISTENERS) {
+			listeners[listener_count++] = client->id();
+		}
+		xSemaphoreGive(listeners_mutex);
+		listening = true;
+	} else if (type == WS_EVT_DISCONNECT) {
+		// The stream task stops capturing once no one is listening
+		Serial.println("Intercom listener disconnected");
+		xSemaphoreTake(listeners_mutex, portMAX_DELAY);
+		for (size_t i = 0; i < listener_count; i++) {
+			if (listeners[i] == client->id()) {
+				listeners[i] = listeners[--listener_count];
+				break;
+			}
+		}
+		xSemaphoreGive(listeners_mutex);
+	}
+}
@@ -0,0 +1,98 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * External libraries needed:
+ * ESPAsyncWebServer: https://github.com/esphome/ESPAsyncWebServer
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <ChimeConverter.h>
+#include <driver/i2s.h>
+#include "SampleRing.h"
+
+/// @brief Captures a microphone on the second I2S port and streams it to browsers over a WebSocket as IMA-ADPCM
+class Intercom {
+	public:
+		Intercom(AsyncWebServer* Server);
+		bool begin(int I2S_BCLK, int I2S_WS, int I2S_DIN);
+		static void captureTaskWrapper(void* arg);
+		static void streamTaskWrapper(void* arg);
+
+	private:
+		/// @brief I2S port of the microphone, the first is used by the sound player
+		#define INTERCOM_I2S_PORT I2S_NUM_1
+
+		/// @brief Sample rate of the microphone in Hz
+		#define INTERCOM_SAMPLE_RATE 16000
+
+		/// @brief Number of samples read from I2S at a time, 16 ms
+		#define INTERCOM_READ_SAMPLES 256
+
+		/// @brief Number of samples in each ADPCM block sent, about 32 ms in 256 bytes
+		#define INTERCOM_BLOCK_SAMPLES 505
+
+		/// @brief Size in bytes of each ADPCM block sent
+		#define INTERCOM_BLOCK_BYTES (4 + (INTERCOM_BLOCK_SAMPLES - 1) / 2)
+
+		/// @brief Number of samples the ring buffer holds, about 256 ms
+		#define INTERCOM_RING_SAMPLES 4096
+
+		/// @brief Most samples allowed to wait in the ring buffer, older ones are dropped so the delay stays under about 100 ms
+		#define INTERCOM_MAX_QUEUED_SAMPLES (INTERCOM_BLOCK_SAMPLES * 3)
+
+		/// @brief Shift that turns the microphone's 32-bit samples into 16-bit samples, 2 less than 16 for 12 dB of gain
+		#define INTERCOM_SAMPLE_SHIFT 14
+
+		/// @brief Most browsers that can listen at once
+		#define INTERCOM_MAX_LISTENERS 2
+
+		/// @brief Pointer to the web server
+		AsyncWebServer* server;
+
+		/// @brief WebSocket the audio is streamed on
+		AsyncWebSocket socket;
+
+		/// @brief IDs of the browsers listening
+		uint32_t listeners[INTERCOM_MAX_LISTENERS];
+
+		/// @brief Number of browsers in listeners
+		size_t listener_count = 0;
+
+		/// @brief Protects the listeners, they're changed by the web server and read by the stream task
+		SemaphoreHandle_t listeners_mutex;
+
+		/// @brief Samples captured but not yet encoded
+		SampleRing ring;
+
+		/// @brief Task that encodes and sends the audio, woken when a block is ready
+		TaskHandle_t stream_task = NULL;
+
+		/// @brief Set while a browser is listening, nothing is captured otherwise. Cleared by the stream task.
+		volatile bool listening = false;
+
+		/// @brief DC offset of the microphone, in 16.8 fixed point
+		int32_t dc_offset = 0;
+
+		/// @brief ADPCM step index, carried from block to block
+		int32_t adpcm_index = 0;
+
+		/// @brief Samples dropped because the ring buffer was full
+		volatile uint32_t overruns = 0;
+
+		/// @brief Samples dropped to keep the delay bounded
+		uint32_t skipped = 0;
+
+		/// @brief Blocks not sent to a browser because it wasn't keeping up
+		uint32_t dropped = 0;
+
+		/// @brief Blocks sent, counted once per browser
+		uint32_t sent = 0;
+
+		void capture();
+		void stream();
+		void onEvent(AsyncWebSocketClient* client, AwsEventType type);
+};
@@ -0,0 +1,74 @@
+#include "SampleRing.h"
+#include <string.h>
+
+/// @brief Creates a ring buffer
+/// @param Capacity The number of samples it can hold, rounded up to a power of 2
+SampleRing::SampleRing(size_t Capacity) : head(0), tail(0) {
+	size_t capacity = 1;
+	while (capacity < Capacity) {
+		capacity <<= 1;
+	}
+	buffer = new int16_t[capacity];
+	mask = capacity - 1;
+}
+
+SampleRing::~SampleRing() {
+	delete[] buffer;
+}
+
+/// @brief Adds samples, called by the writer only. Samples that don't fit are dropped.
+/// @param samples The samples
+/// @param count The number of samples
+/// @return The number of samples added
+size_t SampleRing::write(const int16_t* samples, size_t count) {
+	size_t position = head.load(std::memory_order_relaxed);
+	size_t space = mask + 1 - (position - tail.load(std::memory_order_acquire));
+	count = count < space ? count : space;
+	size_t start = position & mask;
+	size_t first = count < mask + 1 - start ? count : mask + 1 - start;
+	memcpy(buffer + start, samples, first * sizeof(int16_t));
+	memcpy(buffer, samples + first, (count - first) * sizeof(int16_t));
+	// Publish the samples only once they're copied
+	head.store(position + count, std::memory_order_release);
+	return count;
+}
+
+/// @brief Takes the oldest samples, called by the reader only
+/// @param samples Receives the samples
+/// @param count The largest number of samples to take
+/// @return The number of samples taken
+size_t SampleRing::read(int16_t* samples, size_t count) {
+	size_t position = tail.load(std::memory_order_relaxed);
+	size_t stored = head.load(std::memory_order_acquire) - position;
+	count = count < stored ? count : stored;
+	size_t start = position & mask;
+	size_t first = count < mask + 1 - start ? count : mask + 1 - start;
+	memcpy(samples, buffer + start, first * sizeof(int16_t));
+	memcpy(samples + first, buffer, (count - first) * sizeof(int16_t));
+	// Free the space only once the samples are copied
+	tail.store(position + count, std::memory_order_release);
+	return count;
+}
+
+/// @brief Drops the oldest samples, called by the reader only
+/// @param count The largest number of samples to drop
+/// @return The number of samples dropped
+size_t SampleRing::skip(size_t count) {
+	size_t position = tail.load(std::memory_order_relaxed);
+	size_t stored = head.load(std::memory_order_acquire) - position;
+	count = count < stored ? count : stored;
+	tail.store(position + count, std::memory_order_release);
+	return count;
+}
+
+/// @brief Gets the number of samples waiting to be read
+/// @return The number of samples
+size_t SampleRing::available() {
+	return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
+
+/// @brief Gets the number of samples the ring can hold
+/// @return The capacity in samples
+size_t SampleRing::getCapacity() {
+	return mask + 1;
+}
@@ -0,0 +1,36 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+/// @brief Passes samples from one task to another without locking. Only one task may write and only one may read.
+/// Doesn't use Arduino, so it also builds on a PC.
+class SampleRing {
+	public:
+		SampleRing(size_t Capacity);
+		~SampleRing();
+		size_t write(const int16_t* samples, size_t count);
+		size_t read(int16_t* samples, size_t count);
+		size_t skip(size_t count);
+		size_t available();
+		size_t getCapacity();
+
+	private:
+		/// @brief The samples, capacity is a power of 2 so positions wrap with a mask
+		int16_t* buffer;
+
+		/// @brief Capacity minus one
+		size_t mask;
+
+		/// @brief Total samples written, only changed by the writer
+		std::atomic<size_t> head;
+
+		/// @brief Total samples read, only changed by the reader
+		std::atomic<size_t> tail;
+};
@@ -0,0 +1,541 @@
+#include "AnimationCompiler.h"
+
+/// @brief Creates an animation compiler
+/// @param Input The stream containing the JSON formatted animations
+/// @param Output The destination for the compiled animation records
+AnimationCompiler::AnimationCompiler(Stream* Input, Sink* Output) {
+	input = Input;
+	output = Output;
+}
+
+/// @brief Compiles every animation in the "animations" object of the input. Only one frame is held in memory at a time.
+/// An animation set to null compiles to an ANIMATION_DELETED record.
+/// @param count Set to the number of animations compiled
+/// @return True on success
+bool AnimationCompiler::CompileAnimations(uint16_t& count) {
+	count = 0;
+	if (!Expect('{'))
+		return false;
+	if (Expect('}'))
+		return true;
+	do {
+		String key;
+		if (!ReadString(&key) || !Expect(':'))
+			return false;
+		if (key == "animations") {
+			if (!Expect('{'))
+				return false;
+			if (Expect('}'))
+				continue;
+			do {
+				String name;
+				if (!ReadString(&name) || !Expect(':') || !CompileAnimation(name))
+					return false;
+				count++;
+			} while (Expect(','));
+			if (!Expect('}'))
+				return false;
+		} else if (!SkipValue()) {
+			return false;
+		}
+	} while (Expect(','));
+	return Expect('}');
+}
+
+/// @brief Checks if there is anything other than whitespace left in the input
+/// @return True if the whole input has been read
+bool AnimationCompiler::AtEnd() {
+	SkipWhitespace();
+	return input->peek() < 0;
+}
+
+/// @brief Gets the JSON name of an effect
+/// @param effect One of effects
+/// @return The name used for the effect type in animation files
+const char* AnimationCompiler::EffectName(uint32_t effect) {
+	switch (effect) {
+		case EFFECT_BREATHE:
+			return "breathe";
+		case EFFECT_CHASE:
+			return "chase";
+		case EFFECT_RAINBOW:
+			return "rainbow";
+		case EFFECT_AUDIO:
+			return "audio";
+		default:
+			return "spinner";
+	}
+}
+
+/// @brief Gets the JSON name of an easing
+/// @param easing One of easings
+/// @return The name used for the easing in animation files
+const char* AnimationCompiler::EasingName(uint32_t easing) {
+	switch (easing) {
+		case EASE_LINEAR:
+			return "linear";
+		case EASE_IN:
+			return "ease-in";
+		case EASE_OUT:
+			return "ease-out";
+		case EASE_IN_OUT:
+			return "ease-in-out";
+		default:
+			return "none";
+	}
+}
+
+/// @brief Compiles a single animation object into a record
+/// @param name The name of the animation
+/// @return True on success
+bool AnimationCompiler::CompileAnimation(const String& name) {
+	size_t start = output->position();
+	record_header record;
+	memset(&record, 0, sizeof(record));
+	record.name_length = (name.length() + 4) & ~3;
+	// Reserve the header, it is filled in once the whole animation has been read
+	const uint8_t padding[4] = {0, 0, 0, 0};
+	if (!output->write(&record, sizeof(record)) || !output->write(name.c_str(), name.length()) || !output->write(padding, record.name_length - name.length()))
+		return false;
+	SkipWhitespace();
+	if (input->peek() == 'n') {
+		if (!ReadLiteral("null"))
+			return false;
+		record.type = ANIMATION_DELETED;
+		return output->patch(start, &record, sizeof(record));
+	}
+	if (!Expect('{'))
+		return false;
+	if (!Expect('}')) {
+		do {
+			String key;
+			if (!ReadString(&key) || !Expect(':'))
+				return false;
+			if (key == "repetitions") {
+				if (!ReadNumber(record.repetitions))
+					return false;
+			} else if (key == "clearOnDone") {
+				bool clear;
+				if (!ReadBool(clear))
+					return false;
+				record.clear_on_done = clear;
+			} else if (key == "frames") {
+				// An animation is either made of frames or of an effect
+				if (record.type != ANIMATION_FRAMES || !Expect('['))
+					return false;
+				if (Expect(']'))
+					continue;
+				do {
+					if (!CompileFrame(record.data_words))
+						return false;
+					record.frame_count++;
+				} while (Expect(','));
+				if (!Expect(']'))
+					return false;
+			} else if (key == "effect") {
+				if (record.data_words != 0 || !CompileEffect(record.data_words))
+					return false;
+				record.type = ANIMATION_EFFECT;
+			} else if (!SkipValue()) {
+				return false;
+			}
+		} while (Expect(','));
+		if (!Expect('}'))
+			return false;
+	}
+	return output->patch(start, &record, sizeof(record));
+}
+
+/// @brief Compiles a single frame object and appends it to the output
+/// @param data_words Incremented by the number of words written
+/// @return True on success
+bool AnimationCompiler::CompileFrame(uint32_t& data_words) {
+	uint32_t duration = 0;
+	uint32_t easing = EASE_NONE;
+	frame_colors.clear();
+	if (!Expect('{'))
+		return false;
+	if (!Expect('}')) {
+		do {
+			String key;
+			if (!ReadString(&key) || !Expect(':'))
+				return false;
+			if (key == "duration") {
+				if (!ReadNumber(duration))
+					return false;
+			} else if (key == "colors") {
+				if (!Expect('['))
+					return false;
+				if (Expect(']'))
+					continue;
+				do {
+					uint32_t color;
+					if (!ReadColor(color))
+						return false;
+					frame_colors.push_back(color); // Gamma correction could go here
+				} while (Expect(','));
+				if (!Expect(']'))
+					return false;
+			} else if (key == "easing") {
+				char name[16];
+				if (!ReadString(name, sizeof(name)))
+					return false;
+				else if (strcmp(name, "none") == 0)
+					easing = EASE_NONE;
+				else if (strcmp(name, "linear") == 0)
+					easing = EASE_LINEAR;
+				else if (strcmp(name, "ease-in") == 0)
+					easing = EASE_IN;
+				else if (strcmp(name, "ease-out") == 0)
+					easing = EASE_OUT;
+				else if (strcmp(name, "ease-in-out") == 0)
+					easing = EASE_IN_OUT;
+				else
+					return false;
+			} else if (!SkipValue()) {
+				return false;
+			}
+		} while (Expect(','));
+		if (!Expect('}'))
+			return false;
+	}
+	if (frame_colors.size() > ANIMATION_FRAME_COLOR_MASK)
+		return false;
+	uint32_t frame[2] = { duration, (uint32_t)frame_colors.size() | easing << ANIMATION_FRAME_EASING_SHIFT };
+	if (!output->write(frame, sizeof(frame)) || !output->write(frame_colors.data(), frame_colors.size() * sizeof(uint32_t)))
+		return false;
+	data_words += 2 + frame_colors.size();
+	return true;
+}
+
+/// @brief Compiles a procedural effect object and appends its parameters to the output
+/// @param data_words Incremented by the number of words written
+/// @return True on success
+bool AnimationCompiler::CompileEffect(uint32_t& data_words) {
+	effect_params effect { EFFECT_SPINNER, 0xFFFFFF, 0, 1000, 1, 1, 0, 20 };
+	bool has_duration = false;
+	if (!Expect('{'))
+		return false;
+	if (!Expect('}')) {
+		do {
+			String key;
+			if (!ReadString(&key) || !Expect(':'))
+				return false;
+			bool success = true;
+			if (key == "type") {
+				char type[16];
+				if (!ReadString(type, sizeof(type)))
+					success = false;
+				else if (strcmp(type, "spinner") == 0)
+					effect.effect = EFFECT_SPINNER;
+				else if (strcmp(type, "breathe") == 0)
+					effect.effect = EFFECT_BREATHE;
+				else if (strcmp(type, "chase") == 0)
+					effect.effect = EFFECT_CHASE;
+				else if (strcmp(type, "rainbow") == 0)
+					effect.effect = EFFECT_RAINBOW;
+				else if (strcmp(type, "audio") == 0)
+					effect.effect = EFFECT_AUDIO;
+				else
+					success = false;
+			} else if (key == "color") {
+				success = ReadColor(effect.color);
+			} else if (key == "background") {
+				success = ReadColor(effect.background);
+			} else if (key == "period") {
+				success = ReadNumber(effect.period);
+			} else if (key == "width") {
+				success = ReadNumber(effect.width);
+			} else if (key == "direction") {
+				success = ReadInteger(effect.direction);
+				effect.direction = effect.direction < 0 ? -1 : 1;
+			} else if (key == "duration") {
+				success = ReadNumber(effect.duration);
+				has_duration = true;
+			} else if (key == "interval") {
+				success = ReadNumber(effect.interval);
+			} else {
+				success = SkipValue();
+			}
+			if (!success)
+				return false;
+		} while (Expect(','));
+		if (!Expect('}'))
+			return false;
+	}
+	// Avoid divisions by zero when rendering
+	if (effect.period == 0 || effect.interval == 0)
+		return false;
+	if (!has_duration)
+		effect.duration = effect.period;
+	if (!output->write(&effect, sizeof(effect)))
+		return false;
+	data_words += sizeof(effect) / sizeof(uint32_t);
+	return true;
+}
+
+/// @brief Consumes any whitespace at the front of the input
+void AnimationCompiler::SkipWhitespace() {
+	int c = input->peek();
+	while (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+		input->read();
+		c = input->peek();
+	}
+}
+
+/// @brief Consumes a character if it is the next non-whitespace character of the input
+/// @param c The expected character
+/// @return True if the character was consumed
+bool AnimationCompiler::Expect(char c) {
+	SkipWhitespace();
+	if (input->peek() != c)
+		return false;
+	input->read();
+	return true;
+}
+
+/// @brief Reads a JSON string of any length
+/// @param value Set to the string read, or NULL to discard it
+/// @return True on success
+bool AnimationCompiler::ReadString(String* value) {
+	if (!Expect('"'))
+		return false;
+	while (true) {
+		int c = input->read();
+		if (c < 0)
+			return false;
+		if (c == '"')
+			return true;
+		if (c == '\\') {
+			c = input->read();
+			switch (c) {
+				case 'n': c = '\n'; break;
+				case 'r': c = '\r'; break;
+				case 't': c = '\t'; break;
+				case 'b': c = '\b'; break;
+				case 'f': c = '\f'; break;
+				case 'u': {
+					// Only ASCII code points are kept as is
+					char hex[5] = {0};
+					if (input->readBytes(hex, 4) != 4)
+						return false;
+					c = strtoul(hex, NULL, 16);
+					if (c > 0x7F)
+						c = '?';
+					break;
+				}
+				case '"': case '\\': case '/': break;
+				default: return false;
+			}
+		}
+		if (value != NULL)
+			*value += (char)c;
+	}
+}
+
+/// @brief Reads a short JSON string into a fixed buffer
+/// @param buffer The buffer to read into
+/// @param length The size of the buffer, including the terminator
+/// @return True on success, false if the string is malformed or too long
+bool AnimationCompiler::ReadString(char* buffer, size_t length) {
+	if (!Expect('"'))
+		return false;
+	size_t i = 0;
+	while (true) {
+		int c = input->read();
+		if (c < 0 || c == '\\')
+			return false;
+		// A string that exactly fills the buffer still fits
+		if (c == '"')
+			break;
+		if (i == length - 1)
+			return false;
+		buffer[i++] = c;
+	}
+	buffer[i] = '\0';
+	return true;
+}
+
+/// @brief Reads a non-negative JSON number
+/// @param value Set to the number read
+/// @return True on success
+bool AnimationCompiler::ReadNumber(uint32_t& value) {
+	SkipWhitespace();
+	char buffer[24];
+	size_t i = 0;
+	int c = input->peek();
+	while (i < sizeof(buffer) - 1 && ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E')) {
+		buffer[i++] = input->read();
+		c = input->peek();
+	}
+	if (i == 0)
+		return false;
+	buffer[i] = '\0';
+	double number = strtod(buffer, NULL);
+	// Casting a double outside the range of uint32_t is undefined, so clamp first
+	if (number >= (double)UINT32_MAX)
+		value = UINT32_MAX;
+	else
+		value = number > 0 ? (uint32_t)number : 0;
+	return true;
+}
+
+/// @brief Reads a JSON number that may be negative
+/// @param value Set to the number read
+/// @return True on success
+bool AnimationCompiler::ReadInteger(int32_t& value) {
+	SkipWhitespace();
+	bool negative = input->peek() == '-';
+	if (negative)
+		input->read();
+	uint32_t magnitude;
+	if (!ReadNumber(magnitude))
+		return false;
+	if (magnitude > INT32_MAX)
+		magnitude = INT32_MAX;
+	value = negative ? -(int32_t)magnitude : (int32_t)magnitude;
+	return true;
+}
+
+/// @brief Reads a JSON boolean
+/// @param value Set to the boolean read
+/// @return True on success
+bool AnimationCompiler::ReadBool(bool& value) {
+	SkipWhitespace();
+	value = input->peek() == 't';
+	return ReadLiteral(value ? "true" : "false");
+}
+
+/// @brief Consumes a JSON literal such as true, false or null
+/// @param literal The expected literal
+/// @return True if the literal was consumed
+bool AnimationCompiler::ReadLiteral(const char* literal) {
+	SkipWhitespace();
+	for (; *literal != '\0'; literal++) {
+		if (input->read() != *literal)
+			return false;
+	}
+	return true;
+}
+
+/// @brief Reads a color given as either a string (e.g. "0x00317F") or a number
+/// @param color Set to the color read
+/// @return True on success
+bool AnimationCompiler::ReadColor(uint32_t& color) {
+	SkipWhitespace();
+	if (input->peek() == '"') {
+		char buffer[16];
+		if (!ReadString(buffer, sizeof(buffer)))
+			return false;
+		color = std::strtoul(buffer, NULL, 0);
+		return true;
+	}
+	return ReadNumber(color);
+}
+
+/// @brief Consumes a JSON value of any type without storing it
+/// @param depth The current nesting depth
+/// @return True on success
+bool AnimationCompiler::SkipValue(int depth) {
+	if (depth > ANIMATION_COMPILER_MAX_DEPTH)
+		return false;
+	SkipWhitespace();
+	switch (input->peek()) {
+		case '{':
+			input->read();
+			if (Expect('}'))
+				return true;
+			do {
+				if (!ReadString(NULL) || !Expect(':') || !SkipValue(depth + 1))
+					return false;
+			} while (Expect(','));
+			return Expect('}');
+		case '[':
+			input->read();
+			if (Expect(']'))
+				return true;
+			do {
+				if (!SkipValue(depth + 1))
+					return false;
+			} while (Expect(','));
+			return Expect(']');
+		case '"':
+			return ReadString(NULL);
+		case 't':
+			return ReadLiteral("true");
+		case 'f':
+			return ReadLiteral("false");
+		case 'n':
+			return ReadLiteral("null");
+		default:
+			uint32_t number;
+			return ReadNumber(number);
+	}
+}
+
+/// @brief Appends data to the file
+/// @param data The data to append
+/// @param size The number of bytes to append
+/// @return True on success
+bool AnimationCompiler::FileSink::write(const void* data, size_t size) {
+	return size == 0 || file.write((const uint8_t*)data, size) == size;
+}
+
+/// @brief Overwrites data that was already written to the file
+/// @param offset The offset in the file of the data to overwrite
+/// @param data The new data
+/// @param size The number of bytes to overwrite
+/// @return True on success
+bool AnimationCompiler::FileSink::patch(size_t offset, const void* data, size_t size) {
+	size_t end = file.position();
+	bool success = file.seek(offset) && file.write((const uint8_t*)data, size) == size;
+	return file.seek(end) && success;
+}
+
+/// @brief Appends data to memory, growing the buffer as needed
+/// @param data The data to append
+/// @param size The number of bytes to append
+/// @return True on success
+bool AnimationCompiler::MemorySink::write(const void* data, size_t size) {
+	if (length + size > capacity) {
+		size_t new_capacity = capacity == 0 ? 1024 : capacity;
+		while (new_capacity < length + size) {
+			new_capacity *= 2;
+		}
+		uint8_t* new_buffer = (uint8_t*)(psramFound() ? ps_realloc(buffer, new_capacity) : realloc(buffer, new_capacity));
+		if (new_buffer == NULL)
+			return false;
+		buffer = new_buffer;
+		capacity = new_capacity;
+	}
+	memcpy(buffer + length, data, size);
+	length += size;
+	return true;
+}
+
+/// @brief Overwrites data that was already written to memory
+/// @param offset The offset of the data to overwrite
+/// @param data The new data
+/// @param size The number of bytes to overwrite
+/// @return True on success
+bool AnimationCompiler::MemorySink::patch(size_t offset, const void* data, size_t size) {
+	if (offset + size > length)
+		return false;
+	memcpy(buffer + offset, data, size);
+	return true;
+}
+
+/// @brief Hands the compiled data over to the caller, who becomes responsible for freeing it
+/// @return The compiled data, shrunk to fit
+uint8_t* AnimationCompiler::MemorySink::release() {
+	uint8_t* compiled = buffer;
+	if (length > 0 && length < capacity) {
+		uint8_t* shrunk = (uint8_t*)(psramFound() ? ps_realloc(buffer, length) : realloc(buffer, length));
+		if (shrunk != NULL)
+			compiled = shrunk;
+	}
+	buffer = NULL;
+	capacity = 0;
+	length = 0;
+	return compiled;
+}
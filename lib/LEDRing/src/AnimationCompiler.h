@@ -0,0 +1,233 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+#include <vector>
+
+/// @brief Marks a compiled animation cache file ("ANIM")
+#define ANIMATION_CACHE_MAGIC 0x4D494E41
+
+/// @brief Version of the compiled animation cache layout, increment when the layout changes
+#define ANIMATION_CACHE_VERSION 3
+
+/// @brief Bits of the second word of a frame that hold the number of colors
+#define ANIMATION_FRAME_COLOR_MASK 0x00FFFFFF
+
+/// @brief Position of the easing in the second word of a frame
+#define ANIMATION_FRAME_EASING_SHIFT 24
+
+/// @brief Compiles JSON animations into packed binary records straight from a stream, one frame at a time
+class AnimationCompiler {
+	public:
+		/// @brief Header at the start of the compiled animation cache file
+		struct cache_header {
+			/// @brief Always ANIMATION_CACHE_MAGIC
+			uint32_t magic;
+
+			/// @brief Always ANIMATION_CACHE_VERSION
+			uint16_t version;
+
+			/// @brief Number of animation records that follow the header
+			uint16_t count;
+
+			/// @brief Size in bytes of the animations file this cache was compiled from
+			uint32_t source_size;
+
+			/// @brief Last write time of the animations file this cache was compiled from
+			uint32_t source_time;
+
+			/// @brief Size in bytes of the animation records that follow the header
+			uint32_t data_size;
+
+			/// @brief Size in bytes of the animations journal this cache includes
+			uint32_t journal_size;
+		};
+
+		/// @brief Kinds of compiled animations. An ANIMATION_DELETED record removes an earlier animation with the same name.
+		enum animation_types { ANIMATION_FRAMES, ANIMATION_EFFECT, ANIMATION_DELETED };
+
+		/// @brief Procedural effects that compute each frame on the fly
+		enum effects { EFFECT_SPINNER, EFFECT_BREATHE, EFFECT_CHASE, EFFECT_RAINBOW, EFFECT_AUDIO };
+
+		/// @brief How a frame fades into the next frame, EASE_NONE holds the frame without fading
+		enum easings { EASE_NONE, EASE_LINEAR, EASE_IN, EASE_OUT, EASE_IN_OUT };
+
+		/// @brief Parameters of a procedural effect, stored as the data of an ANIMATION_EFFECT animation
+		struct effect_params {
+			/// @brief The effect to render, one of effects
+			uint32_t effect;
+
+			/// @brief The main color of the effect
+			uint32_t color;
+
+			/// @brief The color of LEDs not lit by the effect
+			uint32_t background;
+
+			/// @brief Time in milliseconds for one full cycle of the effect
+			uint32_t period;
+
+			/// @brief Number of LEDs lit by a spinner, length of a chase tail, or number of hue wheels around the ring
+			uint32_t width;
+
+			/// @brief 1 to move clockwise, -1 to move counterclockwise
+			int32_t direction;
+
+			/// @brief Time in milliseconds for one repetition of the animation
+			uint32_t duration;
+
+			/// @brief Time in milliseconds between rendered frames
+			uint32_t interval;
+		};
+
+		/// @brief Header of a single compiled animation record. It is followed by the name, padded to 4 bytes,
+		/// and then the data. For frame animations, each frame is one word for the duration, one word for the color count, and then the colors.
+		/// The color count word also holds the easing of the frame above ANIMATION_FRAME_EASING_SHIFT. For effect animations, the data is an effect_params.
+		struct record_header {
+			/// @brief Length of the name in bytes, including the terminator and padding
+			uint32_t name_length;
+
+			/// @brief How many times this animation should repeat
+			uint32_t repetitions;
+
+			/// @brief Number of frames in the animation
+			uint32_t frame_count;
+
+			/// @brief Number of 32-bit words of frame data
+			uint32_t data_words;
+
+			/// @brief Whether the LEDs should be turned off after the animation or left on the last frame
+			uint8_t clear_on_done;
+
+			/// @brief The kind of animation, one of animation_types
+			uint8_t type;
+
+			/// @brief Unused, keeps the frame data aligned
+			uint8_t reserved[2];
+		};
+
+		/// @brief Represents a compiled animation, either built-in or mapped from the animation cache
+		struct animation {
+			/// @brief The name of the event or sound this animation is for
+			const char* name;
+
+			/// @brief How many times this animation should repeat
+			uint32_t repetitions;
+		
+			/// @brief Whether the LEDs should be turned off after the animation or left on the last frame
+			bool clearOnDone;
+
+			/// @brief Number of frames in the animation
+			uint32_t frame_count;
+
+			/// @brief The kind of animation, one of animation_types
+			uint8_t type;
+
+			/// @brief Packed frame data, or the effect_params, of the animation
+			const uint32_t* data;
+		};
+
+		/// @brief Destination for compiled animation records
+		class Sink {
+			public:
+				virtual ~Sink() {}
+				/// @brief Appends data to the sink
+				/// @param data The data to append
+				/// @param size The number of bytes to append
+				/// @return True on success
+				virtual bool write(const void* data, size_t size) = 0;
+				/// @brief Overwrites data that was already appended
+				/// @param offset The offset of the data to overwrite
+				/// @param data The new data
+				/// @param size The number of bytes to overwrite
+				/// @return True on success
+				virtual bool patch(size_t offset, const void* data, size_t size) = 0;
+				/// @brief Gets the number of bytes written to the sink so far
+				/// @return The current offset
+				virtual size_t position() = 0;
+		};
+
+		/// @brief Writes compiled records to a file
+		class FileSink : public Sink {
+			public:
+				FileSink(File& File) : file(File) {}
+				bool write(const void* data, size_t size);
+				bool patch(size_t offset, const void* data, size_t size);
+				size_t position() { return file.position(); }
+
+			private:
+				/// @brief The file being written
+				File& file;
+		};
+
+		/// @brief Writes compiled records to memory, preferring PSRAM
+		class MemorySink : public Sink {
+			public:
+				~MemorySink() { free(buffer); }
+				bool write(const void* data, size_t size);
+				bool patch(size_t offset, const void* data, size_t size);
+				size_t position() { return length; }
+				uint8_t* release();
+
+			private:
+				/// @brief The compiled data
+				uint8_t* buffer = NULL;
+
+				/// @brief The number of bytes allocated for the buffer
+				size_t capacity = 0;
+
+				/// @brief The number of bytes written to the buffer
+				size_t length = 0;
+		};
+
+		/// @brief Reads a null-terminated string as a stream without copying it
+		class StringSource : public Stream {
+			public:
+				StringSource(const char* Input) : input(Input) {}
+				int available() { return strlen(input); }
+				int read() { return *input == '\0' ? -1 : (uint8_t)*input++; }
+				int peek() { return *input == '\0' ? -1 : (uint8_t)*input; }
+				size_t write(uint8_t) { return 0; }
+
+			private:
+				/// @brief The next character to be read
+				const char* input;
+		};
+
+		AnimationCompiler(Stream* Input, Sink* Output);
+		bool CompileAnimations(uint16_t& count);
+		bool AtEnd();
+		static const char* EffectName(uint32_t effect);
+		static const char* EasingName(uint32_t easing);
+
+	private:
+		/// @brief Maximum nesting depth of skipped JSON values
+		#define ANIMATION_COMPILER_MAX_DEPTH 16
+
+		/// @brief The JSON being compiled
+		Stream* input;
+
+		/// @brief The destination of the compiled records
+		Sink* output;
+
+		/// @brief Holds the colors of the frame currently being compiled
+		std::vector<uint32_t> frame_colors;
+
+		bool CompileAnimation(const String& name);
+		bool CompileFrame(uint32_t& data_words);
+		bool CompileEffect(uint32_t& data_words);
+		void SkipWhitespace();
+		bool Expect(char c);
+		bool ReadString(String* value);
+		bool ReadString(char* buffer, size_t length);
+		bool ReadNumber(uint32_t& value);
+		bool ReadInteger(int32_t& value);
+		bool ReadBool(bool& value);
+		bool ReadLiteral(const char* literal);
+		bool ReadColor(uint32_t& color);
+		bool SkipValue(int depth = 0);
+};
@@ -0,0 +1,112 @@
+/*
+ * Generated from animations.json.default by scripts/generate_default_animations.py, do not edit.
+ */
+
+#pragma once
+#include <AnimationCompiler.h>
+
+/// @brief Data of the built-in BELL_RING_START animation
+static constexpr uint32_t default_BELL_RING_START_data[] = {
+	75, 16, 0x000000, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F,
+	75, 16, 0x00317F, 0x000000, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F,
+	75, 16, 0x00317F, 0x00317F, 0x000000, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F,
+	75, 16, 0x00317F, 0x00317F, 0x00317F, 0x000000, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F,
+	75, 16, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x000000, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F,
+	75, 16, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x000000, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F,
+	75, 16, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x000000, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F,
+	75, 16, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x000000, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F,
+	75, 16, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x000000, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F,
+	75, 16, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x000000, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F,
+	75, 16, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x000000, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F,
+	75, 16, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x000000, 0x00317F, 0x00317F, 0x00317F, 0x00317F,
+	75, 16, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x000000, 0x00317F, 0x00317F, 0x00317F,
+	75, 16, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x000000, 0x00317F, 0x00317F,
+	75, 16, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x000000, 0x00317F,
+	75, 16, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x00317F, 0x000000,
+};
+
+/// @brief Data of the built-in BELL_RING_END animation
+static constexpr uint32_t default_BELL_RING_END_data[] = {
+	0, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+};
+
+/// @brief Data of the built-in WIFI_CONFIG_START animation
+static constexpr uint32_t default_WIFI_CONFIG_START_data[] = {
+	50, 16, 0x00007F, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x00007F, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x00007F, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x00007F, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x00007F, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x00007F, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x00007F, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x00007F, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x00007F, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x00007F, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x00007F, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x00007F, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x00007F, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x00007F, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x00007F, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x00007F,
+	0, 16, 0x000000, 0x00007F, 0x000000, 0x00007F, 0x000000, 0x00007F, 0x000000, 0x00007F, 0x000000, 0x00007F, 0x000000, 0x00007F, 0x000000, 0x00007F, 0x000000, 0x00007F,
+};
+
+/// @brief Data of the built-in WIFI_CONFIG_END animation
+static constexpr uint32_t default_WIFI_CONFIG_END_data[] = {
+	50, 16, 0xFF7F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0xFF7F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0xFF7F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0xFF7F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0xFF7F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0xFF7F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0xFF7F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0xFF7F00, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0xFF7F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0xFF7F00, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0xFF7F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0xFF7F00, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0xFF7F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0xFF7F00, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0xFF7F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0xFF7F00,
+};
+
+/// @brief Data of the built-in UPDATED animation
+static constexpr uint32_t default_UPDATED_data[] = {
+	50, 16, 0xFF00C4, 0x000000, 0x000000, 0x000000, 0xFF00C4, 0x000000, 0x000000, 0x000000, 0xFF00C4, 0x000000, 0x000000, 0x000000, 0xFF00C4, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0xFF00C4, 0x000000, 0x000000, 0x000000, 0xFF00C4, 0x000000, 0x000000, 0x000000, 0xFF00C4, 0x000000, 0x000000, 0x000000, 0xFF00C4, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0xFF00C4, 0x000000, 0x000000, 0x000000, 0xFF00C4, 0x000000, 0x000000, 0x000000, 0xFF00C4, 0x000000, 0x000000, 0x000000, 0xFF00C4, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0xFF00C4, 0x000000, 0x000000, 0x000000, 0xFF00C4, 0x000000, 0x000000, 0x000000, 0xFF00C4, 0x000000, 0x000000, 0x000000, 0xFF00C4,
+};
+
+/// @brief Data of the built-in STORAGE_ERROR animation
+static constexpr uint32_t default_STORAGE_ERROR_data[] = {
+	50, 16, 0xFF0000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+};
+
+/// @brief Data of the built-in I2S_PLAYER_ERROR animation
+static constexpr uint32_t default_I2S_PLAYER_ERROR_data[] = {
+	50, 16, 0xFF0000, 0xFF0000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+};
+
+/// @brief Data of the built-in WEBHOOK_ERROR animation
+static constexpr uint32_t default_WEBHOOK_ERROR_data[] = {
+	50, 16, 0xFF0000, 0xFF0000, 0xFF0000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+};
+
+/// @brief Data of the built-in DOORBELL_READY animation
+static constexpr uint32_t default_DOORBELL_READY_data[] = {
+	50, 16, 0x007F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x007F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x007F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x007F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x007F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x007F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x007F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x007F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x007F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x007F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x007F00, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x007F00, 0x000000, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x007F00, 0x000000, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x007F00, 0x000000, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x007F00, 0x000000,
+	50, 16, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000, 0x007F00,
+};
+
+/// @brief The built-in animations, shown before storage is available and overridden by custom animations
+static constexpr AnimationCompiler::animation default_animations[] = {
+	{ "BELL_RING_START", 1, true, 16, AnimationCompiler::ANIMATION_FRAMES, default_BELL_RING_START_data },
+	{ "BELL_RING_END", 0, true, 1, AnimationCompiler::ANIMATION_FRAMES, default_BELL_RING_END_data },
+	{ "WIFI_CONFIG_START", 1, false, 9, AnimationCompiler::ANIMATION_FRAMES, default_WIFI_CONFIG_START_data },
+	{ "WIFI_CONFIG_END", 1, true, 8, AnimationCompiler::ANIMATION_FRAMES, default_WIFI_CONFIG_END_data },
+	{ "UPDATED", 3, true, 4, AnimationCompiler::ANIMATION_FRAMES, default_UPDATED_data },
+	{ "STORAGE_ERROR", 0, false, 1, AnimationCompiler::ANIMATION_FRAMES, default_STORAGE_ERROR_data },
+	{ "I2S_PLAYER_ERROR", 0, false, 1, AnimationCompiler::ANIMATION_FRAMES, default_I2S_PLAYER_ERROR_data },
+	{ "WEBHOOK_ERROR", 0, false, 1, AnimationCompiler::ANIMATION_FRAMES, default_WEBHOOK_ERROR_data },
+	{ "DOORBELL_READY", 0, true, 16, AnimationCompiler::ANIMATION_FRAMES, default_DOORBELL_READY_data },
+};
@@ -0,0 +1,106 @@
+#include "LEDOutput.h"
+
+rmt_item32_t LEDOutput::bit0;
+rmt_item32_t LEDOutput::bit1;
+
+/// @brief Creates an LED output
+/// @param Count Number of LEDs
+/// @param Pin Data pin of the LEDs
+/// @param Channel RMT channel to use
+LEDOutput::LEDOutput(uint16_t Count, uint8_t Pin, rmt_channel_t Channel) {
+	count = Count;
+	pin = Pin;
+	channel = Channel;
+	frame_size = count * 3;
+}
+
+LEDOutput::~LEDOutput() {
+	if (started) {
+		rmt_wait_tx_done(channel, pdMS_TO_TICKS(LED_OUTPUT_TIMEOUT));
+		rmt_driver_uninstall(channel);
+	}
+	free(back_buffer);
+	free(front_buffer);
+}
+
+/// @brief Allocates the frame buffers and starts the RMT driver
+/// @return True on success
+bool LEDOutput::begin() {
+	back_buffer = (uint8_t*)calloc(frame_size, 1);
+	front_buffer = (uint8_t*)calloc(frame_size, 1);
+	if (back_buffer == NULL || front_buffer == NULL) {
+		Serial.println("Could not allocate LED buffers");
+		return false;
+	}
+	rmt_config_t config = RMT_DEFAULT_CONFIG_TX((gpio_num_t)pin, channel);
+	config.clk_div = LED_OUTPUT_CLOCK_DIV;
+	if (rmt_config(&config) != ESP_OK || rmt_driver_install(channel, 0, 0) != ESP_OK) {
+		Serial.println("Could not start RMT driver for LEDs");
+		return false;
+	}
+	// WS2812 timings: 0 is 0.4us high and 0.85us low, 1 is 0.8us high and 0.45us low
+	uint32_t ticks_per_us = APB_CLK_FREQ / LED_OUTPUT_CLOCK_DIV / 1000000;
+	bit0.level0 = 1;
+	bit0.duration0 = 4 * ticks_per_us / 10;
+	bit0.level1 = 0;
+	bit0.duration1 = 85 * ticks_per_us / 100;
+	bit1.level0 = 1;
+	bit1.duration0 = 8 * ticks_per_us / 10;
+	bit1.level1 = 0;
+	bit1.duration1 = 45 * ticks_per_us / 100;
+	rmt_translator_init(channel, Translate);
+	started = true;
+	return true;
+}
+
+/// @brief Sets the color of an LED in the frame being built
+/// @param n The LED to set
+/// @param r Red level
+/// @param g Green level
+/// @param b Blue level
+void LEDOutput::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) {
+	if (n < count) {
+		uint8_t* pixel = back_buffer + n * 3;
+		pixel[0] = g;
+		pixel[1] = r;
+		pixel[2] = b;
+	}
+}
+
+/// @brief Starts sending the frame being built to the LEDs and returns without waiting for it to finish
+/// @return True if the frame was sent, false if it was unchanged or could not be sent
+bool LEDOutput::show() {
+	if (!started || (sent && memcmp(back_buffer, front_buffer, frame_size) == 0))
+		return false;
+	// The previous frame takes well under a millisecond for a small ring, so this rarely waits
+	if (rmt_wait_tx_done(channel, pdMS_TO_TICKS(LED_OUTPUT_TIMEOUT)) != ESP_OK)
+		return false;
+	uint8_t* frame = back_buffer;
+	back_buffer = front_buffer;
+	front_buffer = frame;
+	sent = rmt_write_sample(channel, front_buffer, frame_size, false) == ESP_OK;
+	// Start the next frame from this one so unchanged LEDs compare equal
+	memcpy(back_buffer, front_buffer, frame_size);
+	return sent;
+}
+
+/// @brief Converts pixel bytes to RMT items, called by the RMT driver as it needs more items
+/// @param src The pixel bytes
+/// @param dest The RMT items to fill
+/// @param src_size Number of bytes left to convert
+/// @param wanted_num Number of RMT items wanted
+/// @param translated_size Set to the number of bytes converted
+/// @param item_num Set to the number of RMT items filled
+void IRAM_ATTR LEDOutput::Translate(const void* src, rmt_item32_t* dest, size_t src_size, size_t wanted_num, size_t* translated_size, size_t* item_num) {
+	const uint8_t* bytes = (const uint8_t*)src;
+	size_t size = 0;
+	size_t num = 0;
+	while (size < src_size && num + 8 <= wanted_num) {
+		for (int bit = 7; bit >= 0; bit--) {
+			dest[num++].val = (bytes[size] >> bit) & 1 ? bit1.val : bit0.val;
+		}
+		size++;
+	}
+	*translated_size = size;
+	*item_num = num;
+}
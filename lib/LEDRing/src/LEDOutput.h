@@ -0,0 +1,56 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <driver/rmt.h>
+
+/// @brief Sends pixel data to WS2812 LEDs through the RMT peripheral without blocking, skipping frames that haven't changed
+class LEDOutput {
+	public:
+		LEDOutput(uint16_t Count, uint8_t Pin, rmt_channel_t Channel);
+		~LEDOutput();
+		bool begin();
+		void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b);
+		bool show();
+
+	private:
+		/// @brief RMT clock divider, 80MHz APB / 2 gives 25ns ticks
+		#define LED_OUTPUT_CLOCK_DIV 2
+
+		/// @brief Maximum time in milliseconds to wait for the previous frame to finish sending
+		#define LED_OUTPUT_TIMEOUT 10
+
+		/// @brief Number of LEDs
+		uint16_t count;
+
+		/// @brief Data pin of the LEDs
+		uint8_t pin;
+
+		/// @brief RMT channel used to send the data
+		rmt_channel_t channel;
+
+		/// @brief Number of bytes in a frame
+		size_t frame_size;
+
+		/// @brief Frame being built by setPixelColor, in GRB order
+		uint8_t* back_buffer = NULL;
+
+		/// @brief Frame being sent, or last sent, to the LEDs. Must not change while the RMT is reading it.
+		uint8_t* front_buffer = NULL;
+
+		/// @brief Whether the RMT driver is installed
+		bool started = false;
+
+		/// @brief Whether the front buffer holds a frame that was sent
+		bool sent = false;
+
+		/// @brief RMT items for a 0 and a 1 bit
+		static rmt_item32_t bit0;
+		static rmt_item32_t bit1;
+
+		static void IRAM_ATTR Translate(const void* src, rmt_item32_t* dest, size_t src_size, size_t wanted_num, size_t* translated_size, size_t* item_num);
+};
@@ -1,110 +1,724 @@
 #include "LEDRing.h"
+#include "DefaultAnimations.h"
 
-/// @brief Controls an LEDRing. Define LED pin and LED count in header file.
+/// @brief Controls an LEDRing and any other LED segments. Define the pin and LED count of the default segment in header file.
 /// @param Storage Reference to storage object
 /// @param Animations_file Path to the file storing animations
-LEDRing::LEDRing(Storage* Storage, String Animations_file) : leds(LED_COUNT, LED_PIN, NEO_GRB + NEO_KHZ800),
-event_names {"BELL_RING_START", "BELL_RING_END", "WIFI_CONFIG_START", "WIFI_CONFIG_END", "UPDATED", "STORAGE_ERROR", "I2S_PLAYER_ERROR", "WEBHOOK_ERROR", "DOORBELL_READY"}
+/// @param Settings_file Path to the file storing brightness and gamma settings
+/// @param Analyzer Reference to an AudioAnalyzer object fed with the sound being played
+LEDRing::LEDRing(Storage* Storage, String Animations_file, String Settings_file, AudioAnalyzer* Analyzer) :
+event_names {"BELL_RING_START", "BELL_RING_END", "WIFI_CONFIG_START", "WIFI_CONFIG_END", "UPDATED", "STORAGE_ERROR", "I2S_PLAYER_ERROR", "WEBHOOK_ERROR", "DOORBELL_READY"},
+event_priorities {3, 2, 1, 1, 1, 4, 4, 4, 0}
 {
 	animations_file = Animations_file;
+	// Compiled animations are stored next to the animations file
+	cache_file = animations_file.substring(0, animations_file.lastIndexOf('.')) + ".bin";
+	journal_file = animations_file.substring(0, animations_file.lastIndexOf('.')) + ".journal";
+	settings_file = Settings_file;
 	storage = Storage;
+	analyzer = Analyzer;
+	layout.push_back(segment_layout { "ring", LED_PIN, LED_COUNT });
+	segments.reserve(LED_MAX_SEGMENTS);
+	BuildOutputLevels();
 	// Create queue
-	EventQueue = xQueueCreate(10, sizeof(String*));
+	EventQueue = xQueueCreate(10, sizeof(led_event));
+	pending_events.reserve(LED_PENDING_EVENTS);
+	animations_mutex = xSemaphoreCreateMutex();
+	settings_mutex = xSemaphoreCreateMutex();
+	names_mutex = xSemaphoreCreateMutex();
+	// Events get the first IDs, so the ID of an event's animation is the event itself
+	for (const String& name : event_names) {
+		InternName(name);
+	}
+	for (const AnimationCompiler::animation& a : default_animations) {
+		InternName(a.name);
+	}
 }
 
 /// @brief Initializes the LED ring
 void LEDRing::begin() {
-	// Start LEDs
-	leds.begin();
-	leds.fill(0x7F1500); // Show while booting
-	leds.show();
+	// Start LEDs, the render loop isn't running yet
+	ConfigureSegments(layout);
+	// Show while booting
+	for (segment& seg : segments) {
+		for (uint16_t i = 0; i < seg.layout.count; i++) {
+			seg.pixels[i] = 0x7F1500;
+		}
+		ShowPixels(seg);
+	}
+}
 
-	// Load default animations
-	LoadAnimationsHelper(default_animations);
+/// @brief Loads the brightness, gamma and segment settings
+/// @return True on success
+bool LEDRing::LoadSettings() {
+	Serial.println("Loading LED settings....");
+	String content = storage->readFile(settings_file);
+	if (content != "") {
+		Serial.println("LED settings loaded.");
+		return UpdateSettings(content);
+	} else {
+		return SaveSettings();
+	}
 }
 
-/// @brief Reads the list of current custom animations
-/// @return The JSON formatted animations, or empty string on failure
+/// @brief Saves the current brightness, gamma and segment settings to the file system
+/// @return True on success
+bool LEDRing::SaveSettings() {
+	Serial.println("Saving LED settings....");
+	return storage->writeFile(settings_file, GetSettings());
+}
+
+/// @brief Gets the current brightness, gamma and segment settings
+/// @return A JSON string of the settings
+String LEDRing::GetSettings() {
+	DynamicJsonDocument settings(1024);
+	xSemaphoreTake(settings_mutex, portMAX_DELAY);
+	settings["brightness"] = brightness;
+	settings["gamma"] = gamma;
+	settings["dithering"] = dithering;
+	JsonArray segment_settings = settings.createNestedArray("segments");
+	for (const segment_layout& l : layout) {
+		JsonObject segment_setting = segment_settings.createNestedObject();
+		segment_setting["name"] = l.name;
+		segment_setting["pin"] = l.pin;
+		segment_setting["count"] = l.count;
+	}
+	xSemaphoreGive(settings_mutex);
+	String settings_string;
+	serializeJson(settings, settings_string);
+	return settings_string;
+}
+
+/// @brief Called when there are new brightness, gamma and segment settings. They are applied by the render loop.
+/// @param settings A JSON object of new parameters.
+/// @return True on success.
+bool LEDRing::UpdateSettings(String settings) {
+	if (settings != "") {
+		// Parse settings string
+		settings.trim();
+		Serial.println("New settings : " + settings);
+		DynamicJsonDocument new_settings(1024);
+		DeserializationError error = deserializeJson(new_settings, settings);
+		if (error) {
+			Serial.println("Bad settings data received");
+			return false;
+		}
+		std::vector<segment_layout> new_layout;
+		if (new_settings.containsKey("segments")) {
+			for (JsonObject segment_setting : new_settings["segments"].as<JsonArray>()) {
+				uint32_t count = segment_setting["count"] | 0;
+				if (count == 0 || count > LED_MAX_PIXELS || new_layout.size() == LED_MAX_SEGMENTS) {
+					Serial.println("Bad settings data received");
+					return false;
+				}
+				new_layout.push_back(segment_layout { segment_setting["name"] | "", (uint8_t)(segment_setting["pin"] | LED_PIN), (uint16_t)count });
+			}
+			if (new_layout.empty()) {
+				Serial.println("Bad settings data received");
+				return false;
+			}
+		}
+		xSemaphoreTake(settings_mutex, portMAX_DELAY);
+		brightness = new_settings["brightness"] | 255;
+		gamma = constrain(new_settings["gamma"] | 1.0f, 0.1f, 5.0f);
+		dithering = new_settings["dithering"] | true;
+		if (!new_layout.empty())
+			layout.swap(new_layout);
+		settings_changed = true;
+		xSemaphoreGive(settings_mutex);
+		return true;
+	}
+	return false;
+}
+
+/// @brief Applies new settings from the render loop, so the segments are never changed while they are being drawn
+void LEDRing::ApplySettings() {
+	xSemaphoreTake(settings_mutex, portMAX_DELAY);
+	settings_changed = false;
+	BuildOutputLevels();
+	bool same = layout.size() == segments.size();
+	for (size_t i = 0; same && i < layout.size(); i++) {
+		same = layout[i].name == segments[i].layout.name && layout[i].pin == segments[i].layout.pin && layout[i].count == segments[i].layout.count;
+	}
+	std::vector<segment_layout> new_layout;
+	if (!same)
+		new_layout = layout;
+	xSemaphoreGive(settings_mutex);
+	if (!same)
+		ConfigureSegments(new_layout);
+}
+
+/// @brief Replaces the LED segments, allocating all the buffers they need up front so nothing is allocated while rendering
+/// @param new_layout The name, pin and LED count of each segment
+/// @return True on success
+bool LEDRing::ConfigureSegments(const std::vector<segment_layout>& new_layout) {
+	if (playing)
+		StopAnimation();
+	for (segment& seg : segments) {
+		FreeSegment(seg);
+	}
+	segments.clear();
+	bool success = true;
+	for (size_t i = 0; i < new_layout.size(); i++) {
+		segment seg;
+		seg.layout = new_layout[i];
+		// Each segment gets its own RMT channel
+		seg.output = new LEDOutput(seg.layout.count, seg.layout.pin, (rmt_channel_t)(RMT_CHANNEL_0 + i));
+		seg.pixels = (uint32_t*)calloc(seg.layout.count, sizeof(uint32_t));
+		seg.dither_error = (uint8_t*)calloc(seg.layout.count, 3);
+		if (seg.pixels == NULL || seg.dither_error == NULL || !seg.output->begin()) {
+			Serial.println("Could not start LED segment " + seg.layout.name);
+			FreeSegment(seg);
+			success = false;
+			continue;
+		}
+		segments.push_back(seg);
+		ShowPixels(segments.back());
+	}
+	return success;
+}
+
+/// @brief Releases the LED driver and buffers of a segment
+/// @param seg The segment to free
+void LEDRing::FreeSegment(segment& seg) {
+	delete seg.output;
+	free(seg.pixels);
+	free(seg.dither_error);
+	seg.output = NULL;
+	seg.pixels = NULL;
+	seg.dither_error = NULL;
+}
+
+/// @brief Reads the list of current custom animations, including changes made to single animations
+/// @return The JSON formatted animations
 String LEDRing::GetAnimations() {
-	String animation_settings = String();
-	if (storage->fileExists(animations_file))
-		animation_settings = storage->readFile(animations_file);
-	return animation_settings;
+	// The custom set is only replaced by the web server and at boot, so it can be read without locking
+	String json;
+	json.reserve(custom_animation_set.size * 3);
+	json = "{\"animations\":{";
+	bool first = true;
+	char hex[12];
+	for (const AnimationCompiler::animation& a : custom_animation_set.index) {
+		if (!first)
+			json += ',';
+		first = false;
+		json += Storage::quoteJson(a.name) + ":{\"repetitions\":" + String(a.repetitions) + ",\"clearOnDone\":" + (a.clearOnDone ? "true" : "false");
+		if (a.type == AnimationCompiler::ANIMATION_EFFECT) {
+			const AnimationCompiler::effect_params* effect = (const AnimationCompiler::effect_params*)a.data;
+			json += ",\"effect\":{\"type\":\"" + String(AnimationCompiler::EffectName(effect->effect)) + '"';
+			snprintf(hex, sizeof(hex), "0x%06X", (unsigned int)effect->color);
+			json += ",\"color\":\"" + String(hex) + '"';
+			snprintf(hex, sizeof(hex), "0x%06X", (unsigned int)effect->background);
+			json += ",\"background\":\"" + String(hex) + '"';
+			json += ",\"period\":" + String(effect->period) + ",\"width\":" + String(effect->width) + ",\"direction\":" + String(effect->direction);
+			json += ",\"duration\":" + String(effect->duration) + ",\"interval\":" + String(effect->interval) + '}';
+		} else {
+			json += ",\"frames\":[";
+			const uint32_t* frame = a.data;
+			for (uint32_t f = 0; f < a.frame_count; f++) {
+				uint32_t count = frame[1] & ANIMATION_FRAME_COLOR_MASK;
+				uint32_t easing = frame[1] >> ANIMATION_FRAME_EASING_SHIFT;
+				json += (f == 0 ? "{\"duration\":" : ",{\"duration\":") + String(frame[0]);
+				if (easing != AnimationCompiler::EASE_NONE)
+					json += ",\"easing\":\"" + String(AnimationCompiler::EasingName(easing)) + '"';
+				json += ",\"colors\":[";
+				for (uint32_t c = 0; c < count; c++) {
+					snprintf(hex, sizeof(hex), c == 0 ? "\"0x%06X\"" : ",\"0x%06X\"", (unsigned int)frame[2 + c]);
+					json += hex;
+				}
+				json += "]}";
+				frame += 2 + count;
+			}
+			json += ']';
+		}
+		json += '}';
+	}
+	json += "}}";
+	return json;
 }
 
-/// @brief Updates and saves custom animations
+/// @brief Updates and saves custom animations, replacing all of them
 /// @param newAnimations JSON string of new custom animations
 /// @return True on success
 bool LEDRing::UpdateAnimations(String newAnimations) {
-	if (LoadAnimationsHelper(newAnimations.c_str())) {
-		return storage->writeFile(animations_file, newAnimations);
+	File cache = storage->openFile(cache_file, FILE_WRITE);
+	if (!cache) {
+		return false;
 	}
-	return false;
+	AnimationCompiler::StringSource source(newAnimations.c_str());
+	AnimationCompiler::cache_header header;
+	header.source_size = 0;
+	header.source_time = 0;
+	header.journal_size = 0;
+	bool success = CompileAnimationCache(&source, NULL, cache, header) && storage->writeFile(animations_file, newAnimations);
+	size_t source_size = 0;
+	time_t source_time = 0;
+	if (success && storage->getFileInfo(animations_file, source_size, source_time)) {
+		// Stamp the cache with the file just written so it is used on the next boot
+		header.source_size = source_size;
+		header.source_time = source_time;
+		AnimationCompiler::FileSink(cache).patch(0, &header, sizeof(header));
+	}
+	cache.close();
+	if (!success) {
+		storage->deleteFile(cache_file);
+		return false;
+	}
+	// The new animations file includes every earlier change
+	if (storage->fileExists(journal_file)) {
+		storage->deleteFile(journal_file);
+	}
+	return LoadAnimationCache(source_size, source_time, 0);
+}
+
+/// @brief Adds or replaces a single custom animation without touching the others
+/// @param name The name of the animation
+/// @param animation JSON string of the animation
+/// @return True on success
+bool LEDRing::UpdateAnimation(String name, String animation) {
+	animation.trim();
+	if (animation.isEmpty() || animation == "null") {
+		return false;
+	}
+	return PatchAnimation(name, animation);
 }
 
-/// @brief Loads the animations from the animation file
+/// @brief Deletes a single custom animation, a built-in animation with the same name is used again
+/// @param name The name of the animation
+/// @return True on success, false if there is no such custom animation
+bool LEDRing::DeleteAnimation(String name) {
+	bool exists = false;
+	for (const AnimationCompiler::animation& a : custom_animation_set.index) {
+		exists |= name == a.name;
+	}
+	if (!exists) {
+		Serial.println("No custom animation named " + name);
+		return false;
+	}
+	return PatchAnimation(name, "null");
+}
+
+/// @brief Compiles a change to a single animation, appends it to the journal and the compiled cache, and adds it to the custom animations
+/// @param name The name of the animation
+/// @param value JSON string of the animation, or null to delete it
+/// @return True on success
+bool LEDRing::PatchAnimation(const String& name, const String& value) {
+	if (name.isEmpty()) {
+		return false;
+	}
+	// A journal entry has the same layout as the animations file, so it can be compiled the same way
+	String entry = "{\"animations\":{" + Storage::quoteJson(name.c_str()) + ':' + value + "}}";
+	AnimationCompiler::StringSource source(entry.c_str());
+	AnimationCompiler::MemorySink sink;
+	AnimationCompiler compiler(&source, &sink);
+	uint16_t count;
+	if (!compiler.CompileAnimations(count) || count != 1 || !compiler.AtEnd()) {
+		Serial.println("Bad animation data");
+		return false;
+	}
+	size_t record_size = sink.position();
+	uint8_t* record = sink.release();
+	// Add the record to a copy of the custom animations, later records replace earlier ones with the same name.
+	// This is done before anything is written, so a change that can't be applied never reaches the journal.
+	animation_set patched;
+	patched.size = custom_animation_set.size + record_size;
+	patched.blob = (uint8_t*)(psramFound() ? ps_malloc(patched.size) : malloc(patched.size));
+	if (patched.blob == NULL) {
+		free(record);
+		return false;
+	}
+	if (custom_animation_set.size > 0) {
+		memcpy(patched.blob, custom_animation_set.blob, custom_animation_set.size);
+	}
+	memcpy(patched.blob + custom_animation_set.size, record, record_size);
+	uint16_t records;
+	if (!IndexAnimations(patched, records) || !storage->appendFile(journal_file, entry + '\n')) {
+		free(record);
+		FreeAnimations(patched);
+		return false;
+	}
+	size_t journal_size = 0;
+	time_t journal_time;
+	storage->getFileInfo(journal_file, journal_size, journal_time);
+	if (!AppendToCache(record, record_size, journal_size)) {
+		// The cache is rebuilt from the animations file and journal on the next boot
+		Serial.println("Could not update compiled animations");
+		storage->deleteFile(cache_file);
+	}
+	free(record);
+	ReplaceAnimations(custom_animation_set, patched);
+	if (journal_size > ANIMATION_JOURNAL_LIMIT) {
+		Serial.println("Merging animations journal into animations file");
+		return UpdateAnimations(GetAnimations());
+	}
+	return true;
+}
+
+/// @brief Appends a compiled record to the end of the compiled animation cache
+/// @param record The compiled record
+/// @param record_size The size of the record in bytes
+/// @param journal_size The size of the journal, including the entry the record was compiled from
+/// @return True on success, false if the cache is missing or doesn't match the animations in memory
+bool LEDRing::AppendToCache(const uint8_t* record, size_t record_size, size_t journal_size) {
+	if (!storage->fileExists(cache_file)) {
+		return false;
+	}
+	File cache = storage->openFile(cache_file, "r+");
+	if (!cache) {
+		return false;
+	}
+	AnimationCompiler::cache_header header;
+	bool success = cache.read((uint8_t*)&header, sizeof(header)) == sizeof(header) && header.magic == ANIMATION_CACHE_MAGIC && header.version == ANIMATION_CACHE_VERSION
+		&& header.data_size == custom_animation_set.size && header.data_size == cache.size() - sizeof(header);
+	if (success) {
+		header.count++;
+		header.data_size += record_size;
+		header.journal_size = journal_size;
+		AnimationCompiler::FileSink sink(cache);
+		success = cache.seek(cache.size()) && sink.write(record, record_size) && sink.patch(0, &header, sizeof(header));
+	}
+	cache.close();
+	return success;
+}
+
+/// @brief Loads the animations from the compiled animation cache, or from the animation file and journal if the cache is stale
 /// @return True on success
 bool LEDRing::LoadAnimations() {
 	Serial.println("Loading animations");
-	if (storage->fileExists(animations_file)) {
-		String settings = storage->readFile(animations_file);
-		// Parse settings string
-		settings.trim();
-		Serial.println("Loaded animations file");
-		return LoadAnimationsHelper(settings.c_str());
-	} else {
+	size_t source_size = 0;
+	time_t source_time = 0;
+	size_t journal_size = 0;
+	time_t journal_time;
+	bool has_source = storage->fileExists(animations_file) && storage->getFileInfo(animations_file, source_size, source_time);
+	bool has_journal = storage->fileExists(journal_file) && storage->getFileInfo(journal_file, journal_size, journal_time);
+	if (!has_source && !has_journal) {
 		Serial.println("Animations files doesn't exist");
 		return false;
 	}
+	if (LoadAnimationCache(source_size, source_time, journal_size)) {
+		Serial.println("Loaded compiled animations");
+		return true;
+	}
+	Serial.println("Compiled animations are stale, compiling animations file");
+	File source;
+	File journal;
+	if (has_source)
+		source = storage->openFile(animations_file);
+	if (has_journal)
+		journal = storage->openFile(journal_file);
+	File cache = storage->openFile(cache_file, FILE_WRITE);
+	if ((has_source && !source) || (has_journal && !journal) || !cache) {
+		return false;
+	}
+	AnimationCompiler::cache_header header;
+	header.source_size = source_size;
+	header.source_time = source_time;
+	header.journal_size = journal_size;
+	bool success = CompileAnimationCache(has_source ? &source : NULL, has_journal ? &journal : NULL, cache, header);
+	if (has_source)
+		source.close();
+	if (has_journal)
+		journal.close();
+	cache.close();
+	if (!success) {
+		Serial.println("Bad settings data loaded");
+		storage->deleteFile(cache_file);
+		return false;
+	}
+	return LoadAnimationCache(source_size, source_time, journal_size);
 }
 
-/// @brief Processes animations from a C-type string
-/// @param input The JSON formatted string
+/// @brief Compiles animations from a stream, followed by the changes in the journal, into the compiled animation cache, holding only one frame in memory at a time
+/// @param source The stream of JSON formatted animations, or NULL
+/// @param journal The stream of journal entries, or NULL
+/// @param cache The cache file, opened for writing
+/// @param header The header of the cache, with the source size and time and journal size filled in. The rest is filled in on success.
 /// @return True on success
-bool LEDRing::LoadAnimationsHelper(const char* input) {
-	DynamicJsonDocument new_settings(1048576); // Allocate a big 1MiB document to load animations (requires PSRAM)
-	DeserializationError error = deserializeJson(new_settings, input);
-	if (error) {
-		Serial.println("Bad settings data loaded");
-		Serial.println(error.c_str());
-		return false;
-	}
-	new_settings.shrinkToFit();
-	// Add animations
-	for (JsonPair kv : new_settings["animations"].as<JsonObject>()) {
-		JsonObject new_animation = kv.value().as<JsonObject>();
-		// Create frames
-		std::vector<frame> new_frames;
-		for (JsonObject new_frame : new_animation["frames"].as<JsonArray>()) {
-			// Build color array
-			JsonArray colors = new_frame["colors"].as<JsonArray>();
-			std::vector<uint32_t> new_colors; 
-			for (int i = 0; i < colors.size(); i++) {
-				new_colors.push_back(std::strtoul(colors[i].as<String>().c_str(), NULL, 0)); // Gamma correction could go here
-			}
-			// Add frame to animation
-			new_frames.push_back(frame {
-				new_frame["duration"].as<int>(),
-				new_colors
-			});
-		}
-		// Add or replace animation in map
-		animations[kv.key().c_str()] = animation {
-			new_animation["repetitions"].as<uint32_t>(),
-			new_animation["clearOnDone"].as<bool>(),
-			new_frames 
-		};
+bool LEDRing::CompileAnimationCache(Stream* source, Stream* journal, File& cache, AnimationCompiler::cache_header& header) {
+	header.magic = ANIMATION_CACHE_MAGIC;
+	header.version = ANIMATION_CACHE_VERSION;
+	header.count = 0;
+	header.data_size = 0;
+	AnimationCompiler::FileSink sink(cache);
+	// Reserve the header, it is filled in once all the animations have been compiled
+	if (!sink.write(&header, sizeof(header))) {
+		return false;
+	}
+	if (source != NULL) {
+		AnimationCompiler compiler(source, &sink);
+		// Nothing but whitespace may follow the animations object
+		if (!compiler.CompileAnimations(header.count) || !compiler.AtEnd()) {
+			Serial.println("Bad animation data");
+			return false;
+		}
+	}
+	if (journal != NULL) {
+		// Each journal entry changes one animation, later records replace earlier ones
+		AnimationCompiler compiler(journal, &sink);
+		while (!compiler.AtEnd()) {
+			uint16_t count;
+			if (!compiler.CompileAnimations(count)) {
+				Serial.println("Bad animation journal entry");
+				return false;
+			}
+			header.count += count;
+		}
+	}
+	header.data_size = sink.position() - sizeof(header);
+	return sink.patch(0, &header, sizeof(header));
+}
+
+/// @brief Builds the index of an animation set from its compiled records. Later records replace earlier ones with the same name.
+/// @param set The animation set to index
+/// @param records Set to the number of records in the set
+/// @return True on success, false if the compiled records are malformed
+bool LEDRing::IndexAnimations(animation_set& set, uint16_t& records) {
+	set.index.clear();
+	records = 0;
+	size_t offset = 0;
+	while (offset < set.size) {
+		if (set.size - offset < sizeof(AnimationCompiler::record_header)) {
+			return false;
+		}
+		AnimationCompiler::record_header* record = (AnimationCompiler::record_header*)(set.blob + offset);
+		offset += sizeof(AnimationCompiler::record_header);
+		if (record->name_length == 0 || (record->name_length & 3) != 0 || set.size - offset < record->name_length) {
+			return false;
+		}
+		const char* name = (const char*)(set.blob + offset);
+		if (name[record->name_length - 1] != '\0') {
+			return false;
+		}
+		offset += record->name_length;
+		if ((set.size - offset) / sizeof(uint32_t) < record->data_words) {
+			return false;
+		}
+		if (record->type == AnimationCompiler::ANIMATION_EFFECT && record->data_words * sizeof(uint32_t) != sizeof(AnimationCompiler::effect_params)) {
+			return false;
+		}
+		if (record->type == AnimationCompiler::ANIMATION_FRAMES) {
+			// Every frame, including its colors, has to fit in the data of the record
+			const uint32_t* data = (const uint32_t*)(set.blob + offset);
+			uint32_t words = 0;
+			for (uint32_t f = 0; f < record->frame_count; f++) {
+				if (record->data_words - words < 2 || record->data_words - words - 2 < (data[words + 1] & ANIMATION_FRAME_COLOR_MASK)) {
+					return false;
+				}
+				words += 2 + (data[words + 1] & ANIMATION_FRAME_COLOR_MASK);
+			}
+			if (words != record->data_words) {
+				return false;
+			}
+		}
+		records++;
+		for (size_t i = 0; i < set.index.size(); i++) {
+			if (strcmp(set.index[i].name, name) == 0) {
+				set.index.erase(set.index.begin() + i);
+				break;
+			}
+		}
+		if (record->type == AnimationCompiler::ANIMATION_DELETED) {
+			offset += record->data_words * sizeof(uint32_t);
+			continue;
+		}
+		set.index.push_back(AnimationCompiler::animation {
+			name,
+			record->repetitions,
+			record->clear_on_done != 0,
+			record->frame_count,
+			record->type,
+			(const uint32_t*)(set.blob + offset)
+		});
+		offset += record->data_words * sizeof(uint32_t);
 	}
 	return true;
 }
 
-// @brief Adds a command to the queue
+/// @brief Maps the compiled animation cache into memory, if it matches the animations file
+/// @param source_size The current size of the animations file
+/// @param source_time The current last write time of the animations file
+/// @param journal_size The current size of the animations journal
+/// @return True on success, false if the cache is missing, stale, or malformed
+bool LEDRing::LoadAnimationCache(size_t source_size, time_t source_time, size_t journal_size) {
+	if (!storage->fileExists(cache_file)) {
+		return false;
+	}
+	File file = storage->openFile(cache_file);
+	if (!file) {
+		return false;
+	}
+	AnimationCompiler::cache_header header;
+	if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) || header.magic != ANIMATION_CACHE_MAGIC || header.version != ANIMATION_CACHE_VERSION 
+		|| header.source_size != source_size || header.source_time != (uint32_t)source_time || header.journal_size != journal_size || header.data_size != file.size() - sizeof(header)) {
+		file.close();
+		return false;
+	}
+	animation_set cached;
+	cached.blob = (uint8_t*)(psramFound() ? ps_malloc(header.data_size) : malloc(header.data_size));
+	if (cached.blob == NULL) {
+		file.close();
+		return false;
+	}
+	cached.size = header.data_size;
+	uint16_t records;
+	bool success = file.read(cached.blob, cached.size) == cached.size && IndexAnimations(cached, records) && records == header.count;
+	file.close();
+	if (!success) {
+		Serial.println("Compiled animations are corrupt");
+		FreeAnimations(cached);
+		return false;
+	}
+	ReplaceAnimations(custom_animation_set, cached);
+	return true;
+}
+
+/// @brief Replaces an animation set, waiting for the render loop to finish its current tick. An animation being played from it is started again from the new set.
+/// @param current The animation set to replace
+/// @param replacement The new animation set, which is emptied
+void LEDRing::ReplaceAnimations(animation_set& current, animation_set& replacement) {
+	xSemaphoreTake(animations_mutex, portMAX_DELAY);
+	FreeAnimations(current);
+	current.blob = replacement.blob;
+	current.size = replacement.size;
+	current.index.swap(replacement.index);
+	xSemaphoreTake(names_mutex, portMAX_DELAY);
+	for (const AnimationCompiler::animation& a : current.index) {
+		InternName(a.name);
+	}
+	xSemaphoreGive(names_mutex);
+	animations_version++;
+	xSemaphoreGive(animations_mutex);
+	replacement.blob = NULL;
+	replacement.size = 0;
+	replacement.index.clear();
+}
+
+/// @brief Releases the memory used by an animation set
+/// @param set The animation set to free
+void LEDRing::FreeAnimations(animation_set& set) {
+	free(set.blob);
+	set.blob = NULL;
+	set.size = 0;
+	set.index.clear();
+}
+
+/// @brief Finds the animation a segment should play, its own version named "<segment>/<name>" takes precedence
+/// @param seg The segment to play the animation on
+/// @param name The name of the animation
+/// @return A pointer to the animation, or NULL if it doesn't exist
+const AnimationCompiler::animation* LEDRing::FindSegmentAnimation(const segment& seg, const String& name) {
+	const AnimationCompiler::animation* animation = FindAnimation(seg.layout.name + '/' + name);
+	if (animation == NULL)
+		animation = FindAnimation(name);
+	return animation;
+}
+
+/// @brief Looks up the animation a segment plays for each animation ID, so playing an animation needs no string work
+/// @param seg The segment to resolve the animations of
+void LEDRing::ResolveAnimations(segment& seg) {
+	xSemaphoreTake(names_mutex, portMAX_DELAY);
+	seg.animations.resize(animation_names.size());
+	for (size_t i = 0; i < animation_names.size(); i++) {
+		seg.animations[i] = FindSegmentAnimation(seg, animation_names[i]);
+	}
+	xSemaphoreGive(names_mutex);
+	seg.resolved_version = animations_version;
+}
+
+/// @brief Gets the ID of a name, adding it if it's new. The names must be locked by the caller, except in the constructor.
+/// @param name The name of an animation, without any segment name
+/// @return The ID of the name
+int16_t LEDRing::InternName(const String& name) {
+	// Animations for a single segment share the ID of the animation they stand in for
+	String base = name.substring(name.indexOf('/') + 1);
+	int16_t id = FindName(base);
+	if (id < 0) {
+		id = animation_names.size();
+		animation_names.push_back(base);
+	}
+	return id;
+}
+
+/// @brief Gets the ID of a name. The names must be locked by the caller.
+/// @param name The name to find
+/// @return The ID of the name, or -1 if it's unknown
+int16_t LEDRing::FindName(const String& name) {
+	for (size_t i = 0; i < animation_names.size(); i++) {
+		if (animation_names[i] == name)
+			return i;
+	}
+	return -1;
+}
+
+/// @brief Gets the animation name of a chime, which is its file name without the extension
+/// @param file The path of the chime sound file
+/// @return The animation name
+String LEDRing::ChimeName(const String& file) {
+	String name = file.substring(file.lastIndexOf('/') + 1);
+	int extension = name.indexOf('.');
+	return extension < 0 ? name : name.substring(0, extension);
+}
+
+/// @brief Finds an animation by name, custom animations take precedence over built-in ones
+/// @param name The name of the animation
+/// @return A pointer to the animation, or NULL if it doesn't exist
+const AnimationCompiler::animation* LEDRing::FindAnimation(String name) {
+	for (const AnimationCompiler::animation& a : custom_animation_set.index) {
+		if (name == a.name)
+			return &a;
+	}
+	for (const AnimationCompiler::animation& a : default_animations) {
+		if (name == a.name)
+			return &a;
+	}
+	return NULL;
+}
+
+/// @brief Binds each chime sound file to the ID of the animation named after it, so playing a chime needs no string work
+/// @param files The paths of the chime sound files, in the order the sound player uses
+/// @return True on success
+bool LEDRing::BindChimes(const std::vector<String>& files) {
+	xSemaphoreTake(names_mutex, portMAX_DELAY);
+	chime_animations.clear();
+	for (const String& file : files) {
+		chime_animations.push_back(InternName(ChimeName(file)));
+	}
+	xSemaphoreGive(names_mutex);
+	return true;
+}
+
+/// @brief Adds a command to the queue
+/// @param event The event to add
+/// @param chime The index of the chime playing for this event, as passed to BindChimes, or -1
+/// @return True on success.
+bool LEDRing::AddEventToQueue(Events event, int chime) {
+	led_event new_event { event, -1 };
+	if (chime >= 0) {
+		xSemaphoreTake(names_mutex, portMAX_DELAY);
+		if (chime < chime_animations.size())
+			new_event.animation = chime_animations[chime];
+		xSemaphoreGive(names_mutex);
+	}
+	if (xQueueSendToBack(EventQueue, (void*) &new_event, 10) == errQUEUE_FULL) {
+		Serial.println("LED event queue full");
+		return false;
+	}
+	return true;
+}
+
+/// @brief Adds a command to the queue for a sound file that may not be a bound chime
 /// @param event The event to add
-/// @param file The full path the the sound file playing for this event, if any
+/// @param file The path of the sound file playing for this event
 /// @return True on success.
-bool LEDRing::AddEventToQueue(Events event, String file) {
-	String *event_string = new String(event_names[event] + ':' + file);
-	if (xQueueSendToBack(EventQueue, (void*) &event_string, 10) == errQUEUE_FULL) {
+bool LEDRing::AddEventToQueue(Events event, const String& file) {
+	String name = ChimeName(file);
+	xSemaphoreTake(names_mutex, portMAX_DELAY);
+	led_event new_event { event, FindName(name) };
+	xSemaphoreGive(names_mutex);
+	if (new_event.animation < 0 && !name.isEmpty()) {
+		Serial.println("No animation named " + name);
+	}
+	if (xQueueSendToBack(EventQueue, (void*) &new_event, 10) == errQUEUE_FULL) {
 		Serial.println("LED event queue full");
 		return false;
 	}
@@ -117,46 +731,387 @@ void LEDRing::ProcessEventTaskWrapper(void* arg) {
 	static_cast<LEDRing*>(arg)->ProcessEvent();
 }
 
-/// @brief Process each event in the queue as an infinite loop
+/// @brief Renders animations as an infinite loop, ticking every LED_TICK_MS while an animation is playing
 void LEDRing::ProcessEvent() {
-	String *event_ptr = NULL;
+	led_event event;
+	TickType_t last_wake = xTaskGetTickCount();
 	while(true) 
 	{
-		if (xQueueReceive(EventQueue, &event_ptr, 10) == pdTRUE) {
-			Serial.print("Processing event ");
-			Serial.println(*event_ptr);
-			String event = *event_ptr;
-			// Get event name
-			String animation_to_play = event.substring(0, event.indexOf(":"));
-			// Get file name, if any
-			String file = event.substring(event.indexOf(":") + 1);
-			if (!file.isEmpty() && animations.find(file) != animations.end()) {
-				animation_to_play = file;
+		if (settings_changed) {
+			ApplySettings();
+		}
+		if (!playing && pending_events.empty() && !IsDithering()) {
+			// Nothing to show, sleep until an event arrives or it's time to check the settings
+			if (xQueueReceive(EventQueue, &event, pdMS_TO_TICKS(LED_IDLE_MS)) != pdTRUE) {
+				continue;
+			}
+			ScheduleEvent(event);
+			last_wake = xTaskGetTickCount();
+		}
+		// The animation sets are only locked while a tick renders, so replacing them never waits on a whole animation
+		xSemaphoreTake(animations_mutex, portMAX_DELAY);
+		if (playing && playing_version != animations_version) {
+			// The animations being played were freed, start the event again with the new ones
+			StopAnimation();
+			StartAnimation(current_event);
+		}
+		while (xQueueReceive(EventQueue, &event, 0) == pdTRUE) {
+			ScheduleEvent(event);
+		}
+		if (!playing && !pending_events.empty()) {
+			// Play the oldest of the highest priority events
+			size_t next = 0;
+			for (size_t i = 1; i < pending_events.size(); i++) {
+				if (event_priorities[pending_events[i].event] > event_priorities[pending_events[next].event])
+					next = i;
+			}
+			event = pending_events[next];
+			pending_events.erase(pending_events.begin() + next);
+			StartAnimation(event);
+		}
+		uint32_t now = millis();
+		bool active = false;
+		for (segment& seg : segments) {
+			if (seg.playback.animation != NULL) {
+				AdvanceAnimation(seg, now);
+				active |= seg.playback.animation != NULL;
+			} else if (seg.dither_active) {
+				// Keep dithering the last frame left on
+				ShowPixels(seg, true);
+			}
+		}
+		// The event is done once every segment has finished its animation
+		if (playing && !active) {
+			StopAnimation();
+		}
+		xSemaphoreGive(animations_mutex);
+		vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(LED_TICK_MS));
+	}
+}
+
+/// @brief Checks if any segment needs to keep dithering
+/// @return True if the render loop needs to keep ticking to dither
+bool LEDRing::IsDithering() {
+	for (const segment& seg : segments) {
+		if (seg.dither_active)
+			return true;
+	}
+	return false;
+}
+
+/// @brief Preempts the current animation with a new event of higher priority, or queues the event to play later
+/// @param event The event received
+void LEDRing::ScheduleEvent(led_event event) {
+	// Logged with printf, so dispatching an event builds no Strings
+	if (event.animation < 0)
+		Serial.printf("Processing event %s\n", event_names[event.event].c_str());
+	else
+		Serial.printf("Processing event %s:%d\n", event_names[event.event].c_str(), event.animation);
+	if (playing && event_priorities[event.event] > current_priority) {
+		StopAnimation();
+		StartAnimation(event);
+		return;
+	}
+	// Drop events that are already waiting to be played
+	for (const led_event& waiting : pending_events) {
+		if (waiting.event == event.event && waiting.animation == event.animation) {
+			return;
+		}
+	}
+	if (pending_events.size() == LED_PENDING_EVENTS) {
+		Serial.println("Too many LED events pending");
+		return;
+	}
+	pending_events.push_back(event);
+}
+
+/// @brief Starts playing the animations for an event on every segment, showing their first frames. The animation sets must be locked by the caller.
+/// @param event The event to play
+void LEDRing::StartAnimation(led_event event) {
+	uint32_t now = millis();
+	for (segment& seg : segments) {
+		if (seg.resolved_version != animations_version || event.animation >= (int)seg.animations.size()) {
+			ResolveAnimations(seg);
+		}
+		// Use the animation for the sound file, if there is one
+		const AnimationCompiler::animation* animation = NULL;
+		if (event.animation >= 0) {
+			animation = seg.animations[event.animation];
+		}
+		if (animation == NULL) {
+			animation = seg.animations[event.event];
+		}
+		if (animation == NULL || (animation->type == AnimationCompiler::ANIMATION_FRAMES && animation->frame_count == 0)) {
+			continue;
+		}
+		Serial.printf("Playing animation %s on %s\n", animation->name, seg.layout.name.c_str());
+		playback_state& playback = seg.playback;
+		playback.animation = animation;
+		playback.repetition = 0;
+		playback.step = 0;
+		playback.frame = animation->data;
+		memset(seg.pixels, 0, seg.layout.count * sizeof(uint32_t));
+		ShowStep(seg);
+		ShowPixels(seg);
+		playback.rendered = now;
+		playback.deadline = now + StepDuration(playback);
+		playing = true;
+	}
+	if (!playing) {
+		Serial.printf("No animation for event %s\n", event_names[event.event].c_str());
+		return;
+	}
+	current_event = event;
+	playing_version = animations_version;
+	current_priority = event_priorities[event.event];
+}
+
+/// @brief Moves the animation of a segment forward to the given time. Deadlines are accumulated, so the timing doesn't drift with the time taken to show each frame.
+/// @param seg The segment to advance
+/// @param now The current time in milliseconds
+void LEDRing::AdvanceAnimation(segment& seg, uint32_t now) {
+	playback_state& playback = seg.playback;
+	bool changed = false;
+	while ((int32_t)(now - playback.deadline) >= 0) {
+		const AnimationCompiler::animation* animation = playback.animation;
+		playback.step++;
+		if (animation->type == AnimationCompiler::ANIMATION_FRAMES) {
+			playback.frame += 2 + (playback.frame[1] & ANIMATION_FRAME_COLOR_MASK);
+		}
+		bool repetition_done = animation->type == AnimationCompiler::ANIMATION_FRAMES ? playback.step >= animation->frame_count
+			: playback.step * ((const AnimationCompiler::effect_params*)animation->data)->interval >= ((const AnimationCompiler::effect_params*)animation->data)->duration;
+		if (repetition_done) {
+			playback.repetition++;
+			if (playback.repetition > animation->repetitions) {
+				if (animation->clearOnDone) {
+					memset(seg.pixels, 0, seg.layout.count * sizeof(uint32_t));
+					changed = true;
+				}
+				if (changed)
+					ShowPixels(seg);
+				playback.animation = NULL;
+				return;
+			}
+			playback.step = 0;
+			playback.frame = animation->data;
+		}
+		ShowStep(seg);
+		changed = true;
+		playback.deadline += StepDuration(playback);
+	}
+	// Render crossfades at a fixed rate, no matter how long the keyframe is
+	if (playback.animation->type == AnimationCompiler::ANIMATION_FRAMES && (playback.frame[1] >> ANIMATION_FRAME_EASING_SHIFT) != AnimationCompiler::EASE_NONE
+		&& (changed || now - playback.rendered >= LED_FRAME_MS)) {
+		InterpolateStep(seg, now);
+		playback.rendered = now;
+		changed = true;
+	}
+	if (changed || seg.dither_active)
+		ShowPixels(seg, !changed);
+}
+
+/// @brief Stops the animations of the current event on every segment
+void LEDRing::StopAnimation() {
+	for (segment& seg : segments) {
+		seg.playback.animation = NULL;
+	}
+	playing = false;
+}
+
+/// @brief Sets the LEDs of a segment to the current frame of its animation, without showing them
+/// @param seg The segment to set
+void LEDRing::ShowStep(segment& seg) {
+	const playback_state& playback = seg.playback;
+	if (playback.animation->type == AnimationCompiler::ANIMATION_EFFECT) {
+		const AnimationCompiler::effect_params* effect = (const AnimationCompiler::effect_params*)playback.animation->data;
+		RenderEffect(seg, *effect, playback.step * effect->interval);
+		return;
+	}
+	// Set the color of each LED
+	const uint32_t* colors = playback.frame + 2;
+	uint32_t count = min(playback.frame[1] & ANIMATION_FRAME_COLOR_MASK, (uint32_t)seg.layout.count);
+	memcpy(seg.pixels, colors, count * sizeof(uint32_t));
+}
+
+/// @brief Crossfades the current keyframe into the next one, or into the first one after the last keyframe
+/// @param seg The segment to set
+/// @param now The current time in milliseconds
+void LEDRing::InterpolateStep(segment& seg, uint32_t now) {
+	const playback_state& playback = seg.playback;
+	const AnimationCompiler::animation* animation = playback.animation;
+	uint32_t duration = playback.frame[0];
+	uint32_t count = playback.frame[1] & ANIMATION_FRAME_COLOR_MASK;
+	const uint32_t* next = playback.step + 1 < animation->frame_count ? playback.frame + 2 + count : animation->data;
+	uint32_t next_count = next[1] & ANIMATION_FRAME_COLOR_MASK;
+	// Progress through the keyframe as a 16.16 fraction
+	uint32_t elapsed = duration - (playback.deadline - now);
+	uint32_t progress = duration == 0 || elapsed >= duration ? 65536 : ((uint64_t)elapsed << 16) / duration;
+	uint32_t level = Ease(playback.frame[1] >> ANIMATION_FRAME_EASING_SHIFT, progress);
+	const uint32_t* colors = playback.frame + 2;
+	const uint32_t* next_colors = next + 2;
+	for (uint16_t i = 0; i < count && i < seg.layout.count; i++) {
+		seg.pixels[i] = LerpColor(colors[i], i < next_count ? next_colors[i] : colors[i], level);
+	}
+}
+
+/// @brief Applies an easing curve to the progress through a keyframe
+/// @param easing The easing to apply, one of AnimationCompiler::easings
+/// @param progress The progress through the keyframe, from 0 to 65536
+/// @return The blend level, from 0 to 256
+uint32_t LEDRing::Ease(uint8_t easing, uint32_t progress) {
+	uint32_t squared = ((uint64_t)progress * progress) >> 16;
+	switch (easing) {
+		case AnimationCompiler::EASE_IN:
+			progress = squared;
+			break;
+		case AnimationCompiler::EASE_OUT:
+			progress = 2 * progress - squared;
+			break;
+		case AnimationCompiler::EASE_IN_OUT:
+			// Smoothstep, 3p^2 - 2p^3
+			progress = 3 * squared - (((uint64_t)squared * progress) >> 15);
+			break;
+		default:
+			break;
+	}
+	return progress >> 8;
+}
+
+/// @brief Blends two colors, with the red and blue channels blended together in one 32-bit multiply
+/// @param from The color at level 0
+/// @param to The color at level 256
+/// @param level The blend level, from 0 to 256
+/// @return The blended color
+uint32_t LEDRing::LerpColor(uint32_t from, uint32_t to, uint32_t level) {
+	uint32_t inverse = 256 - level;
+	uint32_t red_blue = ((from & 0xFF00FF) * inverse + (to & 0xFF00FF) * level) >> 8;
+	uint32_t green = ((from & 0x00FF00) * inverse + (to & 0x00FF00) * level) >> 8;
+	return (red_blue & 0xFF00FF) | (green & 0x00FF00);
+}
+
+/// @brief Applies brightness and gamma to the LED colors of a segment and sends them to the LEDs. Unchanged frames are skipped by the output.
+/// @param seg The segment to show
+/// @param held True if the LED colors are unchanged since they were last shown
+void LEDRing::ShowPixels(segment& seg, bool held) {
+	// A held frame is dithered for one full cycle of the error terms, then settles on the nearest levels so the render loop can go idle
+	seg.held_frames = held ? seg.held_frames + 1 : 0;
+	bool dither = dithering && seg.held_frames < LED_DITHER_HOLD_FRAMES;
+	bool fractional = false;
+	uint8_t* error = seg.dither_error;
+	for (uint16_t i = 0; i < seg.layout.count; i++, error += 3) {
+		uint8_t channels[3];
+		for (int c = 0; c < 3; c++) {
+			uint16_t level = output_levels[(seg.pixels[i] >> (16 - c * 8)) & 0xFF];
+			if (dither) {
+				// Carry the fraction over so the average over several frames matches the exact level
+				uint32_t value = level + error[c];
+				error[c] = value & 0xFF;
+				channels[c] = value >> 8;
+				fractional |= (level & 0xFF) != 0;
+			} else {
+				channels[c] = (level + 128) >> 8;
 			}
-			PlayAnimation(animation_to_play);
-			delete event_ptr;
 		}
+		seg.output->setPixelColor(i, channels[0], channels[1], channels[2]);
+	}
+	seg.output->show();
+	seg.dither_active = fractional;
+}
+
+/// @brief Rebuilds the output level table from the brightness and gamma settings. This is the only place floating point math is used.
+/// The table is only read by the render loop, which is also the only caller once it is running, so it is built in place.
+void LEDRing::BuildOutputLevels() {
+	for (int i = 0; i < 256; i++) {
+		output_levels[i] = lroundf(powf(i / 255.0f, gamma) * brightness * 256);
+	}
+	for (segment& seg : segments) {
+		memset(seg.dither_error, 0, seg.layout.count * 3);
 	}
 }
 
-/// @brief Shows an animation on the LEDs
-/// @param event The name of the animation to play
-void LEDRing::PlayAnimation(String name) {
-	Serial.println("Playing animation " + name);
-	animation* playing = &animations[name];
-	for (int i = 0; i <= playing->repetitions; i++) {
-		// Loop through each frame
-		for (frame f : playing->frames) {
-			// Set the color of each LED
-			for (uint16_t j = 0; j < f.colors.size(); j++) {
-				leds.setPixelColor(j, f.colors[j]);
+/// @brief Gets how long the current frame of an animation is shown
+/// @param playback The animation being played
+/// @return The duration in milliseconds
+uint32_t LEDRing::StepDuration(const playback_state& playback) {
+	if (playback.animation->type == AnimationCompiler::ANIMATION_EFFECT)
+		return ((const AnimationCompiler::effect_params*)playback.animation->data)->interval;
+	// Frames last at least a millisecond, so catching up on a long run of zero length frames ends within a tick
+	return max(playback.frame[0], (uint32_t)1);
+}
+
+/// @brief Computes one frame of a procedural effect into the LED buffer using integer math only
+/// @param seg The segment to render the effect on
+/// @param effect The parameters of the effect
+/// @param time The time in milliseconds since the start of the effect
+void LEDRing::RenderEffect(segment& seg, const AnimationCompiler::effect_params& effect, uint32_t time) {
+	const uint32_t count = seg.layout.count;
+	uint32_t* pixels = seg.pixels;
+	const uint32_t ring = count * 256; // Positions are measured in 1/256 of an LED
+	uint32_t phase = time % effect.period;
+	// Position of the head of the effect around the ring
+	uint32_t position = (uint64_t)phase * ring / effect.period;
+	if (effect.direction < 0)
+		position = (ring - position) % ring;
+	switch (effect.effect) {
+		case AnimationCompiler::EFFECT_SPINNER: {
+			uint32_t head = ((position + 128) >> 8) % count;
+			for (uint16_t i = 0; i < count; i++) {
+				uint32_t offset = effect.direction < 0 ? (head + count - i) % count : (i + count - head) % count;
+				pixels[i] = offset < effect.width ? effect.color : effect.background;
+			}
+			break;
+		}
+		case AnimationCompiler::EFFECT_CHASE: {
+			// A comet whose tail fades out over width LEDs behind the head
+			uint32_t tail = max(effect.width, (uint32_t)1) * 256;
+			for (uint16_t i = 0; i < count; i++) {
+				uint32_t behind = effect.direction < 0 ? (i * 256 + ring - position) % ring : (position + ring - i * 256) % ring;
+				uint8_t level = behind < tail ? 255 - behind * 255 / tail : 0;
+				pixels[i] = BlendColor(effect.background, effect.color, level);
+			}
+			break;
+		}
+		case AnimationCompiler::EFFECT_BREATHE: {
+			// Triangle wave squared for a gentle ease in and out
+			uint32_t triangle = phase * 510 / effect.period;
+			if (triangle > 255)
+				triangle = 510 - triangle;
+			uint32_t color = BlendColor(effect.background, effect.color, (triangle * triangle + 255) >> 8);
+			for (uint16_t i = 0; i < count; i++) {
+				pixels[i] = color;
+			}
+			break;
+		}
+		case AnimationCompiler::EFFECT_AUDIO: {
+			// Brightness follows the loudness, hue goes from red for bass through green to blue for treble
+			uint16_t hue = analyzer->getBalance() * 43690 / 255;
+			uint32_t color = BlendColor(effect.background, Adafruit_NeoPixel::ColorHSV(hue), analyzer->getLevel());
+			for (uint16_t i = 0; i < count; i++) {
+				pixels[i] = color;
 			}
-			leds.show();
-			delay(f.duration);
+			break;
+		}
+		case AnimationCompiler::EFFECT_RAINBOW: {
+			uint16_t hue = (uint64_t)position * 65536 / ring;
+			for (uint16_t i = 0; i < count; i++) {
+				pixels[i] = Adafruit_NeoPixel::ColorHSV(hue + (uint64_t)i * max(effect.width, (uint32_t)1) * 65536 / count);
+			}
+			break;
 		}
 	}
-	if (playing->clearOnDone) {
-		leds.clear();
-		leds.show();
+}
+
+/// @brief Blends two colors
+/// @param from The color to blend from
+/// @param to The color to blend to
+/// @param level How much of the second color to use, from 0 to 255
+/// @return The blended color
+uint32_t LEDRing::BlendColor(uint32_t from, uint32_t to, uint8_t level) {
+	uint32_t blended = 0;
+	for (int shift = 0; shift <= 16; shift += 8) {
+		int32_t a = (from >> shift) & 0xFF;
+		int32_t b = (to >> shift) & 0xFF;
+		blended |= (uint32_t)(a + (((b - a) * level + 127) / 255)) << shift;
 	}
+	return blended;
 }
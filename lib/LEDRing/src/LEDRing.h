@@ -13,69 +13,260 @@
 #include <Adafruit_NeoPixel.h>
 #include <ArduinoJson.h>
 #include <Storage.h>
+#include <AnimationCompiler.h>
+#include <LEDOutput.h>
+#include <AudioAnalyzer.h>
 #include <vector>
-#include <map>
 
 class LEDRing {
 	public:
+		/// @brief Number of LEDs of the default segment, used until the LED settings say otherwise
 		#define LED_COUNT 16
+
+		/// @brief Pin of the default segment
 		#define LED_PIN 1
 
 		/// @brief Events that trigger the display
 		enum Events { BELL_RING_START, BELL_RING_END, WIFI_CONFIG_START, WIFI_CONFIG_END, UPDATED, STORAGE_ERROR, I2S_PLAYER_ERROR, WEBHOOK_ERROR, DOORBELL_READY };
 
-		LEDRing(Storage* Storage, String Animations_file);
+		LEDRing(Storage* Storage, String Animations_file, String Settings_file, AudioAnalyzer* Analyzer);
 		void begin();
+		bool LoadSettings();
+		bool SaveSettings();
+		String GetSettings();
+		bool UpdateSettings(String settings);
 		String GetAnimations();
 		bool UpdateAnimations(String newAnimations);
+		bool UpdateAnimation(String name, String animation);
+		bool DeleteAnimation(String name);
 		bool LoadAnimations();
-		bool AddEventToQueue(Events event, String file = String());
+		bool BindChimes(const std::vector<String>& files);
+		bool AddEventToQueue(Events event, int chime = -1);
+		bool AddEventToQueue(Events event, const String& file);
 		static void ProcessEventTaskWrapper(void* arg);
 		
 	private:
+		/// @brief Period in milliseconds of the render loop
+		#define LED_TICK_MS 5
+
+		/// @brief Minimum time in milliseconds between rendered frames of a crossfade, about 60 frames per second
+		#define LED_FRAME_MS 15
+
+		/// @brief Longest time in milliseconds the render loop sleeps while idle before checking for new settings
+		#define LED_IDLE_MS 100
+
+		/// @brief Maximum number of LED segments, each one uses an RMT channel
+		#define LED_MAX_SEGMENTS 4
+
+		/// @brief Maximum number of LEDs in a segment
+		#define LED_MAX_PIXELS 1024
+
+		/// @brief Size in bytes the animations journal can grow to before it is merged into the animations file
+		#define ANIMATION_JOURNAL_LIMIT 65536
+
+		/// @brief Maximum number of events waiting to be played
+		#define LED_PENDING_EVENTS 10
+
+		/// @brief Number of ticks a frame left on after an animation keeps being dithered, one full cycle of the 8-bit error terms
+		#define LED_DITHER_HOLD_FRAMES 256
+
+		/// @brief An event waiting in the queue
+		struct led_event {
+			/// @brief The event to show
+			Events event;
+
+			/// @brief ID of the animation for the sound file playing for this event, or -1
+			int16_t animation;
+		};
+
+		/// @brief State of the animation being played on a segment
+		struct playback_state {
+			/// @brief The animation being played, NULL when idle
+			const AnimationCompiler::animation* animation = NULL;
+
+			/// @brief The current repetition of the animation
+			uint32_t repetition;
+
+			/// @brief The current frame of the animation
+			uint32_t step;
+
+			/// @brief Data of the current frame, for frame animations
+			const uint32_t* frame;
+
+			/// @brief Time in milliseconds at which the next frame is due
+			uint32_t deadline;
+
+			/// @brief Time in milliseconds at which the current crossfade was last rendered
+			uint32_t rendered;
+		};
+
+		/// @brief Where a segment is connected and how long it is
+		struct segment_layout {
+			/// @brief Name of the segment, animations named "<name>/<animation>" are played only on this segment
+			String name;
+
+			/// @brief Data pin of the segment
+			uint8_t pin;
+
+			/// @brief Number of LEDs in the segment
+			uint16_t count;
+		};
+
+		/// @brief An independent run of LEDs on its own pin, playing its own animation
+		struct segment {
+			/// @brief Where the segment is connected and how long it is
+			segment_layout layout;
+
+			/// @brief LED driver
+			LEDOutput* output = NULL;
+
+			/// @brief The colors of the LEDs before brightness and gamma are applied
+			uint32_t* pixels = NULL;
+
+			/// @brief The fraction of each LED channel carried over to the next frame when dithering, three per LED
+			uint8_t* dither_error = NULL;
+
+			/// @brief Set while the output has fractional levels that need dithering between frames
+			bool dither_active = false;
+
+			/// @brief Number of times the current LED colors have been shown unchanged
+			uint16_t held_frames = 0;
+
+			/// @brief The animation being played on this segment
+			playback_state playback;
+
+			/// @brief The animation this segment plays for each animation ID, or NULL
+			std::vector<const AnimationCompiler::animation*> animations;
+
+			/// @brief The animations_version the animations were resolved for
+			uint32_t resolved_version = 0;
+		};
+
 		/// @brief Queue to hold events to be processed.
 		QueueHandle_t EventQueue;
 
 		/// @brief Holds the name of events
 		String event_names[9];
 
+		/// @brief Holds the priority of events, events with a higher priority interrupt the animation of events with a lower priority
+		uint8_t event_priorities[9];
+
+		/// @brief Events received that are waiting to be played
+		std::vector<led_event> pending_events;
+
+		/// @brief Set while the animations for an event are playing
+		bool playing = false;
+
+		/// @brief The event being played
+		led_event current_event;
+
+		/// @brief The priority of the event being played, higher priorities preempt lower ones
+		uint8_t current_priority;
+
+		/// @brief The LED segments, only touched by the render loop once it is running
+		std::vector<segment> segments;
+
 		/// @brief Reference to storage object
 		Storage* storage;
 
-		/// @brief LED  driver
-		Adafruit_NeoPixel leds;
-
 		/// @brief File storing the JSON encodings of the animations
 		String animations_file;
-		
-		/// @brief Represents a single animation frame
-		struct frame {
-			/// @brief  The duration of this frame in milliseconds
-			int duration;
-			/// @brief the RGB value for each LED in this frame
-			std::vector<uint32_t> colors;
-		};
 
-		/// @brief Represents an animation
-		struct animation
-		{
-			/// @brief How many times this animation should repeat
-			uint32_t repetitions;
-			
-			/// @brief Whether the LEDs should be turned off after the animation or left on the last frame
-			bool clearOnDone;
-
-			/// @brief A collection of frames for this animation
-			std::vector<frame> frames;
+		/// @brief File storing the compiled binary version of the animations file and journal
+		String cache_file;
+
+		/// @brief File storing changes to single animations made since the animations file was written
+		String journal_file;
+
+		/// @brief Analyzes the sound being played, for audio effects
+		AudioAnalyzer* analyzer;
+
+		/// @brief File storing the brightness and gamma settings
+		String settings_file;
+
+		/// @brief Overall brightness of the LEDs, from 0 to 255
+		uint8_t brightness = 255;
+
+		/// @brief Gamma correction exponent applied to each color channel, 1 disables gamma correction
+		float gamma = 1.0;
+
+		/// @brief Whether temporal dithering is used to smooth out levels that fall between two output values
+		bool dithering = true;
+
+		/// @brief The segments requested by the settings
+		std::vector<segment_layout> layout;
+
+		/// @brief Set when the settings change, the render loop applies them on its next tick
+		volatile bool settings_changed = false;
+
+		/// @brief Locks the settings while they are being read or changed
+		SemaphoreHandle_t settings_mutex;
+
+		/// @brief Maps each 8-bit channel level to an 8.8 fixed point output level with brightness and gamma applied
+		uint16_t output_levels[256];
+
+		/// @brief A set of animations compiled into a single contiguous allocation
+		struct animation_set {
+			/// @brief The compiled animation records
+			uint8_t* blob = NULL;
+
+			/// @brief Size of the compiled animation records in bytes
+			size_t size = 0;
+
+			/// @brief Quick access to each animation in the blob
+			std::vector<AnimationCompiler::animation> index;
 		};
-		
-		/// @brief Collects animations for each event type and/or sound
-		std::map<String, animation> animations;
+
+		/// @brief The custom animations, which take precedence over the built-in animations
+		animation_set custom_animation_set;
+
+		/// @brief Locks the animation sets while a tick of the render loop reads them or they are replaced
+		SemaphoreHandle_t animations_mutex;
+
+		/// @brief Incremented each time the animation sets are replaced, so segments know to resolve their animations again
+		uint32_t animations_version = 1;
+
+		/// @brief The animations_version the event being played was started with
+		uint32_t playing_version = 0;
+
+		/// @brief Names of all the animations, chimes and events, the position of a name is its ID. Names are never removed, so IDs are stable across reloads.
+		std::vector<String> animation_names;
+
+		/// @brief Animation ID of each chime passed to BindChimes
+		std::vector<int16_t> chime_animations;
+
+		/// @brief Locks the animation names and chime bindings
+		SemaphoreHandle_t names_mutex;
 
 		void ProcessEvent();
-		void PlayAnimation(String name);
-		bool LoadAnimationsHelper(const char* input);; 
+		void ApplySettings();
+		bool ConfigureSegments(const std::vector<segment_layout>& new_layout);
+		static void FreeSegment(segment& seg);
+		bool IsDithering();
+		void ScheduleEvent(led_event event);
+		void StartAnimation(led_event event);
+		void AdvanceAnimation(segment& seg, uint32_t now);
+		void StopAnimation();
+		void ShowStep(segment& seg);
+		void InterpolateStep(segment& seg, uint32_t now);
+		static uint32_t Ease(uint8_t easing, uint32_t progress);
+		static uint32_t LerpColor(uint32_t from, uint32_t to, uint32_t level);
+		void ShowPixels(segment& seg, bool held = false);
+		void BuildOutputLevels();
+		static uint32_t StepDuration(const playback_state& playback);
+		void RenderEffect(segment& seg, const AnimationCompiler::effect_params& effect, uint32_t time);
+		static uint32_t BlendColor(uint32_t from, uint32_t to, uint8_t level);
+		const AnimationCompiler::animation* FindAnimation(String name);
+		const AnimationCompiler::animation* FindSegmentAnimation(const segment& seg, const String& name);
+		void ResolveAnimations(segment& seg);
+		int16_t InternName(const String& name);
+		int16_t FindName(const String& name);
+		static String ChimeName(const String& file);
+		bool IndexAnimations(animation_set& set, uint16_t& records);
+		bool LoadAnimationCache(size_t source_size, time_t source_time, size_t journal_size);
+		bool CompileAnimationCache(Stream* source, Stream* journal, File& cache, AnimationCompiler::cache_header& header);
+		bool PatchAnimation(const String& name, const String& value);
+		bool AppendToCache(const uint8_t* record, size_t record_size, size_t journal_size);
+		void ReplaceAnimations(animation_set& current, animation_set& replacement);
+		static void FreeAnimations(animation_set& set);
 };
-
-/// @brief Default LED ring animations. Has been minified, see repo for non-minified version
-const char default_animations[] = R"({"animations":{"BELL_RING_START":{"repetitions":1,"clearOnDone":true,"frames":[{"duration":75,"colors":["0","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F"]},{"duration":75,"colors":["0x00317F","0","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F"]},{"duration":75,"colors":["0x00317F","0x00317F","0","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F"]},{"duration":75,"colors":["0x00317F","0x00317F","0x00317F","0","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F"]},{"duration":75,"colors":["0x00317F","0x00317F","0x00317F","0x00317F","0","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F"]},{"duration":75,"colors":["0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F"]},{"duration":75,"colors":["0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F"]},{"duration":75,"colors":["0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F"]},{"duration":75,"colors":["0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F"]},{"duration":75,"colors":["0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F"]},{"duration":75,"colors":["0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F"]},{"duration":75,"colors":["0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0","0x00317F","0x00317F","0x00317F","0x00317F"]},{"duration":75,"colors":["0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0","0x00317F","0x00317F","0x00317F"]},{"duration":75,"colors":["0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0","0x00317F","0x00317F"]},{"duration":75,"colors":["0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0","0x00317F"]},{"duration":75,"colors":["0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0x00317F","0"]}]},"BELL_RING_END":{"repetitions":0,"clearOnDone":true,"frames":[{"duration":0,"colors":["0","0","0","0","0","0","0","0","0","0","0","0","0","0","0","0"]}]},"WIFI_CONFIG_START":{"repetitions":1,"clearOnDone":false,"frames":[{"duration":50,"colors":["0x00007F","0","0","0","0","0","0","0","0x00007F","0","0","0","0","0","0","0"]},{"duration":50,"colors":["0","0x00007F","0","0","0","0","0","0","0","0x00007F","0","0","0","0","0","0"]},{"duration":50,"colors":["0","0","0x00007F","0","0","0","0","0","0","0","0x00007F","0","0","0","0","0"]},{"duration":50,"colors":["0","0","0","0x00007F","0","0","0","0","0","0","0","0x00007F","0","0","0","0"]},{"duration":50,"colors":["0","0","0","0","0x00007F","0","0","0","0","0","0","0","0x00007F","0","0","0"]},{"duration":50,"colors":["0","0","0","0","0","0x00007F","0","0","0","0","0","0","0","0x00007F","0","0"]},{"duration":50,"colors":["0","0","0","0","0","0","0x00007F","0","0","0","0","0","0","0","0x00007F","0"]},{"duration":50,"colors":["0","0","0","0","0","0","0","0x00007F","0","0","0","0","0","0","0","0x00007F"]},{"duration":0,"colors":["0","0x00007F","0","0x00007F","0","0x00007F","0","0x00007F","0","0x00007F","0","0x00007F","0","0x00007F","0","0x00007F"]}]},"WIFI_CONFIG_END":{"repetitions":1,"clearOnDone":true,"frames":[{"duration":50,"colors":["0xFF7F00","0","0","0","0","0","0","0","0xFF7F00","0","0","0","0","0","0","0"]},{"duration":50,"colors":["0","0xFF7F00","0","0","0","0","0","0","0","0xFF7F00","0","0","0","0","0","0"]},{"duration":50,"colors":["0","0","0xFF7F00","0","0","0","0","0","0","0","0xFF7F00","0","0","0","0","0"]},{"duration":50,"colors":["0","0","0","0xFF7F00","0","0","0","0","0","0","0","0xFF7F00","0","0","0","0"]},{"duration":50,"colors":["0","0","0","0","0xFF7F00","0","0","0","0","0","0","0","0xFF7F00","0","0","0"]},{"duration":50,"colors":["0","0","0","0","0","0xFF7F00","0","0","0","0","0","0","0","0xFF7F00","0","0"]},{"duration":50,"colors":["0","0","0","0","0","0","0xFF7F00","0","0","0","0","0","0","0","0xFF7F00","0"]},{"duration":50,"colors":["0","0","0","0","0","0","0","0xFF7F00","0","0","0","0","0","0","0","0xFF7F00"]}]},"UPDATED":{"repetitions":3,"clearOnDone":true,"frames":[{"duration":50,"colors":["0xFF00C4","0","0","0","0xFF00C4","0","0","0","0xFF00C4","0","0","0","0xFF00C4","0","0","0"]},{"duration":50,"colors":["0","0xFF00C4","0","0","0","0xFF00C4","0","0","0","0xFF00C4","0","0","0","0xFF00C4","0","0"]},{"duration":50,"colors":["0","0","0xFF00C4","0","0","0","0xFF00C4","0","0","0","0xFF00C4","0","0","0","0xFF00C4","0"]},{"duration":50,"colors":["0","0","0","0xFF00C4","0","0","0","0xFF00C4","0","0","0","0xFF00C4","0","0","0","0xFF00C4"]}]},"STORAGE_ERROR":{"repetitions":0,"clearOnDone":false,"frames":[{"duration":50,"colors":["0xFF0000","0","0","0","0","0","0","0","0","0","0","0","0","0","0","0"]}]},"I2S_PLAYER_ERROR":{"repetitions":0,"clearOnDone":false,"frames":[{"duration":50,"colors":["0xFF0000","0xFF0000","0","0","0","0","0","0","0","0","0","0","0","0","0","0"]}]},"WEBHOOK_ERROR":{"repetitions":0,"clearOnDone":false,"frames":[{"duration":50,"colors":["0xFF0000","0xFF0000","0xFF0000","0","0","0","0","0","0","0","0","0","0","0","0","0"]}]},"DOORBELL_READY":{"repetitions":0,"clearOnDone":true,"frames":[{"duration":50,"colors":["0x007F00","0","0","0","0","0","0","0","0","0","0","0","0","0","0","0"]},{"duration":50,"colors":["0","0x007F00","0","0","0","0","0","0","0","0","0","0","0","0","0","0"]},{"duration":50,"colors":["0","0","0x007F00","0","0","0","0","0","0","0","0","0","0","0","0","0"]},{"duration":50,"colors":["0","0","0","0x007F00","0","0","0","0","0","0","0","0","0","0","0","0"]},{"duration":50,"colors":["0","0","0","0","0x007F00","0","0","0","0","0","0","0","0","0","0","0"]},{"duration":50,"colors":["0","0","0","0","0","0x007F00","0","0","0","0","0","0","0","0","0","0"]},{"duration":50,"colors":["0","0","0","0","0","0","0x007F00","0","0","0","0","0","0","0","0","0"]},{"duration":50,"colors":["0","0","0","0","0","0","0","0x007F00","0","0","0","0","0","0","0","0"]},{"duration":50,"colors":["0","0","0","0","0","0","0","0","0x007F00","0","0","0","0","0","0","0"]},{"duration":50,"colors":["0","0","0","0","0","0","0","0","0","0x007F00","0","0","0","0","0","0"]},{"duration":50,"colors":["0","0","0","0","0","0","0","0","0","0","0x007F00","0","0","0","0","0"]},{"duration":50,"colors":["0","0","0","0","0","0","0","0","0","0","0","0x007F00","0","0","0","0"]},{"duration":50,"colors":["0","0","0","0","0","0","0","0","0","0","0","0","0x007F00","0","0","0"]},{"duration":50,"colors":["0","0","0","0","0","0","0","0","0","0","0","0","0","0x007F00","0","0"]},{"duration":50,"colors":["0","0","0","0","0","0","0","0","0","0","0","0","0","0","0x007F00","0"]},{"duration":50,"colors":["0","0","0","0","0","0","0","0","0","0","0","0","0","0","0","0x007F00"]}]}}})";
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include "ChimeCache.h"
+
+/// @brief Creates a chime cache
+/// @param Storage Reference to the storage object the files are loaded from
+ChimeCache::ChimeCache(Storage* Storage) : cache_fs(fs::FSImplPtr(new CacheFS(this))) {
+	storage = Storage;
+	budget = CHIME_CACHE_DEFAULT_KB * 1024;
+	cache_mutex = xSemaphoreCreateMutex();
+}
+
+/// @brief Sets the maximum number of bytes of files to keep in memory, takes effect on the next preload
+/// @param Budget The budget in bytes, 0 disables the cache
+void ChimeCache::setBudget(size_t Budget) {
+	budget = Budget;
+}
+
+/// @brief Gets the maximum number of bytes of files to keep in memory
+/// @return The budget in bytes
+size_t ChimeCache::getBudget() {
+	return budget;
+}
+
+/// @brief Starts loading sound files into memory, one file per call to preloadNext(). Files that changed on storage are dropped now and loaded again.
+/// @param files The full paths of the files to load
+void ChimeCache::startPreload(const std::vector<String>& files) {
+	// Never use internal RAM for sounds
+	size_t limit = psramFound() ? budget : 0;
+	size_t size;
+	time_t last_write;
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	for (int i = entries.size() - 1; i >= 0; i--) {
+		if (limit == 0 || !storage->getFileInfo(entries[i].path, size, last_write) || size != entries[i].size || last_write != entries[i].last_write) {
+			remove(i);
+		}
+	}
+	xSemaphoreGive(cache_mutex);
+	preload_files.clear();
+	preload_next = 0;
+	if (limit == 0) {
+		return;
+	}
+	preload_files = files;
+	// Files used from here on are pinned, so a full cache can't evict the files being preloaded
+	preload_pinned = use_clock + 1;
+}
+
+/// @brief Loads the next file passed to startPreload(), evicting the least recently used files if needed.
+/// Loading one file at a time lets the caller handle other work between files.
+/// @return True if there are more files to load
+bool ChimeCache::preloadNext() {
+	if (preload_next >= preload_files.size()) {
+		return false;
+	}
+	const String& path = preload_files[preload_next++];
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	int index = find(path);
+	if (index >= 0) {
+		entries[index].last_used = ++use_clock;
+	}
+	xSemaphoreGive(cache_mutex);
+	if (index < 0) {
+		size_t size;
+		time_t last_write;
+		if (!storage->getFileInfo(path, size, last_write)) {
+			Serial.println("Could not cache " + path);
+		} else {
+			load(path, size, last_write, preload_pinned);
+		}
+	}
+	if (preload_next < preload_files.size()) {
+		return true;
+	}
+	preload_files.clear();
+	Serial.println("Chime cache using " + String(used / 1024) + " of " + String(budget / 1024) + " KB");
+	return false;
+}
+
+/// @brief Checks if a file is in memory
+/// @param path The full path of the file
+/// @return True if the file is in memory
+bool ChimeCache::contains(const String& path) {
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	bool found = find(path) >= 0;
+	xSemaphoreGive(cache_mutex);
+	return found;
+}
+
+/// @brief Gets a read-only file system that serves the files in memory
+/// @return The file system
+fs::FS& ChimeCache::getFS() {
+	return cache_fs;
+}
+
+/// @brief Opens a sound file from memory, or from storage if it isn't cached
+/// @param path The full path of the file
+/// @param cached Set to true if the file was opened from memory
+/// @return The open file, which is false if it couldn't be opened
+File ChimeCache::openFile(const String& path, bool& cached) {
+	File file = contains(path) ? cache_fs.open(path) : File();
+	cached = file;
+	if (!file)
+		file = storage->openFile(path);
+	return file;
+}
+
+/// @brief Reads a file from storage into memory
+/// @param path The full path of the file
+/// @param size The size of the file in bytes
+/// @param last_write The last write time of the file
+/// @param pinned Entries used at or after this are not evicted
+/// @return True on success
+bool ChimeCache::load(const String& path, size_t size, time_t last_write, uint32_t pinned) {
+	if (size == 0 || size > budget) {
+		Serial.println("Not caching " + path + ", it doesn't fit");
+		return false;
+	}
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	evict(size, pinned);
+	bool fits = used + size <= budget;
+	xSemaphoreGive(cache_mutex);
+	if (!fits) {
+		Serial.println("Not caching " + path + ", the cache is full");
+		return false;
+	}
+	uint8_t* buffer = (uint8_t*)ps_malloc(size);
+	if (buffer == NULL) {
+		Serial.println("Not caching " + path + ", out of memory");
+		return false;
+	}
+	std::shared_ptr<uint8_t> data(buffer, free);
+	File file = storage->openFile(path);
+	bool success = file && file.read(buffer, size) == size;
+	file.close();
+	if (!success) {
+		Serial.println("Could not cache " + path);
+		return false;
+	}
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	entries.push_back(entry { path, data, size, last_write, ++use_clock });
+	used += size;
+	xSemaphoreGive(cache_mutex);
+	return true;
+}
+
+/// @brief Evicts the least recently used entries until there's room for a new file. Must hold the cache mutex.
+/// @param needed The number of bytes needed
+/// @param pinned Entries used at or after this are not evicted
+void ChimeCache::evict(size_t needed, uint32_t pinned) {
+	while (used + needed > budget) {
+		int oldest = -1;
+		for (int i = 0; i < entries.size(); i++) {
+			if (entries[i].last_used < pinned && (oldest < 0 || entries[i].last_used < entries[oldest].last_used)) {
+				oldest = i;
+			}
+		}
+		if (oldest < 0) {
+			return;
+		}
+		Serial.println("Evicting " + entries[oldest].path + " from chime cache");
+		remove(oldest);
+	}
+}
+
+/// @brief Finds a file in memory. Must hold the cache mutex.
+/// @param path The full path of the file
+/// @return The index of the entry, or -1 if the file isn't in memory
+int ChimeCache::find(const String& path) {
+	for (int i = 0; i < entries.size(); i++) {
+		if (entries[i].path == path) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/// @brief Removes an entry, its memory is freed once no open file uses it. Must hold the cache mutex.
+/// @param index The index of the entry
+void ChimeCache::remove(int index) {
+	used -= entries[index].size;
+	entries.erase(entries.begin() + index);
+}
+
+/// @brief Opens a file in memory and marks it as recently used
+/// @param path The full path of the file
+/// @return The open file, or an empty pointer if the file isn't in memory
+fs::FileImplPtr ChimeCache::open(const char* path) {
+	fs::FileImplPtr file;
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	int index = find(path);
+	if (index >= 0) {
+		entries[index].last_used = ++use_clock;
+		file = std::make_shared<CachedFile>(entries[index]);
+	}
+	xSemaphoreGive(cache_mutex);
+	return file;
+}
+
+/// @brief Opens a file in the cache for reading
+/// @param path The full path of the file
+/// @param mode Must be FILE_READ
+/// @param create Ignored
+/// @return The open file, or an empty pointer if the file isn't in memory
+fs::FileImplPtr ChimeCache::CacheFS::open(const char* path, const char* mode, const bool create) {
+	if (strcmp(mode, FILE_READ) != 0) {
+		return fs::FileImplPtr();
+	}
+	return cache->open(path);
+}
+
+/// @brief Creates an open file reading from a cache entry
+/// @param Entry The entry to read
+ChimeCache::CachedFile::CachedFile(const entry& Entry) {
+	data = Entry.data;
+	length = Entry.size;
+	last_write = Entry.last_write;
+	file_path = Entry.path;
+}
+
+/// @brief Copies bytes from the file
+/// @param buf The buffer to copy to
+/// @param size The maximum number of bytes to copy
+/// @return The number of bytes copied
+size_t ChimeCache::CachedFile::read(uint8_t* buf, size_t size) {
+	if (!data) {
+		return 0;
+	}
+	size_t count = min(size, length - offset);
+	memcpy(buf, data.get() + offset, count);
+	offset += count;
+	return count;
+}
+
+/// @brief Moves the read position
+/// @param pos The new position, relative to mode
+/// @param mode Whether pos is from the start, the current position, or the end of the file
+/// @return True if the position is within the file
+bool ChimeCache::CachedFile::seek(uint32_t pos, fs::SeekMode mode) {
+	size_t target;
+	switch (mode) {
+		case fs::SeekCur:
+			target = offset + pos;
+			break;
+		case fs::SeekEnd:
+			target = length + pos;
+			break;
+		default:
+			target = pos;
+			break;
+	}
+	if (target > length) {
+		return false;
+	}
+	offset = target;
+	return true;
+}
+
+/// @brief Gets the name of the file without its directory
+/// @return The file name
+const char* ChimeCache::CachedFile::name() const {
+	int slash = file_path.lastIndexOf('/');
+	return file_path.c_str() + slash + 1;
+}
@@ -0,0 +1,140 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+#include <FSImpl.h>
+#include <Storage.h>
+#include <memory>
+#include <vector>
+
+/// @brief Keeps chime sound files in PSRAM and serves them as a read-only file system, so playback doesn't wait on storage
+class ChimeCache {
+	public:
+		ChimeCache(Storage* Storage);
+		void setBudget(size_t Budget);
+		size_t getBudget();
+		void startPreload(const std::vector<String>& files);
+		bool preloadNext();
+		bool contains(const String& path);
+		fs::FS& getFS();
+		File openFile(const String& path, bool& cached);
+
+	private:
+		/// @brief Default memory budget in KB when PSRAM is available
+		#define CHIME_CACHE_DEFAULT_KB 4096
+
+		/// @brief A sound file held in memory
+		struct entry {
+			/// @brief The full path of the sound file
+			String path;
+
+			/// @brief The contents of the file, kept alive by open files after the entry is evicted
+			std::shared_ptr<uint8_t> data;
+
+			/// @brief Size of the file in bytes
+			size_t size;
+
+			/// @brief Last write time of the file when it was loaded
+			time_t last_write;
+
+			/// @brief Value of use_clock when the entry was last loaded or played, the lowest is evicted first
+			uint32_t last_used;
+		};
+
+		/// @brief An open file reading from a cache entry
+		class CachedFile : public fs::FileImpl {
+			public:
+				CachedFile(const entry& Entry);
+				size_t write(const uint8_t *buf, size_t size) { return 0; }
+				size_t read(uint8_t* buf, size_t size);
+				void flush() {}
+				bool seek(uint32_t pos, fs::SeekMode mode);
+				size_t position() const { return offset; }
+				size_t size() const { return length; }
+				bool setBufferSize(size_t size) { return true; }
+				void close() { data.reset(); }
+				time_t getLastWrite() { return last_write; }
+				const char* path() const { return file_path.c_str(); }
+				const char* name() const;
+				boolean isDirectory(void) { return false; }
+				fs::FileImplPtr openNextFile(const char* mode) { return fs::FileImplPtr(); }
+				boolean seekDir(long position) { return false; }
+				String getNextFileName(void) { return ""; }
+				String getNextFileName(bool* isDir) { return ""; }
+				void rewindDirectory(void) {}
+				operator bool() { return data != nullptr; }
+
+			private:
+				/// @brief The contents of the file
+				std::shared_ptr<uint8_t> data;
+
+				/// @brief Size of the file in bytes
+				size_t length;
+
+				/// @brief Current read position
+				size_t offset = 0;
+
+				/// @brief Last write time of the file
+				time_t last_write;
+
+				/// @brief The full path of the file
+				String file_path;
+		};
+
+		/// @brief Read-only file system backed by the cache
+		class CacheFS : public fs::FSImpl {
+			public:
+				CacheFS(ChimeCache* Cache) : cache(Cache) {}
+				fs::FileImplPtr open(const char* path, const char* mode, const bool create);
+				bool exists(const char* path) { return cache->contains(path); }
+				bool rename(const char* pathFrom, const char* pathTo) { return false; }
+				bool remove(const char* path) { return false; }
+				bool mkdir(const char *path) { return false; }
+				bool rmdir(const char *path) { return false; }
+
+			private:
+				/// @brief The cache holding the files
+				ChimeCache* cache;
+		};
+
+		/// @brief Reference to the storage object the files are loaded from
+		Storage* storage;
+
+		/// @brief Files currently in memory
+		std::vector<entry> entries;
+
+		/// @brief Maximum number of bytes of files to keep in memory
+		size_t budget;
+
+		/// @brief Number of bytes of files currently in memory
+		size_t used = 0;
+
+		/// @brief Incremented each time an entry is used
+		uint32_t use_clock = 0;
+
+		/// @brief Protects the entries, files are played from the main loop and the webserver
+		SemaphoreHandle_t cache_mutex;
+
+		/// @brief The file system serving the cached files
+		fs::FS cache_fs;
+
+		/// @brief Files waiting to be preloaded, only used by the audio task
+		std::vector<String> preload_files;
+
+		/// @brief Position in preload_files of the next file to load
+		size_t preload_next = 0;
+
+		/// @brief Entries used at or after this are not evicted while preloading
+		uint32_t preload_pinned = 0;
+
+		bool load(const String& path, size_t size, time_t last_write, uint32_t pinned);
+		void evict(size_t needed, uint32_t pinned);
+		int find(const String& path);
+		void remove(int index);
+		fs::FileImplPtr open(const char* path);
+};
@@ -0,0 +1,386 @@
+#include "ChimeConverter.h"
+#include <string.h>
+
+/// @brief IMA ADPCM quantizer step sizes
+static const int16_t adpcm_steps[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+/// @brief IMA ADPCM step index change for each code, ignoring the sign bit
+static const int8_t adpcm_index_changes[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+/// @brief Reads a little-endian 16-bit value
+/// @param data The first byte of the value
+/// @return The value
+static uint16_t readLE16(const uint8_t* data) {
+	return data[0] | (data[1] << 8);
+}
+
+/// @brief Reads a little-endian 32-bit value
+/// @param data The first byte of the value
+/// @return The value
+static uint32_t readLE32(const uint8_t* data) {
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/// @brief Creates a converter, the chime header is written once the WAV format has been read
+/// @param Output The destination of the converted chime
+/// @param Format The encoding of the converted samples, one of formats
+ChimeConverter::ChimeConverter(Sink* Output, uint16_t Format) {
+	output = Output;
+	memset(&header, 0, sizeof(header));
+	header.magic = CHIME_MAGIC;
+	header.version = CHIME_VERSION;
+	header.format = Format;
+	header.block_frames = CHIME_BLOCK_FRAMES;
+	header.gain = CHIME_UNITY_GAIN;
+	memset(adpcm, 0, sizeof(adpcm));
+}
+
+/// @brief Converts the next part of the WAV file
+/// @param data The next bytes of the WAV file
+/// @param length The number of bytes
+/// @return True on success
+bool ChimeConverter::write(const uint8_t* data, size_t length) {
+	while (length > 0 && state != WAV_DONE && state != WAV_ERROR) {
+		if (state == WAV_SKIP) {
+			size_t count = length < remaining ? length : remaining;
+			data += count;
+			length -= count;
+			remaining -= count;
+		} else if (state == WAV_DATA) {
+			// Samples are collected into buffer one frame at a time
+			size_t frame_bytes = sample_bytes * header.channels;
+			while (length > 0 && remaining > 0) {
+				size_t count = frame_bytes - buffered;
+				count = length < count ? length : count;
+				count = remaining < count ? remaining : count;
+				memcpy(buffer + buffered, data, count);
+				buffered += count;
+				data += count;
+				length -= count;
+				remaining -= count;
+				if (buffered == frame_bytes) {
+					buffered = 0;
+					addFrame(buffer);
+					if (block_fill == CHIME_BLOCK_FRAMES && !flushBlock()) {
+						state = WAV_ERROR;
+						return false;
+					}
+				}
+			}
+			if (remaining == 0) {
+				// Anything after the samples isn't needed
+				state = WAV_DONE;
+			}
+			continue;
+		} else {
+			size_t count = needed - buffered;
+			count = length < count ? length : count;
+			memcpy(buffer + buffered, data, count);
+			buffered += count;
+			data += count;
+			length -= count;
+			if (buffered < needed) {
+				continue;
+			}
+			buffered = 0;
+			if (state == WAV_RIFF) {
+				if (memcmp(buffer, "RIFF", 4) != 0 || memcmp(buffer + 8, "WAVE", 4) != 0) {
+					state = WAV_ERROR;
+					return false;
+				}
+				state = WAV_CHUNK;
+				needed = 8;
+			} else if (state == WAV_CHUNK) {
+				if (!parseChunk()) {
+					state = WAV_ERROR;
+					return false;
+				}
+			} else if (!parseFormat()) {
+				state = WAV_ERROR;
+				return false;
+			}
+		}
+		if (state == WAV_SKIP && remaining == 0) {
+			state = WAV_CHUNK;
+			needed = 8;
+		}
+	}
+	return state != WAV_ERROR;
+}
+
+/// @brief Converts the last partial block and writes the final chime header with the normalization gain
+/// @return True on success
+bool ChimeConverter::finish() {
+	if ((state != WAV_DATA && state != WAV_DONE) || !flushBlock() || header.frame_count == 0) {
+		state = WAV_ERROR;
+		return false;
+	}
+	header.gain = normalizationGain(gated_energy, gated_samples, peak);
+	if (!output->patch(0, &header, sizeof(header))) {
+		state = WAV_ERROR;
+		return false;
+	}
+	state = WAV_DONE;
+	return true;
+}
+
+/// @brief Checks if the conversion failed
+/// @return True if the WAV file couldn't be read or the chime couldn't be written
+bool ChimeConverter::failed() {
+	return state == WAV_ERROR;
+}
+
+/// @brief Gets the header of the converted chime
+/// @return The header, complete once finish() succeeds
+const ChimeConverter::chime_header& ChimeConverter::getHeader() {
+	return header;
+}
+
+/// @brief Calculates the gain that brings a sound to CHIME_TARGET_RMS, limited so the peak doesn't clip
+/// @param energy Sum of the squares of the samples that count towards the loudness
+/// @param samples Number of samples that count towards the loudness
+/// @param peak Largest absolute sample value
+/// @return The gain in 8.8 fixed point, CHIME_UNITY_GAIN if the sound is silent
+uint16_t ChimeConverter::normalizationGain(uint64_t energy, uint64_t samples, int32_t peak) {
+	if (samples == 0 || peak == 0) {
+		return CHIME_UNITY_GAIN;
+	}
+	// Integer square root of the mean square
+	uint64_t mean_square = energy / samples;
+	uint32_t rms = 0;
+	for (uint32_t bit = 1 << 15; bit > 0; bit >>= 1) {
+		if ((uint64_t)(rms | bit) * (rms | bit) <= mean_square)
+			rms |= bit;
+	}
+	if (rms == 0) {
+		return CHIME_UNITY_GAIN;
+	}
+	uint32_t gain = (uint32_t)CHIME_TARGET_RMS * CHIME_UNITY_GAIN / rms;
+	uint32_t limit = (uint32_t)32767 * CHIME_UNITY_GAIN / peak;
+	if (gain > limit)
+		gain = limit;
+	if (gain > CHIME_MAX_GAIN)
+		gain = CHIME_MAX_GAIN;
+	else if (gain < CHIME_MIN_GAIN)
+		gain = CHIME_MIN_GAIN;
+	return gain;
+}
+
+/// @brief Gets the most bytes of samples a block of a chime can hold
+/// @param header The header of the chime
+/// @return The size of an ADPCM block, or of a full block of PCM samples
+size_t ChimeConverter::blockBytes(const chime_header& header) {
+	if (header.format == CHIME_ADPCM)
+		return header.channels * CHIME_ADPCM_BLOCK_BYTES;
+	return header.channels * CHIME_BLOCK_FRAMES * sizeof(int16_t);
+}
+
+/// @brief Decodes a block of an ADPCM chime
+/// @param block The block, blockBytes() long
+/// @param channels The number of channels of the chime
+/// @param frames Receives CHIME_BLOCK_FRAMES frames, interleaved by channel
+void ChimeConverter::decodeBlock(const uint8_t* block, uint16_t channels, int16_t* frames) {
+	for (uint16_t c = 0; c < channels; c++) {
+		const uint8_t* data = block + c * CHIME_ADPCM_BLOCK_BYTES;
+		adpcm_state state { (int16_t)readLE16(data), data[2] > 88 ? 88 : data[2] };
+		frames[c] = state.predictor;
+		for (int i = 1; i < CHIME_BLOCK_FRAMES; i++) {
+			uint8_t codes = data[4 + (i - 1) / 2];
+			frames[i * channels + c] = decodeSample(state, (i - 1) & 1 ? codes >> 4 : codes & 0x0F);
+		}
+	}
+}
+
+/// @brief Encodes one channel of samples into an IMA-ADPCM block: the first sample and step index, then two samples per byte
+/// @param samples The first sample of the channel
+/// @param count The number of samples to encode, odd so the block is filled
+/// @param stride The distance between samples of the channel, the number of channels
+/// @param index The step index, carried from block to block so the quality doesn't dip at the start of each block
+/// @param block Receives 4 + (count - 1) / 2 bytes
+void ChimeConverter::encodeAdpcm(const int16_t* samples, size_t count, size_t stride, int32_t& index, uint8_t* block) {
+	// Each block starts from an exact sample so it can be decoded on its own
+	adpcm_state state { samples[0], index };
+	block[0] = state.predictor & 0xFF;
+	block[1] = (state.predictor >> 8) & 0xFF;
+	block[2] = state.index;
+	block[3] = 0;
+	memset(block + 4, 0, (count - 1) / 2);
+	for (size_t i = 1; i < count; i++) {
+		uint8_t code = encodeSample(state, samples[i * stride]);
+		block[4 + (i - 1) / 2] |= (i - 1) & 1 ? code << 4 : code;
+	}
+	index = state.index;
+}
+
+/// @brief Handles a chunk header of the WAV file
+/// @return True on success
+bool ChimeConverter::parseChunk() {
+	uint32_t size = readLE32(buffer + 4);
+	if (memcmp(buffer, "fmt ", 4) == 0) {
+		if (size < 16) {
+			return false;
+		}
+		needed = size < sizeof(buffer) ? size : sizeof(buffer);
+		remaining = size + (size & 1) - needed;
+		state = WAV_FORMAT;
+	} else if (memcmp(buffer, "data", 4) == 0) {
+		// The format has to come first so the header can be written
+		if (sample_bytes == 0) {
+			return false;
+		}
+		remaining = size;
+		state = WAV_DATA;
+	} else {
+		remaining = size + (size & 1);
+		state = WAV_SKIP;
+	}
+	return true;
+}
+
+/// @brief Handles the format chunk of the WAV file and writes the chime header
+/// @return True if the format can be converted
+bool ChimeConverter::parseFormat() {
+	uint16_t tag = readLE16(buffer);
+	// WAVE_FORMAT_EXTENSIBLE keeps the real format at the start of its sub-format GUID
+	if (tag == 0xFFFE && needed >= 26)
+		tag = readLE16(buffer + 24);
+	header.channels = readLE16(buffer + 2);
+	header.sample_rate = readLE32(buffer + 4);
+	uint16_t bits = readLE16(buffer + 14);
+	if (tag != 1 || header.channels < 1 || header.channels > 2 || header.sample_rate == 0 || (bits != 8 && bits != 16 && bits != 24 && bits != 32)) {
+		return false;
+	}
+	sample_bytes = bits / 8;
+	state = WAV_SKIP;
+	return output->write(&header, sizeof(header));
+}
+
+/// @brief Adds a frame of the WAV file to the block being converted
+/// @param frame The samples of each channel of the frame
+void ChimeConverter::addFrame(const uint8_t* frame) {
+	for (uint16_t c = 0; c < header.channels; c++) {
+		const uint8_t* sample = frame + c * sample_bytes;
+		int16_t value;
+		if (sample_bytes == 1) {
+			// 8-bit WAV samples are unsigned
+			value = (int16_t)((sample[0] - 128) << 8);
+		} else {
+			// Keep the most significant 16 bits
+			value = (int16_t)readLE16(sample + sample_bytes - 2);
+		}
+		frames[block_fill * header.channels + c] = value;
+	}
+	block_fill++;
+}
+
+/// @brief Encodes and writes the block being converted
+/// @return True on success
+bool ChimeConverter::flushBlock() {
+	if (block_fill == 0) {
+		return true;
+	}
+	analyzeBlock();
+	header.frame_count += block_fill;
+	if (header.format == CHIME_PCM) {
+		size_t size = block_fill * header.channels * sizeof(int16_t);
+		header.data_size += size;
+		block_fill = 0;
+		return output->write(frames, size);
+	}
+	// ADPCM blocks are always full, pad with the last frame
+	for (int i = block_fill; i < CHIME_BLOCK_FRAMES; i++) {
+		for (uint16_t c = 0; c < header.channels; c++) {
+			frames[i * header.channels + c] = frames[(block_fill - 1) * header.channels + c];
+		}
+	}
+	block_fill = 0;
+	uint8_t block[CHIME_ADPCM_BLOCK_BYTES];
+	for (uint16_t c = 0; c < header.channels; c++) {
+		encodeAdpcm(frames + c, CHIME_BLOCK_FRAMES, header.channels, adpcm[c].index, block);
+		if (!output->write(block, CHIME_ADPCM_BLOCK_BYTES)) {
+			return false;
+		}
+		header.data_size += CHIME_ADPCM_BLOCK_BYTES;
+	}
+	return true;
+}
+
+/// @brief Adds the block being converted to the loudness, unless it's below the gate
+void ChimeConverter::analyzeBlock() {
+	uint64_t energy = 0;
+	uint32_t samples = block_fill * header.channels;
+	for (uint32_t i = 0; i < samples; i++) {
+		int32_t sample = frames[i];
+		energy += sample * sample;
+		if (sample < 0)
+			sample = -sample;
+		if (sample > peak)
+			peak = sample;
+	}
+	if (energy >= (uint64_t)CHIME_GATE_MEAN_SQUARE * samples) {
+		gated_energy += energy;
+		gated_samples += samples;
+	}
+}
+
+/// @brief Encodes a sample as a 4-bit IMA ADPCM code
+/// @param state The encoder state of the channel
+/// @param sample The sample to encode
+/// @return The code
+uint8_t ChimeConverter::encodeSample(adpcm_state& state, int16_t sample) {
+	int32_t step = adpcm_steps[state.index];
+	int32_t diff = sample - state.predictor;
+	uint8_t code = 0;
+	if (diff < 0) {
+		code = 8;
+		diff = -diff;
+	}
+	if (diff >= step) {
+		code |= 4;
+		diff -= step;
+	}
+	step >>= 1;
+	if (diff >= step) {
+		code |= 2;
+		diff -= step;
+	}
+	step >>= 1;
+	if (diff >= step) {
+		code |= 1;
+	}
+	// Track the decoder so rounding errors don't accumulate
+	decodeSample(state, code);
+	return code;
+}
+
+/// @brief Decodes a 4-bit IMA ADPCM code
+/// @param state The decoder state of the channel
+/// @param code The code
+/// @return The decoded sample
+int16_t ChimeConverter::decodeSample(adpcm_state& state, uint8_t code) {
+	int32_t step = adpcm_steps[state.index];
+	int32_t diff = step >> 3;
+	if (code & 4)
+		diff += step;
+	if (code & 2)
+		diff += step >> 1;
+	if (code & 1)
+		diff += step >> 2;
+	state.predictor += code & 8 ? -diff : diff;
+	if (state.predictor > 32767)
+		state.predictor = 32767;
+	else if (state.predictor < -32768)
+		state.predictor = -32768;
+	state.index += adpcm_index_changes[code & 7];
+	if (state.index < 0)
+		state.index = 0;
+	else if (state.index > 88)
+		state.index = 88;
+	return state.predictor;
+}
@@ -0,0 +1,168 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/// @brief Marks a device-native chime file ("CHIM")
+#define CHIME_MAGIC 0x4D494843
+
+/// @brief Version of the device-native chime layout, increment when the layout changes
+#define CHIME_VERSION 2
+
+/// @brief Extension of device-native chime files
+#define CHIME_EXTENSION ".chime"
+
+/// @brief Number of frames in each block of a chime
+#define CHIME_BLOCK_FRAMES 1017
+
+/// @brief Size in bytes of one channel of an ADPCM block: a 4 byte header followed by two samples per byte
+#define CHIME_ADPCM_BLOCK_BYTES (4 + (CHIME_BLOCK_FRAMES - 1) / 2)
+
+/// @brief Gain in 8.8 fixed point that leaves a chime unchanged
+#define CHIME_UNITY_GAIN 256
+
+/// @brief RMS level chimes are normalized to, -18 dBFS
+#define CHIME_TARGET_RMS 4125
+
+/// @brief Blocks quieter than this mean square (-60 dBFS) are left out of the loudness, so silence doesn't make a chime louder
+#define CHIME_GATE_MEAN_SQUARE 1073
+
+/// @brief Smallest and largest normalization gains in 8.8 fixed point
+#define CHIME_MIN_GAIN (CHIME_UNITY_GAIN / 4)
+#define CHIME_MAX_GAIN (CHIME_UNITY_GAIN * 4)
+
+/// @brief Converts WAV files into chimes that can be sent to I2S without a decoder, one chunk at a time as they're uploaded.
+/// Doesn't use Arduino or the heap, so it also builds on a PC and can be kept in the memory of a web request.
+class ChimeConverter {
+	public:
+		/// @brief Encodings of the samples of a chime
+		enum formats { CHIME_PCM, CHIME_ADPCM };
+
+		/// @brief Header at the start of a device-native chime file
+		struct chime_header {
+			/// @brief Always CHIME_MAGIC
+			uint32_t magic;
+
+			/// @brief Always CHIME_VERSION
+			uint16_t version;
+
+			/// @brief The encoding of the samples, one of formats
+			uint16_t format;
+
+			/// @brief Sample rate in Hz
+			uint32_t sample_rate;
+
+			/// @brief Number of channels, 1 or 2
+			uint16_t channels;
+
+			/// @brief Number of frames in each block, always CHIME_BLOCK_FRAMES
+			uint16_t block_frames;
+
+			/// @brief Number of frames of sound, the last block is padded for ADPCM
+			uint32_t frame_count;
+
+			/// @brief Size in bytes of the samples that follow the header
+			uint32_t data_size;
+
+			/// @brief Gain in 8.8 fixed point that brings the chime to CHIME_TARGET_RMS without clipping
+			uint16_t gain;
+
+			/// @brief Unused, keeps the header aligned
+			uint16_t reserved;
+		};
+
+		/// @brief Destination for the converted chime
+		class Sink {
+			public:
+				virtual ~Sink() {}
+				/// @brief Appends data to the sink
+				/// @param data The data to append
+				/// @param size The number of bytes to append
+				/// @return True on success
+				virtual bool write(const void* data, size_t size) = 0;
+				/// @brief Overwrites data that was already appended
+				/// @param offset The offset of the data to overwrite
+				/// @param data The new data
+				/// @param size The number of bytes to overwrite
+				/// @return True on success
+				virtual bool patch(size_t offset, const void* data, size_t size) = 0;
+		};
+
+		ChimeConverter(Sink* Output, uint16_t Format);
+		bool write(const uint8_t* data, size_t length);
+		bool finish();
+		bool failed();
+		const chime_header& getHeader();
+		static uint16_t normalizationGain(uint64_t energy, uint64_t samples, int32_t peak);
+		static size_t blockBytes(const chime_header& header);
+		static void decodeBlock(const uint8_t* block, uint16_t channels, int16_t* frames);
+		static void encodeAdpcm(const int16_t* samples, size_t count, size_t stride, int32_t& index, uint8_t* block);
+
+	private:
+		/// @brief Parts of a WAV file
+		enum wav_states { WAV_RIFF, WAV_CHUNK, WAV_FORMAT, WAV_SKIP, WAV_DATA, WAV_DONE, WAV_ERROR };
+
+		/// @brief ADPCM encoder state of one channel
+		struct adpcm_state {
+			/// @brief The last decoded sample
+			int32_t predictor;
+
+			/// @brief Index into the step table
+			int32_t index;
+		};
+
+		/// @brief The destination of the converted chime
+		Sink* output;
+
+		/// @brief The chime header, written again with the final counts once the conversion is done
+		chime_header header;
+
+		/// @brief The part of the WAV file being read
+		uint8_t state = WAV_RIFF;
+
+		/// @brief Holds the header or chunk currently being read
+		uint8_t buffer[40];
+
+		/// @brief Number of bytes in buffer
+		size_t buffered = 0;
+
+		/// @brief Number of bytes needed in buffer before it can be parsed
+		size_t needed = 12;
+
+		/// @brief Bytes left in the current chunk
+		uint32_t remaining = 0;
+
+		/// @brief Size of each sample in the WAV file in bytes
+		uint16_t sample_bytes = 0;
+
+		/// @brief Frames of the block being converted, interleaved by channel
+		int16_t frames[CHIME_BLOCK_FRAMES * 2];
+
+		/// @brief Number of frames in the block being converted
+		uint16_t block_fill = 0;
+
+		/// @brief ADPCM encoder state of each channel
+		adpcm_state adpcm[2];
+
+		/// @brief Sum of the squares of the samples in blocks above the loudness gate
+		uint64_t gated_energy = 0;
+
+		/// @brief Number of samples in blocks above the loudness gate
+		uint64_t gated_samples = 0;
+
+		/// @brief Largest absolute sample value
+		int32_t peak = 0;
+
+		bool parseChunk();
+		bool parseFormat();
+		void addFrame(const uint8_t* frame);
+		void analyzeBlock();
+		bool flushBlock();
+		static uint8_t encodeSample(adpcm_state& state, int16_t sample);
+		static int16_t decodeSample(adpcm_state& state, uint8_t code);
+};
@@ -0,0 +1,351 @@
+#include "ChimeIndex.h"
+
+/// @brief Bitrates in kbps of MPEG 1 layer III frames
+static const uint16_t mp3_bitrates_v1[15] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 };
+
+/// @brief Bitrates in kbps of MPEG 2 and 2.5 layer III frames
+static const uint16_t mp3_bitrates_v2[15] = { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 };
+
+/// @brief Sample rates in Hz of MPEG 1 frames, halved for MPEG 2 and quartered for MPEG 2.5
+static const uint32_t mp3_sample_rates[3] = { 44100, 48000, 32000 };
+
+/// @brief How far into an MP3 file to look for the first frame after any ID3 tag
+#define CHIME_INDEX_MP3_SCAN 4096
+
+/// @brief Creates a chime index
+/// @param Storage Reference to a storage object
+/// @param Directory Directory holding the chime sounds
+/// @param Index_file Path to the index file
+ChimeIndex::ChimeIndex(Storage* Storage, String Directory, String Index_file) {
+	storage = Storage;
+	directory = Directory;
+	index_file = Index_file;
+	index_mutex = xSemaphoreCreateMutex();
+}
+
+/// @brief Loads the index file, rebuilding it from the chime directory if it's missing or out of date
+/// @return True on success
+bool ChimeIndex::load() {
+	if (storage->fileExists(index_file)) {
+		File file = storage->openFile(index_file);
+		index_header header;
+		bool success = file && file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) && header.magic == CHIME_INDEX_MAGIC && header.version == CHIME_INDEX_VERSION;
+		if (success) {
+			xSemaphoreTake(index_mutex, portMAX_DELAY);
+			chimes.resize(header.count);
+			names.resize(header.names_size);
+			success = file.read((uint8_t*)chimes.data(), header.count * sizeof(chime_info)) == header.count * sizeof(chime_info)
+				&& file.read((uint8_t*)names.data(), header.names_size) == header.names_size && (names.empty() || names.back() == '\0');
+			for (int i = 0; success && i < chimes.size(); i++) {
+				success = chimes[i].name_offset < names.size();
+			}
+			if (!success) {
+				chimes.clear();
+				names.clear();
+			}
+			xSemaphoreGive(index_mutex);
+		}
+		file.close();
+		if (success) {
+			Serial.println("Loaded chime index with " + String(chimes.size()) + " chimes");
+			return true;
+		}
+		Serial.println("Chime index is corrupt");
+	}
+	return rebuild();
+}
+
+/// @brief Rebuilds the index by probing every file in the chime directory
+/// @return True on success
+bool ChimeIndex::rebuild() {
+	Serial.println("Building chime index....");
+	std::vector<String> files = storage->listDir(directory, 0);
+	xSemaphoreTake(index_mutex, portMAX_DELAY);
+	chimes.clear();
+	names.clear();
+	xSemaphoreGive(index_mutex);
+	for (const String& path : files) {
+		chime_info info;
+		if (probe(path, info)) {
+			xSemaphoreTake(index_mutex, portMAX_DELAY);
+			insert(path, info);
+			xSemaphoreGive(index_mutex);
+		}
+	}
+	xSemaphoreTake(index_mutex, portMAX_DELAY);
+	bool success = save();
+	xSemaphoreGive(index_mutex);
+	return success;
+}
+
+/// @brief Adds a chime to the index, or updates it if it's already there
+/// @param path The full path of the chime
+/// @return True on success
+bool ChimeIndex::add(const String& path) {
+	chime_info info;
+	if (!probe(path, info)) {
+		return false;
+	}
+	xSemaphoreTake(index_mutex, portMAX_DELAY);
+	bool found;
+	int index = search(path.c_str(), found);
+	if (found) {
+		info.name_offset = chimes[index].name_offset;
+		chimes[index] = info;
+	} else {
+		insert(path, info);
+	}
+	bool success = save();
+	xSemaphoreGive(index_mutex);
+	return success;
+}
+
+/// @brief Removes a chime from the index
+/// @param path The full path of the chime
+/// @return True on success, or if the chime wasn't in the index
+bool ChimeIndex::remove(const String& path) {
+	xSemaphoreTake(index_mutex, portMAX_DELAY);
+	bool found;
+	int index = search(path.c_str(), found);
+	bool success = true;
+	if (found) {
+		erase(index);
+		success = save();
+	}
+	xSemaphoreGive(index_mutex);
+	return success;
+}
+
+/// @brief Checks if a chime is in the index
+/// @param path The full path of the chime
+/// @return True if the chime is in the index
+bool ChimeIndex::contains(const String& path) {
+	xSemaphoreTake(index_mutex, portMAX_DELAY);
+	bool found;
+	search(path.c_str(), found);
+	xSemaphoreGive(index_mutex);
+	return found;
+}
+
+/// @brief Gets the number of chimes in the index
+/// @return The number of chimes
+size_t ChimeIndex::count() {
+	xSemaphoreTake(index_mutex, portMAX_DELAY);
+	size_t chime_count = chimes.size();
+	xSemaphoreGive(index_mutex);
+	return chime_count;
+}
+
+/// @brief Gets one part of the index as JSON, so large indexes can be sent without building the whole list in memory.
+/// The JSON is {"files":[paths...],"chimes":[details...]}, with the details in the same order as the paths.
+/// @param part The part to get, starting at 0
+/// @return The JSON text of the part, or an empty string after the last part
+String ChimeIndex::getListPart(size_t part) {
+	xSemaphoreTake(index_mutex, portMAX_DELAY);
+	size_t chime_count = chimes.size();
+	String json;
+	if (part == 0) {
+		json = "{\"files\":[";
+	} else if (part <= chime_count) {
+		json = (part > 1 ? "," : "") + Storage::quoteJson(&names[chimes[part - 1].name_offset]);
+	} else if (part == chime_count + 1) {
+		json = "],\"chimes\":[";
+	} else if (part <= chime_count * 2 + 1) {
+		const chime_info& info = chimes[part - chime_count - 2];
+		json = (part > chime_count + 2 ? ",{\"size\":" : "{\"size\":") + String(info.size) + ",\"duration\":" + String(info.duration) + ",\"codec\":\"" + codecName(info.codec)
+			+ "\",\"sampleRate\":" + String(info.sample_rate) + ",\"channels\":" + String(info.channels) + '}';
+	} else if (part == chime_count * 2 + 2) {
+		json = "]}";
+	}
+	xSemaphoreGive(index_mutex);
+	return json;
+}
+
+/// @brief Gets the name of a codec
+/// @param codec The codec, one of codecs
+/// @return The name of the codec
+const char* ChimeIndex::codecName(uint8_t codec) {
+	switch (codec) {
+		case CODEC_MP3:
+			return "mp3";
+		case CODEC_WAV:
+			return "wav";
+		case CODEC_PCM:
+			return "pcm";
+		case CODEC_ADPCM:
+			return "adpcm";
+		default:
+			return "unknown";
+	}
+}
+
+/// @brief Writes the index file. Must hold the index mutex.
+/// @return True on success
+bool ChimeIndex::save() {
+	File file = storage->openFile(index_file, FILE_WRITE);
+	if (!file) {
+		return false;
+	}
+	index_header header { CHIME_INDEX_MAGIC, CHIME_INDEX_VERSION, (uint32_t)chimes.size(), (uint32_t)names.size() };
+	bool success = file.write((uint8_t*)&header, sizeof(header)) == sizeof(header)
+		&& file.write((uint8_t*)chimes.data(), chimes.size() * sizeof(chime_info)) == chimes.size() * sizeof(chime_info)
+		&& file.write((uint8_t*)names.data(), names.size()) == names.size();
+	file.close();
+	if (!success) {
+		Serial.println("Could not save chime index");
+	}
+	return success;
+}
+
+/// @brief Reads the size and format of a chime
+/// @param path The full path of the chime
+/// @param info Receives the details of the chime
+/// @return True if the file could be read
+bool ChimeIndex::probe(const String& path, chime_info& info) {
+	memset(&info, 0, sizeof(info));
+	File file = storage->openFile(path);
+	if (!file) {
+		return false;
+	}
+	info.size = file.size();
+	String extension = path.substring(path.lastIndexOf('.'));
+	extension.toLowerCase();
+	if (extension == CHIME_EXTENSION) {
+		ChimeConverter::chime_header header;
+		if (file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) && header.magic == CHIME_MAGIC && header.sample_rate != 0) {
+			info.codec = header.format == ChimeConverter::CHIME_ADPCM ? CODEC_ADPCM : CODEC_PCM;
+			info.sample_rate = header.sample_rate;
+			info.channels = header.channels;
+			info.duration = (uint64_t)header.frame_count * 1000 / header.sample_rate;
+		}
+	} else if (extension == ".wav") {
+		probeWav(file, info);
+	} else if (extension == ".mp3") {
+		probeMp3(file, info);
+	}
+	file.close();
+	return true;
+}
+
+/// @brief Reads the format of a WAV file
+/// @param file The open file
+/// @param info Receives the details of the file
+/// @return True if the format was found
+bool ChimeIndex::probeWav(File& file, chime_info& info) {
+	uint8_t header[16];
+	if (file.read(header, 12) != 12 || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+		return false;
+	}
+	uint32_t byte_rate = 0;
+	while (file.read(header, 8) == 8) {
+		uint32_t size = header[4] | (header[5] << 8) | (header[6] << 16) | ((uint32_t)header[7] << 24);
+		size_t next = file.position() + size + (size & 1);
+		if (memcmp(header, "fmt ", 4) == 0 && size >= 16) {
+			if (file.read(header, 16) != 16) {
+				return false;
+			}
+			info.channels = header[2];
+			info.sample_rate = header[4] | (header[5] << 8) | (header[6] << 16) | ((uint32_t)header[7] << 24);
+			byte_rate = header[8] | (header[9] << 8) | (header[10] << 16) | ((uint32_t)header[11] << 24);
+		} else if (memcmp(header, "data", 4) == 0) {
+			info.codec = CODEC_WAV;
+			if (byte_rate != 0)
+				info.duration = (uint64_t)size * 1000 / byte_rate;
+			return true;
+		}
+		if (!file.seek(next)) {
+			return false;
+		}
+	}
+	return false;
+}
+
+/// @brief Reads the format of an MP3 file from its first frame, estimating the duration from the bitrate
+/// @param file The open file
+/// @param info Receives the details of the file
+/// @return True if a frame was found
+bool ChimeIndex::probeMp3(File& file, chime_info& info) {
+	uint8_t header[10];
+	size_t start = 0;
+	if (file.read(header, 10) == 10 && memcmp(header, "ID3", 3) == 0) {
+		// Skip the ID3v2 tag, its size is stored 7 bits per byte
+		start = 10 + (((uint32_t)header[6] << 21) | ((uint32_t)header[7] << 14) | (header[8] << 7) | header[9]);
+		if (header[5] & 0x10)
+			start += 10;
+	}
+	if (!file.seek(start)) {
+		return false;
+	}
+	uint8_t frame[4] = { 0, 0, 0, 0 };
+	for (size_t offset = start; offset < start + CHIME_INDEX_MP3_SCAN; offset++) {
+		int next = file.read();
+		if (next < 0) {
+			return false;
+		}
+		frame[0] = frame[1];
+		frame[1] = frame[2];
+		frame[2] = frame[3];
+		frame[3] = next;
+		// Look for a layer III frame header with a valid version, bitrate, and sample rate
+		uint8_t version = (frame[1] >> 3) & 3;
+		uint8_t bitrate = frame[2] >> 4;
+		uint8_t rate = (frame[2] >> 2) & 3;
+		if (frame[0] != 0xFF || (frame[1] & 0xE0) != 0xE0 || ((frame[1] >> 1) & 3) != 1 || version == 1 || bitrate == 0 || bitrate == 15 || rate == 3) {
+			continue;
+		}
+		uint32_t kbps = version == 3 ? mp3_bitrates_v1[bitrate] : mp3_bitrates_v2[bitrate];
+		info.codec = CODEC_MP3;
+		info.sample_rate = mp3_sample_rates[rate] >> (version == 3 ? 0 : (version == 2 ? 1 : 2));
+		info.channels = (frame[3] >> 6) == 3 ? 1 : 2;
+		info.duration = (uint64_t)(info.size - (offset - 3)) * 8 / kbps;
+		return true;
+	}
+	return false;
+}
+
+/// @brief Finds where a chime is, or would be, in the sorted index. Must hold the index mutex.
+/// @param path The full path of the chime
+/// @param found Set to true if the chime is in the index
+/// @return The position of the chime
+int ChimeIndex::search(const char* path, bool& found) {
+	int low = 0;
+	int high = chimes.size();
+	while (low < high) {
+		int middle = (low + high) / 2;
+		int order = strcmp(&names[chimes[middle].name_offset], path);
+		if (order == 0) {
+			found = true;
+			return middle;
+		}
+		if (order < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	found = false;
+	return low;
+}
+
+/// @brief Adds a new chime to the index. Must hold the index mutex.
+/// @param path The full path of the chime
+/// @param info The details of the chime, its name_offset is set
+void ChimeIndex::insert(const String& path, chime_info& info) {
+	bool found;
+	int index = search(path.c_str(), found);
+	info.name_offset = names.size();
+	names.insert(names.end(), path.c_str(), path.c_str() + path.length() + 1);
+	chimes.insert(chimes.begin() + index, info);
+}
+
+/// @brief Removes a chime and its path from the index. Must hold the index mutex.
+/// @param index The position of the chime
+void ChimeIndex::erase(size_t index) {
+	uint32_t offset = chimes[index].name_offset;
+	uint32_t length = strlen(&names[offset]) + 1;
+	names.erase(names.begin() + offset, names.begin() + offset + length);
+	chimes.erase(chimes.begin() + index);
+	for (chime_info& info : chimes) {
+		if (info.name_offset > offset)
+			info.name_offset -= length;
+	}
+}
@@ -0,0 +1,101 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+#include <Storage.h>
+#include <vector>
+#include "ChimeConverter.h"
+
+/// @brief Marks a chime index file ("CIDX")
+#define CHIME_INDEX_MAGIC 0x58444943
+
+/// @brief Version of the chime index layout, increment when the layout changes
+#define CHIME_INDEX_VERSION 1
+
+/// @brief Keeps the size, duration, and format of every chime sound in a compact file, so the chimes don't have to be listed or probed at runtime
+class ChimeIndex {
+	public:
+		/// @brief Encodings of chime sounds
+		enum codecs { CODEC_UNKNOWN, CODEC_MP3, CODEC_WAV, CODEC_PCM, CODEC_ADPCM };
+
+		/// @brief Details of a chime sound
+		struct chime_info {
+			/// @brief Size of the file in bytes
+			uint32_t size;
+
+			/// @brief Length of the sound in milliseconds, estimated for MP3 files
+			uint32_t duration;
+
+			/// @brief Sample rate in Hz, 0 if unknown
+			uint32_t sample_rate;
+
+			/// @brief The encoding of the sound, one of codecs
+			uint8_t codec;
+
+			/// @brief Number of channels, 0 if unknown
+			uint8_t channels;
+
+			/// @brief Unused, keeps the records aligned
+			uint16_t reserved;
+
+			/// @brief Offset of the null-terminated path in the names
+			uint32_t name_offset;
+		};
+
+		ChimeIndex(Storage* Storage, String Directory, String Index_file);
+		bool load();
+		bool rebuild();
+		bool add(const String& path);
+		bool remove(const String& path);
+		bool contains(const String& path);
+		size_t count();
+		String getListPart(size_t part);
+		static const char* codecName(uint8_t codec);
+
+	private:
+		/// @brief Header at the start of the chime index file
+		struct index_header {
+			/// @brief Always CHIME_INDEX_MAGIC
+			uint32_t magic;
+
+			/// @brief Always CHIME_INDEX_VERSION
+			uint32_t version;
+
+			/// @brief Number of chime_info records that follow the header
+			uint32_t count;
+
+			/// @brief Size in bytes of the names that follow the records
+			uint32_t names_size;
+		};
+
+		/// @brief Reference to the storage object
+		Storage* storage;
+
+		/// @brief Directory holding the chime sounds
+		String directory;
+
+		/// @brief Path to the index file
+		String index_file;
+
+		/// @brief Details of each chime, sorted by path
+		std::vector<chime_info> chimes;
+
+		/// @brief Null-terminated paths of the chimes, one after another
+		std::vector<char> names;
+
+		/// @brief Protects the index, it's used by the webserver and the main loop
+		SemaphoreHandle_t index_mutex;
+
+		bool save();
+		bool probe(const String& path, chime_info& info);
+		bool probeWav(File& file, chime_info& info);
+		bool probeMp3(File& file, chime_info& info);
+		int search(const char* path, bool& found);
+		void insert(const String& path, chime_info& info);
+		void erase(size_t index);
+};
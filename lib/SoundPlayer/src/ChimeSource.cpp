@@ -0,0 +1,72 @@
+#include "ChimeSource.h"
+
+/// @brief Creates a source reading a device-native chime
+/// @param File The open chime file, closed when the source is deleted
+ChimeSource::ChimeSource(File File) {
+	file = File;
+}
+
+ChimeSource::~ChimeSource() {
+	file.close();
+}
+
+/// @brief Reads and checks the header of the chime
+/// @return True if the file is a valid chime
+bool ChimeSource::begin() {
+	if (!file) {
+		return false;
+	}
+	if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) || header.magic != CHIME_MAGIC || header.version != CHIME_VERSION 
+		|| header.channels < 1 || header.channels > 2 || header.block_frames != CHIME_BLOCK_FRAMES || header.format > ChimeConverter::CHIME_ADPCM) {
+		Serial.println("Not a valid chime file");
+		return false;
+	}
+	frames_left = header.frame_count;
+	return true;
+}
+
+/// @brief Gets the sample rate of the chime
+/// @return The sample rate in Hz
+uint32_t ChimeSource::getSampleRate() {
+	return header.sample_rate;
+}
+
+/// @brief Gets the number of channels of the chime
+/// @return 1 or 2
+uint16_t ChimeSource::getChannels() {
+	return header.channels;
+}
+
+/// @brief Gets the normalization gain of the chime
+/// @return The gain in 8.8 fixed point
+uint16_t ChimeSource::getGain() {
+	return header.gain;
+}
+
+/// @brief Reads the next block of the chime
+/// @param frames Receives up to SOUND_SOURCE_FRAMES frames, interleaved by channel
+/// @return The number of frames read, 0 once the chime has ended or can't be read
+size_t ChimeSource::read(int16_t* frames) {
+	size_t count = frames_left < CHIME_BLOCK_FRAMES ? frames_left : CHIME_BLOCK_FRAMES;
+	if (count == 0) {
+		return 0;
+	}
+	if (header.format == ChimeConverter::CHIME_ADPCM) {
+		size_t size = ChimeConverter::blockBytes(header);
+		if (file.read(block, size) != size) {
+			Serial.println("Chime file is truncated");
+			frames_left = 0;
+			return 0;
+		}
+		ChimeConverter::decodeBlock(block, header.channels, frames);
+	} else {
+		size_t size = count * header.channels * sizeof(int16_t);
+		if (file.read((uint8_t*)frames, size) != size) {
+			Serial.println("Chime file is truncated");
+			frames_left = 0;
+			return 0;
+		}
+	}
+	frames_left -= count;
+	return count;
+}
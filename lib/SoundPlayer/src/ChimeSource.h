@@ -0,0 +1,35 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <FS.h>
+#include "SoundSource.h"
+
+/// @brief Reads a device-native chime file for the mixer
+class ChimeSource : public SoundSource {
+	public:
+		ChimeSource(File File);
+		~ChimeSource();
+		bool begin();
+		uint32_t getSampleRate();
+		uint16_t getChannels();
+		uint16_t getGain();
+		size_t read(int16_t* frames);
+
+	private:
+		/// @brief The open chime file
+		File file;
+
+		/// @brief Header of the chime
+		ChimeConverter::chime_header header;
+
+		/// @brief Frames of the chime that haven't been read yet
+		uint32_t frames_left = 0;
+
+		/// @brief Holds an ADPCM block being decoded
+		uint8_t block[CHIME_ADPCM_BLOCK_BYTES * 2];
+};
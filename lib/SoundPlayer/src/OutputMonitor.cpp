@@ -0,0 +1,101 @@
+#include "OutputMonitor.h"
+
+/// @brief Clears the counters for a new playback
+/// @param Capacity_frames Number of frames the DMA buffers hold
+void OutputMonitor::start(uint32_t Capacity_frames) {
+	capacity = Capacity_frames;
+	written = 0;
+	primed = false;
+	dry = false;
+	current = stats { 0, 0, UINT32_MAX, 0, 0, current.sample_rate, false };
+}
+
+/// @brief Sets the sample rate frames are played at
+/// @param Sample_rate The sample rate in Hz
+void OutputMonitor::setSampleRate(uint32_t Sample_rate) {
+	if (Sample_rate == 0 || Sample_rate == current.sample_rate) {
+		return;
+	}
+	current.sample_rate = Sample_rate;
+	// Start counting again at the new rate
+	written = 0;
+}
+
+/// @brief Records frames about to be written to I2S. Not called for every frame, so keep calls to blocks of frames.
+/// @param count The number of frames
+void OutputMonitor::addFrames(uint32_t count) {
+	uint32_t now = micros();
+	uint32_t rate = current.sample_rate;
+	if (rate == 0) {
+		return;
+	}
+	if (current.frames > 0 && now - last_write > current.max_gap_us) {
+		current.max_gap_us = now - last_write;
+	}
+	last_write = now;
+	if (written == 0) {
+		start_time = now;
+	} else {
+		// Frames the DMA has played since start_time
+		uint32_t played = (uint64_t)(now - start_time) * rate / 1000000;
+		if (played > written) {
+			// Ran dry, the DMA has been repeating silence
+			if (primed && !dry) {
+				current.underruns++;
+			}
+			dry = true;
+			played = written;
+			start_time = now - (uint64_t)written * 1000000 / rate;
+		} else {
+			dry = false;
+		}
+		uint32_t fill = written - played;
+		if (fill > capacity) {
+			// The write waited for room, so the buffers are full from here
+			fill = capacity;
+			start_time = now - (uint64_t)(written - capacity) * 1000000 / rate;
+		}
+		// Nearly full counts, writes only wait for room once the buffers are
+		if (fill >= capacity - capacity / 8) {
+			primed = true;
+		}
+		if (primed) {
+			uint32_t fill_us = (uint64_t)fill * 1000000 / rate;
+			if (fill_us < current.min_fill_us) {
+				current.min_fill_us = fill_us;
+			}
+		}
+	}
+	written += count;
+	current.frames += count;
+	current.capacity_us = (uint64_t)capacity * 1000000 / rate;
+}
+
+/// @brief Gets the counters of the current or last playback
+/// @return The counters
+OutputMonitor::stats OutputMonitor::getStats() {
+	stats result = current;
+	result.filled = primed;
+	if (!primed) {
+		result.min_fill_us = 0;
+	}
+	return result;
+}
+
+/// @brief Gets how long the DMA still needs to play the frames written so far
+/// @return The time in microseconds until the DMA buffers run dry
+uint32_t OutputMonitor::getBufferedUs() {
+	uint32_t rate = current.sample_rate;
+	if (rate == 0 || written == 0) {
+		return 0;
+	}
+	uint64_t played = (uint64_t)(micros() - start_time) * rate / 1000000;
+	if (played >= written) {
+		return 0;
+	}
+	uint32_t fill = written - played;
+	if (fill > capacity) {
+		fill = capacity;
+	}
+	return (uint64_t)fill * 1000000 / rate;
+}
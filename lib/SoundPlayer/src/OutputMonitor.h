@@ -0,0 +1,64 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <Arduino.h>
+
+/// @brief Estimates how full the I2S DMA buffers are from the frames written and the time passed, and counts underruns
+class OutputMonitor {
+	public:
+		/// @brief Counters of one playback
+		struct stats {
+			/// @brief Frames written to I2S
+			uint32_t frames;
+
+			/// @brief Number of times the DMA buffers ran dry
+			uint32_t underruns;
+
+			/// @brief Least audio left in the DMA buffers once they were first filled, in microseconds
+			uint32_t min_fill_us;
+
+			/// @brief Longest time between writes, in microseconds
+			uint32_t max_gap_us;
+
+			/// @brief Size of the DMA buffers, in microseconds of audio
+			uint32_t capacity_us;
+
+			/// @brief Sample rate of the playback in Hz
+			uint32_t sample_rate;
+
+			/// @brief Set if the DMA buffers were filled, min_fill_us only counts once they were
+			bool filled;
+		};
+
+		void start(uint32_t Capacity_frames);
+		void setSampleRate(uint32_t Sample_rate);
+		void addFrames(uint32_t count);
+		stats getStats();
+		uint32_t getBufferedUs();
+
+	private:
+		/// @brief Number of frames the DMA buffers hold
+		uint32_t capacity = 0;
+
+		/// @brief Time in microseconds the DMA would have started playing for the frames written so far to line up
+		uint32_t start_time = 0;
+
+		/// @brief Frames written since start_time
+		uint32_t written = 0;
+
+		/// @brief Time in microseconds of the last write
+		uint32_t last_write = 0;
+
+		/// @brief Set once the DMA buffers have been filled, the fill level only counts after that
+		bool primed = false;
+
+		/// @brief Set while the DMA buffers are known to be empty, so one underrun is only counted once
+		bool dry = false;
+
+		/// @brief Counters of the current playback
+		stats current;
+};
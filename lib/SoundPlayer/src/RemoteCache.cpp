@@ -0,0 +1,438 @@
+#include "RemoteCache.h"
+
+/// @brief Creates a cache of downloaded sounds
+/// @param Storage Reference to the storage object the sounds are kept on
+/// @param Directory Directory holding the downloaded sounds
+/// @param Index_file Path to the file listing the downloaded sounds
+RemoteCache::RemoteCache(Storage* Storage, String Directory, String Index_file) {
+	storage = Storage;
+	directory = Directory;
+	index_file = Index_file;
+	budget = REMOTE_CACHE_DEFAULT_KB * 1024;
+	cache_mutex = xSemaphoreCreateMutex();
+}
+
+/// @brief Loads the list of downloaded sounds and starts downloading in the background
+/// @return True on success
+bool RemoteCache::begin() {
+	if (!storage->fileExists(directory) && !storage->createDir(directory)) {
+		Serial.println("Could not create remote chime directory");
+		return false;
+	}
+	load();
+	// Low priority on core 0, away from the audio task
+	return xTaskCreatePinnedToCore(RemoteCache::fetchTaskWrapper, "Remote Chime Loop", 6144, this, 1, &fetch_task, 0) == pdPASS;
+}
+
+/// @brief Wraps the fetch task for static access.
+/// @param arg The RemoteCache object.
+void RemoteCache::fetchTaskWrapper(void* arg) {
+	static_cast<RemoteCache*>(arg)->fetchTask();
+}
+
+/// @brief Checks if a sound is downloaded from a URL
+/// @param sound The full path or URL of the sound
+/// @return True for HTTP and HTTPS URLs
+bool RemoteCache::isRemote(const String& sound) {
+	return sound.startsWith("http://") || sound.startsWith("https://");
+}
+
+/// @brief Sets the maximum number of bytes of downloaded sounds to keep on storage
+/// @param Budget The budget in bytes
+void RemoteCache::setBudget(size_t Budget) {
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	budget = Budget;
+	deferred.clear();
+	xSemaphoreGive(cache_mutex);
+	if (fetch_task != NULL)
+		xTaskNotifyGive(fetch_task);
+}
+
+/// @brief Gets the maximum number of bytes of downloaded sounds to keep on storage
+/// @return The budget in bytes
+size_t RemoteCache::getBudget() {
+	return budget;
+}
+
+/// @brief Sets the URLs of the sounds to download, those not on storage yet are downloaded shortly after
+/// @param Urls The URLs, anything else is ignored
+void RemoteCache::setUrls(const std::vector<String>& Urls) {
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	urls.clear();
+	for (const String& url : Urls) {
+		if (isRemote(url))
+			urls.push_back(url);
+	}
+	deferred.clear();
+	xSemaphoreGive(cache_mutex);
+	if (fetch_task != NULL)
+		xTaskNotifyGive(fetch_task);
+}
+
+/// @brief Gets where a downloaded sound is kept on storage. Never waits on the network.
+/// @param url The URL of the sound
+/// @param touch True to mark the sound as recently used, e.g. when it's played
+/// @return The full path of the sound, or an empty string if it hasn't been downloaded
+String RemoteCache::getLocalPath(const String& url, bool touch) {
+	String path;
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	int index = find(url);
+	if (index >= 0) {
+		if (touch) {
+			entries[index].last_used = ++use_clock;
+			dirty = true;
+		}
+		path = entries[index].path;
+	}
+	xSemaphoreGive(cache_mutex);
+	return path;
+}
+
+/// @brief Holds off downloads and writes to storage while sounds play, and keeps the files being played from being evicted or replaced
+/// @param paths The full paths of the sounds about to play, added to any already playing
+void RemoteCache::startPlaying(const std::vector<String>& paths) {
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	playing.insert(playing.end(), paths.begin(), paths.end());
+	paused = true;
+	xSemaphoreGive(cache_mutex);
+}
+
+/// @brief Continues downloading once every sound has finished playing
+void RemoteCache::stopPlaying() {
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	playing.clear();
+	paused = false;
+	xSemaphoreGive(cache_mutex);
+}
+
+/// @brief Checks if a sound was downloaded or removed since the last call
+/// @return True if the downloaded sounds changed
+bool RemoteCache::takeChanges() {
+	if (!changed)
+		return false;
+	changed = false;
+	return true;
+}
+
+/// @brief Downloads sounds that aren't on storage and checks downloaded sounds for changes as an infinite loop
+void RemoteCache::fetchTask() {
+	while (true) {
+		// Woken early when the URLs or the budget change
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(REMOTE_CACHE_CHECK_MS));
+		std::vector<String> due;
+		xSemaphoreTake(cache_mutex, portMAX_DELAY);
+		for (const String& url : urls) {
+			int index = find(url);
+			if (index < 0) {
+				if (std::find(deferred.begin(), deferred.end(), url) == deferred.end())
+					due.push_back(url);
+			} else if (entries[index].checked == 0 || millis() - entries[index].checked >= REMOTE_CACHE_REFRESH_MS) {
+				due.push_back(url);
+			}
+		}
+		xSemaphoreGive(cache_mutex);
+		for (const String& url : due) {
+			waitWhilePaused();
+			fetch(url);
+		}
+		waitWhilePaused();
+		// Sounds no longer in the list stay until their space is needed
+		evict("");
+		if (dirty)
+			save();
+	}
+}
+
+/// @brief Downloads a sound, or checks it for changes if it's already on storage
+/// @param url The URL of the sound
+/// @return True if the sound on storage is up to date
+bool RemoteCache::fetch(const String& url) {
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	int index = find(url);
+	String path = index >= 0 ? entries[index].path : localPath(url);
+	String etag = index >= 0 ? entries[index].etag : "";
+	String modified = index >= 0 ? entries[index].modified : "";
+	size_t limit = budget;
+	if (index >= 0)
+		entries[index].checked = millis();
+	xSemaphoreGive(cache_mutex);
+
+	HTTPClient client;
+	const char* headers[] = { "ETag", "Last-Modified" };
+	client.setTimeout(REMOTE_CACHE_TIMEOUT_MS);
+	client.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+	if (!client.begin(url)) {
+		Serial.println("Bad remote chime URL: " + url);
+		return false;
+	}
+	// The body is copied by hand so the download can pause, which chunked transfer encoding would get in the way of
+	client.useHTTP10(true);
+	client.collectHeaders(headers, 2);
+	// Only download the sound again if it changed
+	if (!etag.isEmpty())
+		client.addHeader("If-None-Match", etag);
+	if (!modified.isEmpty())
+		client.addHeader("If-Modified-Since", modified);
+	int response_code = client.GET();
+	int written = -1;
+	if (response_code == HTTP_CODE_NOT_MODIFIED && index >= 0) {
+		Serial.println("Remote chime is up to date: " + url);
+		client.end();
+		return true;
+	} else if (response_code == HTTP_CODE_OK) {
+		int length = client.getSize();
+		if (length > (int)limit) {
+			Serial.println("Remote chime is larger than the cache: " + url);
+		} else {
+			// Download next to the old copy, which is kept if anything goes wrong
+			String temp_path = path + ".part";
+			File file = storage->openFile(temp_path, FILE_WRITE);
+			if (file) {
+				written = download(client, file, limit);
+				file.close();
+			}
+			if (written <= 0 || (length > 0 && written != length) || written > (int)limit) {
+				Serial.println("Could not download remote chime: " + url);
+				storage->deleteFile(temp_path);
+				written = -1;
+			} else {
+				// The audio task may have the old copy open, so it's only replaced once it isn't playing
+				xSemaphoreTake(cache_mutex, portMAX_DELAY);
+				while (isPlaying(path)) {
+					xSemaphoreGive(cache_mutex);
+					delay(100);
+					xSemaphoreTake(cache_mutex, portMAX_DELAY);
+				}
+				if (storage->fileExists(path))
+					storage->deleteFile(path);
+				if (!storage->renameFile(temp_path, path)) {
+					Serial.println("Could not save remote chime: " + url);
+					storage->deleteFile(temp_path);
+					written = -1;
+				}
+				xSemaphoreGive(cache_mutex);
+			}
+		}
+	} else if (response_code > 0) {
+		Serial.printf("Unexpected response code %d for remote chime %s\n", response_code, url.c_str());
+	} else {
+		Serial.printf("Remote chime request failed, error: %s\n", client.errorToString(response_code).c_str());
+	}
+	String new_etag = client.header("ETag");
+	String new_modified = client.header("Last-Modified");
+	client.end();
+	if (written < 0) {
+		return false;
+	}
+
+	Serial.println("Downloaded remote chime " + url + " to " + path);
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	// Entries may have changed while downloading
+	index = find(url);
+	if (index < 0) {
+		entries.push_back(entry { url, path, 0, "", "", ++use_clock, 0 });
+		index = entries.size() - 1;
+	}
+	used = used - entries[index].size + written;
+	entries[index].size = written;
+	entries[index].etag = new_etag;
+	entries[index].modified = new_modified;
+	entries[index].checked = millis();
+	dirty = true;
+	changed = true;
+	xSemaphoreGive(cache_mutex);
+	evict(url);
+	return true;
+}
+
+/// @brief Copies the body of a response to a file a chunk at a time, waiting between chunks while a sound plays
+/// @param client The client the response was received on
+/// @param file The file to write to
+/// @param limit The most bytes to accept
+/// @return The number of bytes written, or -1 on failure
+int RemoteCache::download(HTTPClient& client, File& file, size_t limit) {
+	WiFiClient* stream = client.getStreamPtr();
+	int length = client.getSize();
+	uint8_t buffer[REMOTE_CACHE_CHUNK_SIZE];
+	int written = 0;
+	unsigned long last_data = millis();
+	while (length < 0 || written < length) {
+		if (paused) {
+			// The server is held back by TCP flow control meanwhile, if it gives up the download fails and is tried again later
+			waitWhilePaused();
+			last_data = millis();
+		}
+		size_t available = stream->available();
+		if (available == 0) {
+			if (!stream->connected()) {
+				break;
+			}
+			if (millis() - last_data > REMOTE_CACHE_TIMEOUT_MS) {
+				Serial.println("Remote chime download timed out");
+				return -1;
+			}
+			delay(1);
+			continue;
+		}
+		size_t count = stream->readBytes(buffer, min(available, sizeof(buffer)));
+		if (count == 0 || file.write(buffer, count) != count) {
+			return -1;
+		}
+		written += count;
+		if (written > (int)limit) {
+			return -1;
+		}
+		last_data = millis();
+	}
+	return written;
+}
+
+/// @brief Deletes the least recently used sounds until the budget is met. Sounds being played are never deleted.
+/// @param keep The URL of a sound that must not be deleted, e.g. the one just downloaded
+void RemoteCache::evict(const String& keep) {
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	while (used > budget) {
+		int oldest = -1;
+		for (int i = 0; i < entries.size(); i++) {
+			if (entries[i].url != keep && !isPlaying(entries[i].path) && (oldest < 0 || entries[i].last_used < entries[oldest].last_used)) {
+				oldest = i;
+			}
+		}
+		if (oldest < 0) {
+			break;
+		}
+		if (std::find(urls.begin(), urls.end(), entries[oldest].url) != urls.end()) {
+			// Downloading it again would just evict another, so wait for more room
+			Serial.println("Remote chime cache is too small for every remote chime");
+			deferred.push_back(entries[oldest].url);
+		}
+		Serial.println("Evicting " + entries[oldest].url + " from remote chime cache");
+		storage->deleteFile(entries[oldest].path);
+		used -= entries[oldest].size;
+		entries.erase(entries.begin() + oldest);
+		dirty = true;
+		changed = true;
+	}
+	xSemaphoreGive(cache_mutex);
+}
+
+/// @brief Waits until nothing is playing, so downloads never compete with playback for storage
+void RemoteCache::waitWhilePaused() {
+	while (paused) {
+		delay(100);
+	}
+}
+
+/// @brief Checks if a sound is being played. Must hold the cache mutex.
+/// @param path The full path of the sound
+/// @return True if the sound is being played
+bool RemoteCache::isPlaying(const String& path) {
+	return std::find(playing.begin(), playing.end(), path) != playing.end();
+}
+
+/// @brief Loads the list of downloaded sounds, dropping any that are missing and deleting files that aren't listed
+/// @return True on success
+bool RemoteCache::load() {
+	Storage::file_buffer content = {};
+	bool found = storage->fileExists(index_file) && storage->readFile(index_file, content);
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	entries.clear();
+	used = 0;
+	if (found && content.size > 0) {
+		// Parsed in place, the strings point into the buffer until they're copied into the entries
+		DynamicJsonDocument index(1024 + content.size);
+		DeserializationError error = deserializeJson(index, content.data.get(), content.size);
+		if (error) {
+			Serial.println("Bad remote chime index, starting over");
+		} else {
+			for (JsonObject sound : index["sounds"].as<JsonArray>()) {
+				entry item { sound["url"].as<String>(), sound["path"].as<String>(), sound["size"].as<size_t>(), sound["etag"].as<String>(), sound["modified"].as<String>(), sound["used"].as<uint32_t>(), 0 };
+				size_t size;
+				time_t last_write;
+				if (storage->getFileInfo(item.path, size, last_write) && size == item.size) {
+					entries.push_back(item);
+					used += item.size;
+					use_clock = max(use_clock, item.last_used);
+				} else {
+					Serial.println("Remote chime missing from storage: " + item.url);
+					dirty = true;
+				}
+			}
+		}
+	}
+	// Remove partial downloads and anything else left behind
+	for (const String& path : storage->listDir(directory, 0)) {
+		bool listed = false;
+		for (const entry& item : entries) {
+			listed = listed || item.path == path;
+		}
+		if (!listed)
+			storage->deleteFile(path);
+	}
+	xSemaphoreGive(cache_mutex);
+	Serial.println("Remote chime cache using " + String(used / 1024) + " of " + String(budget / 1024) + " KB");
+	return true;
+}
+
+/// @brief Saves the list of downloaded sounds
+/// @return True on success
+bool RemoteCache::save() {
+	xSemaphoreTake(cache_mutex, portMAX_DELAY);
+	size_t size = JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(entries.size()) + entries.size() * JSON_OBJECT_SIZE(6);
+	DynamicJsonDocument index(size);
+	JsonArray sounds = index.createNestedArray("sounds");
+	for (const entry& item : entries) {
+		JsonObject sound = sounds.createNestedObject();
+		// Stored as pointers, so the strings aren't copied
+		sound["url"] = item.url.c_str();
+		sound["path"] = item.path.c_str();
+		sound["size"] = item.size;
+		sound["etag"] = item.etag.c_str();
+		sound["modified"] = item.modified.c_str();
+		sound["used"] = item.last_used;
+	}
+	String json;
+	serializeJson(index, json);
+	dirty = false;
+	xSemaphoreGive(cache_mutex);
+	if (!storage->writeFile(index_file, json)) {
+		Serial.println("Could not save remote chime index");
+		dirty = true;
+		return false;
+	}
+	return true;
+}
+
+/// @brief Finds a downloaded sound. Must hold the cache mutex.
+/// @param url The URL of the sound
+/// @return The index of the entry, or -1 if the sound hasn't been downloaded
+int RemoteCache::find(const String& url) {
+	for (int i = 0; i < entries.size(); i++) {
+		if (entries[i].url == url) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/// @brief Chooses where a sound is kept on storage, named by a hash of its URL
+/// @param url The URL of the sound
+/// @return The full path of the sound
+String RemoteCache::localPath(const String& url) {
+	// FNV-1a
+	uint32_t hash = 2166136261UL;
+	for (int i = 0; i < url.length(); i++) {
+		hash = (hash ^ (uint8_t)url[i]) * 16777619UL;
+	}
+	// Keep the extension, the player chooses the decoder by it
+	int end = url.indexOf('?');
+	String name = end < 0 ? url : url.substring(0, end);
+	int dot = name.lastIndexOf('.');
+	String extension = dot > name.lastIndexOf('/') ? name.substring(dot) : "";
+	extension.toLowerCase();
+	if (extension.length() < 2 || extension.length() > 6)
+		extension = ".mp3";
+	char hex[9];
+	snprintf(hex, sizeof(hex), "%08x", hash);
+	return directory + "/" + hex + extension;
+}
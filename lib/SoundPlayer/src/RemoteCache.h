@@ -0,0 +1,126 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <ArduinoJson.h>
+#include <Storage.h>
+#include <algorithm>
+#include <vector>
+
+/// @brief Downloads chime sounds from HTTP URLs in the background and keeps them on storage, up to a size budget, evicting the least recently used.
+/// Sounds are only ever played from storage, so ringing the doorbell never waits on the network.
+class RemoteCache {
+	public:
+		RemoteCache(Storage* Storage, String Directory, String Index_file);
+		bool begin();
+		static void fetchTaskWrapper(void* arg);
+		static bool isRemote(const String& sound);
+		void setBudget(size_t Budget);
+		size_t getBudget();
+		void setUrls(const std::vector<String>& urls);
+		String getLocalPath(const String& url, bool touch = true);
+		void startPlaying(const std::vector<String>& paths);
+		void stopPlaying();
+		bool takeChanges();
+
+	private:
+		/// @brief Default storage budget in KB for downloaded sounds
+		#define REMOTE_CACHE_DEFAULT_KB 2048
+
+		/// @brief Time in milliseconds between checks for URLs that need downloading
+		#define REMOTE_CACHE_CHECK_MS 60000
+
+		/// @brief Time in milliseconds before a downloaded sound is checked for changes on the server
+		#define REMOTE_CACHE_REFRESH_MS (6 * 3600 * 1000UL)
+
+		/// @brief Time in milliseconds to wait for the server
+		#define REMOTE_CACHE_TIMEOUT_MS 10000
+
+		/// @brief Bytes copied from the network to storage at a time, downloads only pause between these
+		#define REMOTE_CACHE_CHUNK_SIZE 1024
+
+		/// @brief A downloaded sound
+		struct entry {
+			/// @brief The URL the sound was downloaded from
+			String url;
+
+			/// @brief The full path of the sound on storage
+			String path;
+
+			/// @brief Size of the file in bytes
+			size_t size;
+
+			/// @brief The ETag the server sent with the sound, for conditional requests
+			String etag;
+
+			/// @brief The Last-Modified date the server sent with the sound, for conditional requests
+			String modified;
+
+			/// @brief Value of use_clock when the sound was downloaded or last played, the lowest is evicted first
+			uint32_t last_used;
+
+			/// @brief Time in milliseconds the sound was last checked with the server, 0 if never since boot
+			uint32_t checked;
+		};
+
+		/// @brief Reference to the storage object
+		Storage* storage;
+
+		/// @brief Directory holding the downloaded sounds
+		String directory;
+
+		/// @brief Path to the file listing the downloaded sounds
+		String index_file;
+
+		/// @brief Maximum number of bytes of downloaded sounds
+		size_t budget;
+
+		/// @brief Number of bytes of downloaded sounds
+		size_t used = 0;
+
+		/// @brief Incremented each time a sound is downloaded or played
+		uint32_t use_clock = 0;
+
+		/// @brief The downloaded sounds
+		std::vector<entry> entries;
+
+		/// @brief URLs of the sounds that should be downloaded
+		std::vector<String> urls;
+
+		/// @brief URLs not downloaded again until the list of URLs or the budget changes, because they were evicted to make room for other sounds
+		std::vector<String> deferred;
+
+		/// @brief Set when the entries changed and the index file needs saving
+		bool dirty = false;
+
+		/// @brief Set when a sound was downloaded or removed, until takeChanges() is called
+		volatile bool changed = false;
+
+		/// @brief Set while a sound is playing, nothing is downloaded or written to storage
+		volatile bool paused = false;
+
+		/// @brief Full paths of the sounds being played, these files are never deleted or replaced
+		std::vector<String> playing;
+
+		/// @brief Protects the entries and URLs, they're used by the audio task, the webserver, and the fetch task
+		SemaphoreHandle_t cache_mutex;
+
+		/// @brief The task downloading the sounds
+		TaskHandle_t fetch_task = NULL;
+
+		void fetchTask();
+		bool fetch(const String& url);
+		int download(HTTPClient& client, File& file, size_t limit);
+		void evict(const String& keep);
+		void waitWhilePaused();
+		bool isPlaying(const String& path);
+		bool load();
+		bool save();
+		int find(const String& url);
+		String localPath(const String& url);
+};
@@ -0,0 +1,115 @@
+#include "SequenceSource.h"
+
+/// @brief Creates a sequence of device-native chimes
+/// @param Cache Reference to the cache the chimes are opened from, falling back to storage
+/// @param Files The full paths of the chimes, in order
+SequenceSource::SequenceSource(ChimeCache* Cache, const std::vector<String>& Files) {
+	cache = Cache;
+	files = Files;
+}
+
+SequenceSource::~SequenceSource() {
+	delete current;
+	delete next;
+}
+
+/// @brief Opens the first chime and prebuffers it
+/// @return True if a chime could be opened
+bool SequenceSource::begin() {
+	current = open(true);
+	if (current == NULL) {
+		return false;
+	}
+	// Read the start now, so the next chime is prebuffered right after the first mix
+	buffered = current->read(buffer);
+	buffer_current = true;
+	return true;
+}
+
+/// @brief Gets the sample rate of the sequence
+/// @return The sample rate in Hz
+uint32_t SequenceSource::getSampleRate() {
+	return sample_rate;
+}
+
+/// @brief Gets the number of channels of the sequence
+/// @return 1 or 2
+uint16_t SequenceSource::getChannels() {
+	return channels;
+}
+
+/// @brief Reads the next frames of the sequence, moving on to the next chime as soon as one ends
+/// @param frames Receives up to SOUND_SOURCE_FRAMES frames, interleaved by channel
+/// @return The number of frames read, 0 once the last chime has ended
+size_t SequenceSource::read(int16_t* frames) {
+	while (current != NULL) {
+		size_t count;
+		if (buffer_current) {
+			memcpy(frames, buffer, buffered * channels * sizeof(int16_t));
+			count = buffered;
+			buffer_current = false;
+			buffered = 0;
+		} else {
+			count = current->read(frames);
+		}
+		if (count > 0) {
+			applyGain(frames, count, current->getGain());
+			if (next == NULL && next_file < files.size()) {
+				// Prebuffer the next chime while this one plays
+				next = open(false);
+				buffered = next != NULL ? next->read(buffer) : 0;
+			}
+			return count;
+		}
+		// Hand over to the prebuffered chime, opening one now if it couldn't be prebuffered
+		delete current;
+		current = next;
+		next = NULL;
+		if (current == NULL && next_file < files.size()) {
+			current = open(false);
+			buffered = current != NULL ? current->read(buffer) : 0;
+		}
+		buffer_current = true;
+	}
+	return 0;
+}
+
+/// @brief Opens the next chime that can be played in the sequence
+/// @param first True for the first chime, which sets the format of the sequence
+/// @return The chime, or NULL if there are no more that can be played
+ChimeSource* SequenceSource::open(bool first) {
+	while (next_file < files.size()) {
+		const String& path = files[next_file++];
+		bool cached;
+		ChimeSource* chime = new ChimeSource(cache->openFile(path, cached));
+		if (chime->begin()) {
+			if (first) {
+				sample_rate = chime->getSampleRate();
+				channels = chime->getChannels();
+				return chime;
+			}
+			if (chime->getSampleRate() == sample_rate && chime->getChannels() == channels) {
+				return chime;
+			}
+			Serial.println("Skipping " + path + ", its format doesn't match the rest of the sequence");
+		} else {
+			Serial.println("Skipping " + path + " in sequence");
+		}
+		delete chime;
+	}
+	return NULL;
+}
+
+/// @brief Applies the normalization gain of a chime, so each chime in the sequence plays at its own level
+/// @param frames The frames, interleaved by channel
+/// @param count The number of frames
+/// @param gain The gain in 8.8 fixed point
+void SequenceSource::applyGain(int16_t* frames, size_t count, uint16_t gain) {
+	if (gain == CHIME_UNITY_GAIN) {
+		return;
+	}
+	for (size_t i = 0; i < count * channels; i++) {
+		int32_t sample = (frames[i] * (int32_t)gain) >> 8;
+		frames[i] = sample > 32767 ? 32767 : (sample < -32768 ? -32768 : sample);
+	}
+}
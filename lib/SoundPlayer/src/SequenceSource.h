@@ -0,0 +1,57 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <vector>
+#include "ChimeCache.h"
+#include "ChimeSource.h"
+
+/// @brief Plays device-native chimes one after another without a gap.
+/// The next chime is opened and its first block read while the current one plays, so the handover happens on the next sample.
+class SequenceSource : public SoundSource {
+	public:
+		SequenceSource(ChimeCache* Cache, const std::vector<String>& Files);
+		~SequenceSource();
+		bool begin();
+		uint32_t getSampleRate();
+		uint16_t getChannels();
+		size_t read(int16_t* frames);
+
+	private:
+		/// @brief Reference to the cache the chimes are opened from
+		ChimeCache* cache;
+
+		/// @brief The full paths of the chimes, in order
+		std::vector<String> files;
+
+		/// @brief Index into files of the next chime to open
+		size_t next_file = 0;
+
+		/// @brief The chime being played
+		ChimeSource* current = NULL;
+
+		/// @brief The chime that plays after the current one, NULL until it's been prebuffered
+		ChimeSource* next = NULL;
+
+		/// @brief Sample rate of the first chime, the others must match it
+		uint32_t sample_rate = 0;
+
+		/// @brief Channels of the first chime, the others must match it
+		uint16_t channels = 0;
+
+		/// @brief The first block of the next chime
+		int16_t buffer[SOUND_SOURCE_FRAMES * 2];
+
+		/// @brief Number of frames in buffer
+		size_t buffered = 0;
+
+		/// @brief Set when buffer holds the start of the current chime instead of the next one
+		bool buffer_current = false;
+
+		ChimeSource* open(bool first);
+		void applyGain(int16_t* frames, size_t count, uint16_t gain);
+};
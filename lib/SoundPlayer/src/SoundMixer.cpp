@@ -0,0 +1,205 @@
+#include "SoundMixer.h"
+
+/// @brief Creates a mixer with no voices
+SoundMixer::SoundMixer() {
+	for (voice& v : voices) {
+		v.source = NULL;
+	}
+}
+
+/// @brief Starts mixing a sound
+/// @param source The sound, deleted by the mixer when it ends if it was added
+/// @param gain Gain of the sound in 8.8 fixed point, on top of the sound's own gain
+/// @param duck True to lower the other voices while this sound plays
+/// @return The index of the voice, or -1 if there are no free voices
+int SoundMixer::addVoice(SoundSource* source, uint16_t gain, bool duck) {
+	uint32_t rate = source->getSampleRate();
+	if (rate == 0) {
+		return -1;
+	}
+	if (!isActive()) {
+		sample_rate = rate;
+	}
+	for (int i = 0; i < SOUND_MIXER_VOICES; i++) {
+		voice& v = voices[i];
+		if (v.source == NULL) {
+			v.source = source;
+			v.channels = source->getChannels();
+			v.count = 0;
+			v.previous[0] = 0;
+			v.previous[1] = 0;
+			v.position = 0;
+			v.step = ((uint64_t)rate << 16) / sample_rate;
+			v.gain = min((uint32_t)gain * source->getGain() >> 8, (uint32_t)CHIME_MAX_GAIN);
+			// Fade in from silence, a sound starting at full level over others would click
+			v.current_gain = 0;
+			v.duck = duck;
+			return i;
+		}
+	}
+	return -1;
+}
+
+/// @brief Stops all the voices
+void SoundMixer::stopAll() {
+	for (voice& v : voices) {
+		if (v.source != NULL) {
+			removeVoice(v);
+		}
+	}
+}
+
+/// @brief Checks if any voice is playing
+/// @return True if a voice is playing
+bool SoundMixer::isActive() {
+	for (voice& v : voices) {
+		if (v.source != NULL) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/// @brief Checks if another sound can be added
+/// @return True if a voice is free
+bool SoundMixer::hasFreeVoice() {
+	for (voice& v : voices) {
+		if (v.source == NULL) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/// @brief Gets the sample rate of the mix
+/// @return The sample rate in Hz
+uint32_t SoundMixer::getSampleRate() {
+	return sample_rate;
+}
+
+/// @brief Sets the gain applied to the mix
+/// @param Volume The gain out of 64
+void SoundMixer::setVolume(uint8_t Volume) {
+	volume = Volume < 64 ? Volume : 64;
+}
+
+/// @brief Mixes the next frames of all the voices, voices are removed once their sound ends
+/// @param output Receives SOUND_MIXER_FRAMES stereo frames
+/// @return The number of frames mixed, 0 if no voice is playing
+size_t SoundMixer::mix(int16_t* output) {
+	int active = 0;
+	bool ducking = false;
+	for (voice& v : voices) {
+		if (v.source != NULL) {
+			active++;
+			ducking |= v.duck;
+		}
+	}
+	if (active == 0) {
+		return 0;
+	}
+	peak_voices = max(peak_voices, active);
+	uint32_t start = ESP.getCycleCount();
+	memset(sums, 0, sizeof(sums));
+	for (voice& v : voices) {
+		if (v.source != NULL) {
+			uint32_t target = ducking && !v.duck ? (v.gain * SOUND_MIXER_DUCK_GAIN) >> 8 : v.gain;
+			int mixed = mixVoice(v, target);
+			voice_frames += mixed;
+			if (mixed < SOUND_MIXER_FRAMES) {
+				removeVoice(v);
+			}
+		}
+	}
+	uint32_t mixed = ESP.getCycleCount();
+	voice_cycles += mixed - start;
+	// Sums are at most 4 voices * 32767 * 4x gain in 8.8, so dropping the fraction before the volume can't overflow
+	int32_t gain = volume;
+	for (int i = 0; i < SOUND_MIXER_FRAMES * 2; i += 2) {
+		int32_t left = ((sums[i] >> 8) * gain) >> 6;
+		int32_t right = ((sums[i + 1] >> 8) * gain) >> 6;
+		output[i] = left > 32767 ? 32767 : (left < -32768 ? -32768 : left);
+		output[i + 1] = right > 32767 ? 32767 : (right < -32768 ? -32768 : right);
+	}
+	output_cycles += ESP.getCycleCount() - mixed;
+	output_frames += SOUND_MIXER_FRAMES;
+	return SOUND_MIXER_FRAMES;
+}
+
+/// @brief Prints the CPU cost of mixing since the last call, then resets the counts
+void SoundMixer::printStats() {
+	if (output_frames == 0) {
+		return;
+	}
+	uint32_t per_voice = voice_frames > 0 ? voice_cycles / voice_frames : 0;
+	uint32_t per_frame = output_cycles / output_frames;
+	// Share of one core used by each voice at the output sample rate, in hundredths of a percent
+	uint32_t load = (uint64_t)per_voice * sample_rate * 10000 / ((uint64_t)ESP.getCpuFreqMHz() * 1000000);
+	Serial.println("Mixer: " + String(per_voice) + " cycles per voice per frame (" + String(load / 100) + "." + (load % 100 < 10 ? "0" : "") + String(load % 100) + "% of a core at " 
+		+ String(sample_rate) + " Hz), " + String(per_frame) + " cycles per frame to output, up to " + String(peak_voices) + " voices");
+	voice_cycles = 0;
+	voice_frames = 0;
+	output_cycles = 0;
+	output_frames = 0;
+	peak_voices = 0;
+}
+
+/// @brief Adds the next frames of a voice to the sums, resampled with linear interpolation and ramped towards a gain
+/// @param v The voice
+/// @param target_gain The gain to ramp to over the frames, in 8.8 fixed point
+/// @return The number of frames mixed, less than SOUND_MIXER_FRAMES once the sound has ended
+int SoundMixer::mixVoice(voice& v, int32_t target_gain) {
+	int32_t gain = v.current_gain;
+	int32_t gain_step = ((target_gain << 8) - gain) / SOUND_MIXER_FRAMES;
+	int32_t* sum = sums;
+	int f;
+	for (f = 0; f < SOUND_MIXER_FRAMES; f++) {
+		int32_t index = v.position >> 16;
+		if (index + 1 >= v.count) {
+			if (!refill(v)) {
+				break;
+			}
+			index = v.position >> 16;
+		}
+		// Frame index - 1 is the last frame of the previous read
+		const int16_t* a = index < 0 ? v.previous : v.frames + index * v.channels;
+		const int16_t* b = v.frames + (index + 1) * v.channels;
+		// 15-bit fraction, so the difference times the fraction fits in 32 bits
+		int32_t fraction = (v.position & 0xFFFF) >> 1;
+		int32_t left = a[0] + (((b[0] - a[0]) * fraction) >> 15);
+		int32_t right = v.channels == 2 ? a[1] + (((b[1] - a[1]) * fraction) >> 15) : left;
+		int32_t g = gain >> 8;
+		sum[0] += left * g;
+		sum[1] += right * g;
+		sum += 2;
+		gain += gain_step;
+		v.position += v.step;
+	}
+	v.current_gain = gain;
+	return f;
+}
+
+/// @brief Reads more frames into a voice, keeping the last frame to interpolate from
+/// @param v The voice
+/// @return True if there are enough frames to interpolate the current position, false once the sound has ended
+bool SoundMixer::refill(voice& v) {
+	while ((v.position >> 16) + 1 >= v.count) {
+		if (v.count > 0) {
+			v.previous[0] = v.frames[(v.count - 1) * v.channels];
+			v.previous[1] = v.frames[(v.count - 1) * v.channels + v.channels - 1];
+			v.position -= v.count << 16;
+		}
+		v.count = v.source->read(v.frames);
+		if (v.count == 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/// @brief Frees a voice and deletes its sound
+/// @param v The voice
+void SoundMixer::removeVoice(voice& v) {
+	delete v.source;
+	v.source = NULL;
+}
@@ -0,0 +1,98 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <Arduino.h>
+#include "SoundSource.h"
+
+/// @brief Largest number of sounds that can play at once
+#define SOUND_MIXER_VOICES 4
+
+/// @brief Number of stereo frames produced by each mix
+#define SOUND_MIXER_FRAMES 256
+
+/// @brief Gain in 8.8 fixed point of the other voices while a ducking voice plays, -12 dB
+#define SOUND_MIXER_DUCK_GAIN 64
+
+/// @brief Mixes several sounds into one stereo stream in fixed point.
+/// The output runs at the sample rate of the first sound, later sounds are resampled to it.
+class SoundMixer {
+	public:
+		SoundMixer();
+		int addVoice(SoundSource* source, uint16_t gain, bool duck);
+		void stopAll();
+		bool isActive();
+		bool hasFreeVoice();
+		uint32_t getSampleRate();
+		void setVolume(uint8_t Volume);
+		size_t mix(int16_t* output);
+		void printStats();
+
+	private:
+		/// @brief A sound being mixed
+		struct voice {
+			/// @brief The sound, NULL if the voice is free
+			SoundSource* source;
+
+			/// @brief Number of channels of the sound
+			uint16_t channels;
+
+			/// @brief Frames read from the sound, interleaved by channel
+			int16_t frames[SOUND_SOURCE_FRAMES * 2];
+
+			/// @brief Number of frames in frames
+			int32_t count;
+
+			/// @brief The last frame of the previous read, interpolated from at position -1
+			int16_t previous[2];
+
+			/// @brief Position in frames in 16.16 fixed point
+			int32_t position;
+
+			/// @brief Source frames per output frame in 16.16 fixed point
+			uint32_t step;
+
+			/// @brief Gain of the voice in 8.8 fixed point
+			uint32_t gain;
+
+			/// @brief Gain the voice is at, in 8.8 fixed point shifted up 8 bits so it can ramp smoothly
+			int32_t current_gain;
+
+			/// @brief Whether the other voices are ducked while this one plays
+			bool duck;
+		};
+
+		/// @brief The voices
+		voice voices[SOUND_MIXER_VOICES];
+
+		/// @brief Sums of the voices for each sample, in 8.8 fixed point
+		int32_t sums[SOUND_MIXER_FRAMES * 2];
+
+		/// @brief The output sample rate in Hz
+		uint32_t sample_rate = 0;
+
+		/// @brief Gain out of 64 applied to the mix
+		uint8_t volume = 64;
+
+		/// @brief CPU cycles spent mixing voices since the last printStats()
+		uint64_t voice_cycles = 0;
+
+		/// @brief Frames mixed from voices since the last printStats()
+		uint64_t voice_frames = 0;
+
+		/// @brief CPU cycles spent scaling and saturating the mix since the last printStats()
+		uint64_t output_cycles = 0;
+
+		/// @brief Frames output since the last printStats()
+		uint64_t output_frames = 0;
+
+		/// @brief Largest number of voices mixed at once since the last printStats()
+		int peak_voices = 0;
+
+		int mixVoice(voice& v, int32_t target_gain);
+		bool refill(voice& v);
+		void removeVoice(voice& v);
+};
@@ -1,13 +1,38 @@
 #include "SoundPlayer.h"
 
+/// @brief Analyzer fed by the audio library, there's only ever one player
+static AudioAnalyzer* sample_analyzer = NULL;
+
+/// @brief Set when a sound starts, cleared by the audio library's first sample
+static volatile bool awaiting_first_sample = false;
+
+/// @brief Time in microseconds the first sample of the current sound was sent
+static volatile uint32_t first_sample_time = 0;
+
+/// @brief Tracks the I2S buffers, fed by the audio library as well as the mixer
+static OutputMonitor* output_monitor = NULL;
+
+/// @brief Frames from the audio library not yet passed to output_monitor
+static uint32_t library_frames = 0;
+
+/// @brief Gain out of 64 for each volume step, used for the mix of device-native chimes that bypasses the audio library
+static const uint8_t volume_gains[22] = { 0, 1, 2, 3, 4, 6, 8, 10, 12, 14, 17, 20, 23, 27, 30, 34, 38, 43, 48, 52, 58, 64 };
+
 /// @brief Create an audio player object
 /// @param Storage Reference to an SDCard object
 /// @param LEDs Reference to an LEDRing object
 /// @param Hooks Reference to an Webhook object
 /// @param Settings_file Path to settings file
-SoundPlayer::SoundPlayer(Storage* Storage, String Settings_file) {
+/// @param Analyzer Reference to an AudioAnalyzer object fed with the sound being played
+SoundPlayer::SoundPlayer(Storage* Storage, String Settings_file, AudioAnalyzer* Analyzer) : cache(Storage), index(Storage, "/chimes", Settings_file.substring(0, Settings_file.lastIndexOf('/')) + "/chime_index.bin"), remote(Storage, "/remote", Settings_file.substring(0, Settings_file.lastIndexOf('/')) + "/remote_cache.json") {
 	storage = Storage;
 	settings_file = Settings_file;
+	analyzer = Analyzer;
+	sample_analyzer = Analyzer;
+	command_queue = xQueueCreate(4, sizeof(player_command));
+	files_mutex = xSemaphoreCreateMutex();
+	stats_mutex = xSemaphoreCreateMutex();
+	output_monitor = &monitor;
 }
 
 /// @brief Initializes the audio player
@@ -16,13 +41,41 @@ SoundPlayer::SoundPlayer(Storage* Storage, String Settings_file) {
 /// @param I2S_DOUT DOUT pin number
 /// @return True on success
 bool SoundPlayer::begin(int I2S_BCLK, int I2S_LRC, int I2S_DOUT) {
-	if(player.setPinout(I2S_BCLK, I2S_LRC, I2S_DOUT)) {
-		player.setVolume(10); // default 0...21
+	pins[0] = I2S_BCLK;
+	pins[1] = I2S_LRC;
+	pins[2] = I2S_DOUT;
+	if(player.setPinout(I2S_BCLK, I2S_LRC, I2S_DOUT) && installOutput()) {
+		player.setVolume(volume); // default 0...21
+		mixer.setVolume(volume_gains[volume]);
 		return true;
 	}
 	return false;
 }
 
+/// @brief Installs the I2S driver with the current number of DMA buffers, replacing the audio library's. Only while nothing plays.
+/// @return True on success
+bool SoundPlayer::installOutput() {
+	// Set field by field, the layout of these structures changes between IDF versions
+	i2s_config_t config = {};
+	config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX);
+	config.sample_rate = 44100;
+	config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+	config.channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT;
+	config.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+	config.intr_alloc_flags = ESP_INTR_FLAG_LEVEL1;
+	config.dma_buf_count = dma_buffers;
+	config.dma_buf_len = SOUND_PLAYER_DMA_FRAMES;
+	config.use_apll = false;
+	// Play silence rather than old audio if the buffers run dry
+	config.tx_desc_auto_clear = true;
+	i2s_driver_uninstall(SOUND_PLAYER_I2S_PORT);
+	if (i2s_driver_install(SOUND_PLAYER_I2S_PORT, &config, 0, NULL) != ESP_OK) {
+		Serial.println("Could not install I2S driver");
+		return false;
+	}
+	return player.setPinout(pins[0], pins[1], pins[2]);
+}
+
 /* For debugging
 /// @brief Called by Audio library, shows file information
 /// @param info Pointer to info object
@@ -32,55 +85,322 @@ void audio_info(const char *info){
 }
 */
 
-/// @brief Calls the audio player loop function (should be done in the main loop or equivalent)
-void SoundPlayer::callLoop() {
-	player.loop();
+/// @brief Feeds a sample about to be sent to I2S to the analyzer
+/// @param sample The left and right 16-bit samples
+static void analyzeSample(uint32_t sample) {
+	if (awaiting_first_sample) {
+		first_sample_time = micros();
+		awaiting_first_sample = false;
+	}
+	if (sample_analyzer != NULL)
+		sample_analyzer->addSample((int16_t)(sample & 0xFFFF), (int16_t)(sample >> 16));
 }
 
-/// @brief Play a random chime sound from the selected options
-/// @return The full path to the random sound file chosen to be played
-String SoundPlayer::playChimeSound() {
-	if (_files.size() == 0)
-		return "";
-	String sound = _files[random(0, _files.size())];
-	playFile(sound);
-	return sound;
+/// @brief Called by Audio library for each sample before it is sent to I2S, feeds the analyzer and the output monitor
+/// @param sample Pointer to the left and right 16-bit samples
+/// @param continueI2S Set to true so the library still sends the sample
+void audio_process_i2s(uint32_t* sample, bool* continueI2S) {
+	analyzeSample(*sample);
+	// Checking the time for every sample would cost too much
+	if (++library_frames == 64) {
+		output_monitor->addFrames(library_frames);
+		library_frames = 0;
+	}
+	*continueI2S = true;
+}
+
+/// @brief Wraps the audio task for static access.
+/// @param arg The SoundPlayer object.
+void SoundPlayer::processCommandTaskWrapper(void* arg) {
+	static_cast<SoundPlayer*>(arg)->processCommand();
 }
 
-/// @brief Play a random chime sound from the selected options
-/// @param sound The full path of the sound file to played
+/// @brief Runs commands and feeds the playing sound to I2S as an infinite loop
+void SoundPlayer::processCommand() {
+	player_command command;
+	bool preloading = false;
+	while(true)
+	{
+		// Sleep until a command arrives while idle, keep feeding the sound while playing, and only yield between files while preloading
+		if (xQueueReceive(command_queue, &command, isRunning() ? 0 : (preloading ? 1 : pdMS_TO_TICKS(SOUND_PLAYER_IDLE_MS))) == pdTRUE) {
+			runCommand(command);
+		}
+		player.loop();
+		if (player.isRunning())
+			monitor.setSampleRate(player.getSampleRate());
+		if (mixing)
+			feedMixer();
+		// The audio library and the mixer are only touched by this task, so other tasks ask through this
+		can_overlap = !player.isRunning() && mixer.hasFreeVoice();
+		if (measuring && !awaiting_first_sample) {
+			measuring = false;
+			Serial.println("Time to first sample: " + String(first_sample_time - request_time) + "us from " + playing_from);
+		}
+		// Sounds waiting in the queue keep the player busy
+		if (started && !isRunning() && uxQueueMessagesWaiting(command_queue) == 0) {
+			started = false;
+			finishPlayback();
+			busy = false;
+			remote.stopPlaying();
+			if (finished_handler != NULL)
+				finished_handler();
+		}
+		if (isRunning()) {
+			// Let lower priority tasks run while I2S drains
+			vTaskDelay(1);
+		} else {
+			// Newly downloaded sounds are worth keeping in memory too
+			if (remote.takeChanges())
+				cache_pending = true;
+			if (cache_pending) {
+				// Reload the cache between sounds so reading storage never delays playback
+				cache_pending = false;
+				xSemaphoreTake(files_mutex, portMAX_DELAY);
+				std::vector<String> files = _files;
+				xSemaphoreGive(files_mutex);
+				std::vector<String> paths = localPaths(files, false);
+				paths.erase(std::remove(paths.begin(), paths.end(), String()), paths.end());
+				cache.startPreload(paths);
+				preloading = true;
+			}
+			// Load one file per pass, so a command arriving meanwhile waits for at most one file
+			if (preloading && uxQueueMessagesWaiting(command_queue) == 0)
+				preloading = cache.preloadNext();
+		}
+	}
+}
+
+/// @brief Runs a command in the audio task
+/// @param command The command
+void SoundPlayer::runCommand(player_command& command) {
+	switch (command.command) {
+		case PLAY:
+			// A sound that fails to start is finished on the next loop, unless another sound is still playing
+			playFiles(*command.files, command.time, command.duck);
+			started = true;
+			delete command.files;
+			break;
+		case STOP:
+			if (mixing)
+				stopMixer();
+			else
+				player.stopSong();
+			break;
+		case VOLUME:
+			player.setVolume(command.volume);
+			mixer.setVolume(volume_gains[command.volume < 0 ? 0 : (command.volume < 21 ? command.volume : 21)]);
+			break;
+	}
+}
+
+/// @brief Adds a command to the audio task's queue
+/// @param command The command
 /// @return True on success
-bool SoundPlayer::playChimeSound(String sound) {
-	return playFile(sound);
+bool SoundPlayer::sendCommand(player_command& command) {
+	if (xQueueSendToBack(command_queue, &command, 10) == errQUEUE_FULL) {
+		Serial.println("Audio command queue full");
+		return false;
+	}
+	return true;
+}
+
+/// @brief Play a random chime sound from the selected options. Sounds from URLs that haven't been downloaded yet are passed over.
+/// @param chime Set to the index of the chosen sound in the list of files, or -1 if there are none
+/// @return The full path or URL of the random sound chosen to be played
+String SoundPlayer::playChimeSound(int& chime) {
+	chime = -1;
+	xSemaphoreTake(files_mutex, portMAX_DELAY);
+	String sound;
+	for (int tries = 0; tries < _files.size() && sound.isEmpty(); tries++) {
+		if (shuffle_bag.empty()) {
+			// Refill and shuffle the bag
+			for (int i = 0; i < _files.size(); i++) {
+				shuffle_bag.push_back(i);
+			}
+			for (int i = shuffle_bag.size() - 1; i > 0; i--) {
+				std::swap(shuffle_bag[i], shuffle_bag[random(0, i + 1)]);
+			}
+			// Don't repeat the last chime of the previous round
+			if (shuffle_bag.size() > 1 && shuffle_bag.back() == last_chime)
+				std::swap(shuffle_bag.back(), shuffle_bag.front());
+		}
+		chime = shuffle_bag.back();
+		shuffle_bag.pop_back();
+		last_chime = chime;
+		sound = _files[chime];
+		if (RemoteCache::isRemote(sound) && remote.getLocalPath(sound, false).isEmpty()) {
+			// Never wait on the network, try another chime
+			Serial.println("Remote chime not downloaded yet: " + sound);
+			sound = "";
+			chime = -1;
+		}
+	}
+	String fallback_notes = fallback;
+	xSemaphoreGive(files_mutex);
+	if (!sound.isEmpty() && playChimeSound(sound))
+		return sound;
+	// Fall back to a synthesized chime if there's no sound file to play, but not if another sound is in the way
+	if (busy || fallback_notes.isEmpty())
+		return "";
+	Serial.println("Playing fallback chime");
+	// The fallback isn't one of the files, so no chime animation goes with it
+	chime = -1;
+	sound = SYNTH_PREFIX + fallback_notes;
+	return playChimeSound(sound) ? sound : "";
+}
+
+/// @brief Play a specific chime sound, the audio task starts it shortly after.
+/// While a sound is playing, only device-native and synthesized chimes can be played over it, see canOverlap().
+/// @param sound The full path of the sound file to played, the URL of a downloaded sound, or SYNTH_PREFIX followed by a preset name or notes
+/// @param duck True to lower any other sounds while this one plays, e.g. for an announcement
+/// @return True if the sound was queued
+bool SoundPlayer::playChimeSound(String sound, bool duck) {
+	return queueSounds({ sound }, duck);
+}
+
+/// @brief Play device-native chimes one after another without a gap, e.g. a tone followed by an announcement.
+/// Each chime is prebuffered while the one before it plays. Chimes must share the sample rate and channels of the first, others are skipped.
+/// @param sounds The full paths of the chimes, in order
+/// @param duck True to lower any other sounds while these play
+/// @return True if the sequence was queued
+bool SoundPlayer::playSequence(const std::vector<String>& sounds, bool duck) {
+	for (const String& sound : sounds) {
+		if (!sound.endsWith(CHIME_EXTENSION)) {
+			Serial.println("Only device-native chimes can be played in a sequence: " + sound);
+			return false;
+		}
+	}
+	return queueSounds(sounds, duck);
+}
+
+/// @brief Checks sounds can be played and sends them to the audio task
+/// @param sounds The full paths or URLs of the sound files, played one after another
+/// @param duck True to lower any other sounds while these play
+/// @return True if the sounds were queued
+bool SoundPlayer::queueSounds(const std::vector<String>& sounds, bool duck) {
+	if (sounds.empty()) {
+		return false;
+	}
+	std::vector<String> files = localPaths(sounds, true);
+	if (busy && (!isNative(files[0]) || !canOverlap())) {
+		Serial.println("Can't play " + sounds[0] + " over the sound that's playing");
+		return false;
+	}
+	for (int i = 0; i < files.size(); i++) {
+		if (files[i].isEmpty()) {
+			Serial.println("Remote chime not downloaded yet: " + sounds[i]);
+			return false;
+		}
+		if (!files[i].startsWith(SYNTH_PREFIX) && !cache.contains(files[i]) && !storage->fileExists(files[i])) {
+			Serial.println("Sound file doesn't exist: " + files[i]);
+			return false;
+		}
+	}
+	player_command command { PLAY, 0, trigger_set ? trigger_time : (uint32_t)micros(), duck, new std::vector<String>(files) };
+	trigger_set = false;
+	busy = true;
+	// Keep downloads off the storage, and the files on it, while the sounds play
+	remote.startPlaying(files);
+	if (!sendCommand(command)) {
+		delete command.files;
+		busy = false;
+		remote.stopPlaying();
+		return false;
+	}
+	return true;
+}
+
+/// @brief Finds where sounds downloaded from URLs are kept on storage
+/// @param sounds The full paths or URLs of the sounds
+/// @param touch True to mark downloaded sounds as recently used
+/// @return The full paths of the sounds, empty for URLs that haven't been downloaded
+std::vector<String> SoundPlayer::localPaths(const std::vector<String>& sounds, bool touch) {
+	std::vector<String> paths;
+	paths.reserve(sounds.size());
+	for (const String& sound : sounds) {
+		paths.push_back(RemoteCache::isRemote(sound) ? remote.getLocalPath(sound, touch) : sound);
+	}
+	return paths;
+}
+
+/// @brief Stops the sound being played
+/// @return True if the command was queued
+bool SoundPlayer::stop() {
+	player_command command { STOP, 0, 0, false, NULL };
+	return sendCommand(command);
+}
+
+/// @brief Sets the volume of the sound player
+/// @param Volume The volume, 0 to 21
+/// @return True if the command was queued
+bool SoundPlayer::setVolume(int Volume) {
+	volume = Volume;
+	player_command command { VOLUME, Volume, 0, false, NULL };
+	return sendCommand(command);
+}
+
+/// @brief Sets a function the audio task calls when a sound has finished, or failed to start
+/// @param handler The function, it must not block
+void SoundPlayer::setFinishedHandler(void (*handler)()) {
+	finished_handler = handler;
 }
 
 /// @brief Checks to see if a sound is playing
-/// @return True while a sound is playing
+/// @return True from when a sound is requested until it has finished
 bool SoundPlayer::isPlaying() {
-	return player.isRunning();
+	return busy;
+}
+
+/// @brief Checks if a sound is played by the mixer, which are device-native and synthesized chimes
+/// @param sound The full path of the sound file, or SYNTH_PREFIX followed by a preset name or notes
+/// @return True if the sound can be mixed
+bool SoundPlayer::isNative(const String& sound) {
+	return sound.endsWith(CHIME_EXTENSION) || sound.startsWith(SYNTH_PREFIX);
+}
+
+/// @brief Checks if a device-native chime can be played over the sounds that are playing.
+/// Only device-native and synthesized chimes are mixed, other sounds are decoded by the audio library which needs I2S to itself.
+/// Safe to call from any task, it reads a flag the audio task updates on every pass.
+/// @return True if a sound is playing, it isn't decoded by the audio library, and the mixer has a free voice
+bool SoundPlayer::canOverlap() {
+	return busy && can_overlap;
+}
+
+/// @brief Checks if the audio task is sending a sound to I2S
+/// @return True while a sound is playing
+bool SoundPlayer::isRunning() {
+	return mixing || player.isRunning();
 }
 
 /// @brief Gets the currently saved settings of the sound player
 /// @return A JSON string of the settings
 String SoundPlayer::getSettings() {
-	String settings = "{\"volume\":" + String(player.getVolume()) + ",\"files\": [";
-	bool first = true;
-	for (String path : _files) {
-		if (first) {
-			settings += '"' + path + '"';
-			first = false;
-		} else {
-			settings += ", \"" + path + '"';
-		}
+	xSemaphoreTake(files_mutex, portMAX_DELAY);
+	DynamicJsonDocument settings(JSON_OBJECT_SIZE(5) + JSON_ARRAY_SIZE(_files.size()));
+	settings["volume"] = volume;
+	settings["cacheSize"] = cache.getBudget() / 1024;
+	settings["remoteCacheSize"] = remote.getBudget() / 1024;
+	settings["fallback"] = fallback.c_str();
+	JsonArray files = settings.createNestedArray("files");
+	for (const String& path : _files) {
+		// Stored as pointers, so the paths aren't copied
+		files.add(path.c_str());
 	}
-	settings += "]}";
-	return settings;
+	String json;
+	json.reserve(measureJson(settings) + 1);
+	serializeJson(settings, json);
+	xSemaphoreGive(files_mutex);
+	return json;
 }
 
 /// @brief Loads the saved settings for the sound player
 /// @return True on success
 bool SoundPlayer::loadSettings() {
 	Serial.println("Loading audio settings....");
+	index.load();
+	// Remote chimes are optional, the doorbell works without them
+	if (!remote.begin())
+		Serial.println("Could not start remote chime downloads");
 	String content = storage->readFile(settings_file);
 	if (content != "") {
 		Serial.println("Audio settings loaded.");
@@ -105,7 +425,7 @@ bool SoundPlayer::updateSettings(String settings) {
 		// Parse settings string
 		settings.trim();
 		Serial.println("New settings : " + settings);
-		DynamicJsonDocument new_settings(2048);
+		DynamicJsonDocument new_settings(2048 + settings.length() * 2);
 		DeserializationError error = deserializeJson(new_settings, settings);
 		if (error) {
 			Serial.println("Bad settings data received");
@@ -113,28 +433,267 @@ bool SoundPlayer::updateSettings(String settings) {
 		}
 		new_settings.shrinkToFit();
 		// Set volume
-		player.setVolume(new_settings["volume"].as<int>()); 
-		// Remove old file list
-		for (int i = 0; i < _files.size(); i++) {
-			_files[i].clear();
-		}
-		_files.clear();
-		// Create new file list
+		setVolume(new_settings["volume"].as<int>());
+		// Set size of the chime cache in KB
+		cache.setBudget((new_settings["cacheSize"] | CHIME_CACHE_DEFAULT_KB) * 1024);
+		// Set size of the storage for chimes downloaded from URLs in KB
+		remote.setBudget((new_settings["remoteCacheSize"] | REMOTE_CACHE_DEFAULT_KB) * 1024);
+		// Create new file list, probing storage for chimes the index doesn't know yet, e.g. ones copied to the SD card by hand
+		std::vector<String> files;
 		for (String path : new_settings["files"].as<JsonArray>()) {
-			_files.push_back(path);
+			// URLs are downloaded in the background, see RemoteCache
+			if (RemoteCache::isRemote(path) || index.contains(path) || index.add(path))
+				files.push_back(path);
+			else
+				Serial.println("Skipping missing chime " + path);
 		}
+		// Replace old file list
+		xSemaphoreTake(files_mutex, portMAX_DELAY);
+		_files.swap(files);
+		// Preset name or notes of the synthesized chime used when a sound file can't be played
+		fallback = new_settings["fallback"] | "ding-dong";
+		shuffle_bag.clear();
+		last_chime = -1;
+		remote.setUrls(_files);
+		xSemaphoreGive(files_mutex);
+		cache_pending = true;
 		return true;
 	}
 	return false;
 }
 
-/// @brief Play a specific audio file
-/// @param file The full path of the audio file
+/// @brief Gets the chime sound files that can be played
+/// @return A copy of the full paths of the sound files, the list can be replaced at any time
+std::vector<String> SoundPlayer::getFiles() {
+	xSemaphoreTake(files_mutex, portMAX_DELAY);
+	std::vector<String> files = _files;
+	xSemaphoreGive(files_mutex);
+	return files;
+}
+
+/// @brief Adds a new or changed chime sound to the index and reloads the cached chime sounds once nothing is playing
+/// @param path The full path of the chime sound
+/// @return True on success
+bool SoundPlayer::addChime(const String& path) {
+	cache_pending = true;
+	return index.add(path);
+}
+
+/// @brief Removes a deleted chime sound from the index and reloads the cached chime sounds once nothing is playing
+/// @param path The full path of the chime sound
+/// @return True on success
+bool SoundPlayer::removeChime(const String& path) {
+	cache_pending = true;
+	return index.remove(path);
+}
+
+/// @brief Gets one part of the list of chime sounds as JSON, see ChimeIndex::getListPart()
+/// @param part The part to get, starting at 0
+/// @return The JSON text of the part, or an empty string after the last part
+String SoundPlayer::getChimeListPart(size_t part) {
+	return index.getListPart(part);
+}
+
+/// @brief Gets the I2S buffer counters of the last playback
+/// @return A JSON string of the counters
+String SoundPlayer::getStats() {
+	xSemaphoreTake(stats_mutex, portMAX_DELAY);
+	OutputMonitor::stats stats = last_stats;
+	xSemaphoreGive(stats_mutex);
+	StaticJsonDocument<JSON_OBJECT_SIZE(7)> json;
+	json["frames"] = stats.frames;
+	json["sampleRate"] = stats.sample_rate;
+	json["underruns"] = stats.underruns;
+	json["minFillMs"] = stats.min_fill_us / 1000.0;
+	json["maxGapMs"] = stats.max_gap_us / 1000.0;
+	json["bufferMs"] = stats.capacity_us / 1000.0;
+	json["dmaBuffers"] = dma_buffers;
+	String result;
+	serializeJson(json, result);
+	return result;
+}
+
+/// @brief Sets when the next sound was requested, so the time until it's heard can be measured
+/// @param time The time in microseconds, e.g. when the button was pressed
+void SoundPlayer::setTriggerTime(uint32_t time) {
+	trigger_time = time;
+	trigger_set = true;
+}
+
+/// @brief Play audio files one after another, more than one file must all be device-native chimes
+/// @param files The full paths of the audio files
+/// @param time Time in microseconds the sound was requested
+/// @param duck True to lower any other sounds while these play
+/// @return True on success
+bool SoundPlayer::playFiles(const std::vector<String>& files, uint32_t time, bool duck) {
+	const String& file = files[0];
+	bool native = isNative(file);
+	if (player.isRunning() || (mixing && !native)) {
+		Serial.println("Can't play " + file + " over the sound that's playing");
+		return false;
+	}
+	if (!mixing) {
+		// A new playback, rather than a chime mixed over one that's playing
+		monitor.start(dma_buffers * SOUND_PLAYER_DMA_FRAMES);
+		library_frames = 0;
+	}
+	request_time = time;
+	Serial.println("Playing: " + file + (files.size() > 1 ? " and " + String(files.size() - 1) + " more" : ""));
+	if (!mixing)
+		analyzer->reset();
+	first_sample_time = 0;
+	awaiting_first_sample = true;
+	measuring = true;
+	// Play from memory when possible, falling back to storage
+	bool success;
+	if (native) {
+		// Device-native chimes skip the decoder
+		bool valid;
+		SoundSource* source;
+		if (file.startsWith(SYNTH_PREFIX)) {
+			// Synthesized chimes don't read anything
+			SynthSource* synth = new SynthSource(file.substring(strlen(SYNTH_PREFIX)));
+			playing_from = "the synthesizer";
+			valid = synth->begin();
+			source = synth;
+		} else if (files.size() > 1) {
+			SequenceSource* sequence = new SequenceSource(&cache, files);
+			playing_from = cache.contains(file) ? "memory" : "storage";
+			valid = sequence->begin();
+			source = sequence;
+		} else {
+			bool cached;
+			ChimeSource* chime = new ChimeSource(cache.openFile(file, cached));
+			playing_from = cached ? "memory" : "storage";
+			valid = chime->begin();
+			source = chime;
+		}
+		if (valid) {
+			success = playNative(source, duck);
+		} else {
+			delete source;
+			success = false;
+		}
+	} else {
+		success = cache.contains(file) && player.connecttoFS(cache.getFS(), file.c_str());
+		playing_from = success ? "memory" : "storage";
+		if (!success)
+			success = player.connecttoFS(Storage::getFS(), file.c_str());
+	}
+	xSemaphoreTake(files_mutex, portMAX_DELAY);
+	String fallback_notes = fallback;
+	xSemaphoreGive(files_mutex);
+	if (!success && !file.startsWith(SYNTH_PREFIX) && !fallback_notes.isEmpty()) {
+		// Storage or decoding failed, play a chime that needs neither
+		Serial.println("Playing fallback chime");
+		SynthSource* synth = new SynthSource(fallback_notes);
+		playing_from = "the synthesizer";
+		if (synth->begin()) {
+			success = playNative(synth, duck);
+		} else {
+			delete synth;
+		}
+	}
+	if (!success) {
+		awaiting_first_sample = false;
+		measuring = false;
+	}
+	return success;
+}
+
+/// @brief Adds a device-native sound to the mix, which is written to I2S without the audio library
+/// @param source The sound, deleted on failure or once it has played
+/// @param duck True to lower the other voices while this one plays
 /// @return True on success
-bool SoundPlayer::playFile(String file) {
-	Serial.println("Playing: " + file);
-	if (Storage::isUsingLittleFS())
-		return player.connecttoFS(LittleFS, file.c_str());
-	else
-		return player.connecttoFS(SD_MMC, file.c_str());
-}
\ No newline at end of file
+bool SoundPlayer::playNative(SoundSource* source, bool duck) {
+	bool idle = !mixer.isActive();
+	if (mixer.addVoice(source, CHIME_UNITY_GAIN, duck) < 0) {
+		Serial.println("No free voices to play the chime");
+		delete source;
+		return false;
+	}
+	if (idle) {
+		player.setSampleRate(mixer.getSampleRate());
+		monitor.setSampleRate(mixer.getSampleRate());
+	}
+	mixing = true;
+	// Fill the DMA buffers right away
+	feedMixer();
+	return true;
+}
+
+/// @brief Writes as much of the mix to I2S as fits without waiting
+void SoundPlayer::feedMixer() {
+	while (mixing) {
+		if (mix_written < mix_bytes) {
+			size_t written = 0;
+			i2s_write(SOUND_PLAYER_I2S_PORT, (uint8_t*)mix_frames + mix_written, mix_bytes - mix_written, &written, 0);
+			mix_written += written;
+			if (written > 0)
+				monitor.addFrames(written / (2 * sizeof(int16_t)));
+			if (mix_written < mix_bytes) {
+				// DMA buffers are full, continue on the next loop
+				return;
+			}
+		}
+		size_t frames = mixer.mix(mix_frames);
+		if (frames == 0) {
+			stopMixer();
+			return;
+		}
+		for (int i = 0; i < frames * 2; i += 2) {
+			// Feed the analyzer like the audio library does
+			analyzeSample((uint16_t)mix_frames[i] | ((uint32_t)(uint16_t)mix_frames[i + 1] << 16));
+		}
+		mix_bytes = frames * 2 * sizeof(int16_t);
+		mix_written = 0;
+	}
+}
+
+/// @brief Stops all the device-native chimes and reports what mixing them cost
+void SoundPlayer::stopMixer() {
+	mixer.stopAll();
+	mixer.printStats();
+	mix_bytes = 0;
+	mix_written = 0;
+	mixing = false;
+}
+
+/// @brief Keeps the counters of the playback that just finished and resizes the DMA buffers to suit.
+/// Buffers grow after an underrun or a close call, and shrink after several playbacks that never came close.
+void SoundPlayer::finishPlayback() {
+	if (library_frames > 0) {
+		monitor.addFrames(library_frames);
+		library_frames = 0;
+	}
+	OutputMonitor::stats stats = monitor.getStats();
+	xSemaphoreTake(stats_mutex, portMAX_DELAY);
+	last_stats = stats;
+	xSemaphoreGive(stats_mutex);
+	if (stats.frames == 0) {
+		return;
+	}
+	if (!stats.filled) {
+		// Too short to fill the buffers, so there's nothing to learn from it
+		Serial.println("Playback: too short to measure the I2S buffers");
+		return;
+	}
+	Serial.println("Playback: " + String(stats.underruns) + " underruns, at least " + String(stats.min_fill_us / 1000) + " of " + String(stats.capacity_us / 1000) 
+		+ " ms buffered, longest gap between writes " + String(stats.max_gap_us / 1000) + " ms");
+	int buffers = dma_buffers;
+	if (stats.underruns > 0 || stats.min_fill_us < stats.capacity_us / 4) {
+		smooth_playbacks = 0;
+		buffers = min(dma_buffers + 2, SOUND_PLAYER_DMA_MAX_BUFFERS);
+	} else if (stats.min_fill_us > stats.capacity_us * 3 / 4 && ++smooth_playbacks >= SOUND_PLAYER_SHRINK_AFTER) {
+		smooth_playbacks = 0;
+		buffers = max(dma_buffers - 1, SOUND_PLAYER_DMA_MIN_BUFFERS);
+	}
+	if (buffers != dma_buffers) {
+		Serial.println("Resizing I2S buffers from " + String(dma_buffers) + " to " + String(buffers));
+		dma_buffers = buffers;
+		// Uninstalling the driver drops whatever is still queued, so let the end of the sound play out first
+		vTaskDelay(pdMS_TO_TICKS(monitor.getBufferedUs() / 1000 + SOUND_PLAYER_DRAIN_MARGIN_MS));
+		if (!installOutput())
+			Serial.println("Could not resize I2S buffers");
+	}
+}
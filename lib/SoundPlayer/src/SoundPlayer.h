@@ -15,32 +15,202 @@
 #include <ArduinoJson.h>
 #include <LEDRing.h>
 #include <Webhooks.h>
+#include <AudioAnalyzer.h>
+#include "ChimeCache.h"
+#include "ChimeConverter.h"
+#include "ChimeIndex.h"
+#include "ChimeSource.h"
+#include "SoundMixer.h"
+#include "SequenceSource.h"
+#include "SynthSource.h"
+#include "OutputMonitor.h"
+#include "RemoteCache.h"
+#include <driver/i2s.h>
 
 class SoundPlayer {
 	public:
-		SoundPlayer(Storage* Storage, String Settings_file);
+		SoundPlayer(Storage* Storage, String Settings_file, AudioAnalyzer* Analyzer);
 		bool begin(int I2S_BCLK, int I2S_LRC, int I2S_DOUT);
-		void callLoop();
-		String playChimeSound();
-		bool playChimeSound(String sound);
+		static void processCommandTaskWrapper(void* arg);
+		String playChimeSound(int& chime);
+		bool playChimeSound(String sound, bool duck = false);
+		bool playSequence(const std::vector<String>& sounds, bool duck = false);
+		bool stop();
+		bool setVolume(int Volume);
 		bool isPlaying();
+		bool canOverlap();
+		void setFinishedHandler(void (*handler)());
 		bool loadSettings();
 		String getSettings();
 		bool saveSettings();
 		bool updateSettings(String settings);
+		std::vector<String> getFiles();
+		bool addChime(const String& path);
+		bool removeChime(const String& path);
+		String getChimeListPart(size_t part);
+		String getStats();
+		void setTriggerTime(uint32_t time);
 		
 	private:
+		/// @brief I2S port used by the audio library, mixed device-native chimes are written straight to it
+		#define SOUND_PLAYER_I2S_PORT I2S_NUM_0
+
+		/// @brief Time in milliseconds between checks of the chime cache while idle
+		#define SOUND_PLAYER_IDLE_MS 100
+
+		/// @brief Frames in each I2S DMA buffer, about 12 ms at 44.1 kHz
+		#define SOUND_PLAYER_DMA_FRAMES 512
+
+		/// @brief Fewest and most I2S DMA buffers, the most is a 32 KB budget of internal RAM
+		#define SOUND_PLAYER_DMA_MIN_BUFFERS 4
+		#define SOUND_PLAYER_DMA_MAX_BUFFERS 16
+
+		/// @brief Number of I2S DMA buffers at startup
+		#define SOUND_PLAYER_DMA_DEFAULT_BUFFERS 8
+
+		/// @brief Number of playbacks in a row with plenty of buffered audio before a DMA buffer is freed
+		#define SOUND_PLAYER_SHRINK_AFTER 5
+
+		/// @brief Time in milliseconds waited on top of the audio still queued before the I2S driver is replaced, covers the buffer the DMA is playing
+		#define SOUND_PLAYER_DRAIN_MARGIN_MS 20
+
+		/// @brief Commands handled by the audio task
+		enum commands { PLAY, STOP, VOLUME };
+
+		/// @brief A command for the audio task
+		struct player_command {
+			/// @brief The command, one of commands
+			uint8_t command;
+
+			/// @brief The volume for VOLUME
+			int volume;
+
+			/// @brief Time in microseconds the sound was requested for PLAY
+			uint32_t time;
+
+			/// @brief Whether other sounds are ducked while the sound plays for PLAY
+			bool duck;
+
+			/// @brief The full paths of the sound files to play one after another for PLAY, deleted by the audio task
+			std::vector<String>* files;
+		};
+
+		/// @brief Queue of commands for the audio task
+		QueueHandle_t command_queue;
+
+		/// @brief Set from when a sound is requested until it has finished
+		volatile bool busy = false;
+
+		/// @brief Set by the audio task while the audio library is idle and the mixer has a free voice, see canOverlap()
+		volatile bool can_overlap = true;
+
+		/// @brief Set by the audio task once it has handled a sound, until every sound has finished
+		bool started = false;
+
+		/// @brief Called by the audio task when a sound finishes
+		void (*finished_handler)() = NULL;
+
+		/// @brief The volume, 0 to 21
+		int volume = 10;
+
+		/// @brief Preset name or notes of the synthesized chime played when a sound file can't be played, empty to disable
+		String fallback = "ding-dong";
+
+		/// @brief Protects the list of files
+		SemaphoreHandle_t files_mutex;
+
 		/// @brief The audio player object
 		Audio player;
 
 		/// @brief Reference to the SDCard object
 		Storage* storage;
 
-		/// @brief Collection of audio files that can be played
+		/// @brief Collection of audio files that can be played, full paths or URLs of sounds downloaded in the background
 		std::vector<String> _files;
 
 		/// @brief Path to settings file
 		String settings_file;
 
-		bool playFile(String file);
+		/// @brief Analyzes the sound being played
+		AudioAnalyzer* analyzer;
+
+		/// @brief Keeps the chime sounds in memory
+		ChimeCache cache;
+
+		/// @brief Details of every chime sound on the storage
+		ChimeIndex index;
+
+		/// @brief Keeps the chime sounds downloaded from URLs on storage
+		RemoteCache remote;
+
+		/// @brief Indexes into _files not yet chosen this round, so every chime plays once before any repeats
+		std::vector<uint16_t> shuffle_bag;
+
+		/// @brief Index into _files of the last chime chosen, -1 if none
+		int last_chime = -1;
+
+		/// @brief Set when the cached sounds should be reloaded once nothing is playing
+		volatile bool cache_pending = false;
+
+		/// @brief Time in microseconds the next sound was requested, for measuring latency
+		uint32_t trigger_time = 0;
+
+		/// @brief Set when trigger_time was provided for the next sound
+		bool trigger_set = false;
+
+		/// @brief Time in microseconds the sound being played was requested
+		uint32_t request_time = 0;
+
+		/// @brief Set while waiting to report the latency of the sound being played
+		bool measuring = false;
+
+		/// @brief Where the sound being played comes from: memory, storage, or the synthesizer
+		const char* playing_from = "storage";
+
+		/// @brief I2S pin numbers, kept to set them again when the DMA buffers are resized
+		int pins[3];
+
+		/// @brief Number of I2S DMA buffers in use
+		int dma_buffers = SOUND_PLAYER_DMA_DEFAULT_BUFFERS;
+
+		/// @brief Playbacks in a row with plenty of buffered audio
+		int smooth_playbacks = 0;
+
+		/// @brief Tracks the I2S buffers during a playback
+		OutputMonitor monitor;
+
+		/// @brief Counters of the last playback
+		OutputMonitor::stats last_stats = {};
+
+		/// @brief Protects last_stats
+		SemaphoreHandle_t stats_mutex;
+
+		/// @brief Mixes the device-native chimes being played
+		SoundMixer mixer;
+
+		/// @brief Set from when the first device-native chime starts until the mix has been written to I2S
+		bool mixing = false;
+
+		/// @brief Mixed stereo frames waiting to be written to I2S
+		int16_t mix_frames[SOUND_MIXER_FRAMES * 2];
+
+		/// @brief Number of bytes in mix_frames
+		size_t mix_bytes = 0;
+
+		/// @brief Number of bytes of mix_frames already written to I2S
+		size_t mix_written = 0;
+
+		void processCommand();
+		void runCommand(player_command& command);
+		bool sendCommand(player_command& command);
+		bool isRunning();
+		bool queueSounds(const std::vector<String>& sounds, bool duck);
+		std::vector<String> localPaths(const std::vector<String>& sounds, bool touch);
+		static bool isNative(const String& sound);
+		bool playFiles(const std::vector<String>& files, uint32_t time, bool duck);
+		bool playNative(SoundSource* source, bool duck);
+		void feedMixer();
+		void stopMixer();
+		bool installOutput();
+		void finishPlayback();
 };
\ No newline at end of file
@@ -0,0 +1,36 @@
+/*
+ * This file is licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "ChimeConverter.h"
+
+/// @brief Largest number of frames a sound source returns from each read
+#define SOUND_SOURCE_FRAMES CHIME_BLOCK_FRAMES
+
+/// @brief A sound that can be played by the mixer, it produces 16-bit frames at its own sample rate
+class SoundSource {
+	public:
+		virtual ~SoundSource() {}
+
+		/// @brief Gets the sample rate of the sound
+		/// @return The sample rate in Hz
+		virtual uint32_t getSampleRate() = 0;
+
+		/// @brief Gets the number of channels of the sound
+		/// @return 1 or 2
+		virtual uint16_t getChannels() = 0;
+
+		/// @brief Gets the gain the sound should be played with, e.g. its normalization gain
+		/// @return The gain in 8.8 fixed point
+		virtual uint16_t getGain() { return CHIME_UNITY_GAIN; }
+
+		/// @brief Reads the next frames of the sound
+		/// @param frames Receives up to SOUND_SOURCE_FRAMES frames, interleaved by channel
+		/// @return The number of frames read, 0 once the sound has ended
+		virtual size_t read(int16_t* frames) = 0;
+};
@@ -0,0 +1,170 @@
+#include "SynthSource.h"
+
+int16_t SynthSource::table[SYNTH_TABLE_SIZE + 1];
+bool SynthSource::table_ready = false;
+
+/// @brief Creates a synthesized chime
+/// @param Notes The notes to play, or the name of a preset, see getPreset()
+SynthSource::SynthSource(const String& Notes) {
+	text = getPreset(Notes);
+	// Per frame factor that fades a note to 1/e over SYNTH_DECAY_MS
+	decay = (int32_t)(expf(-1000.0f / (SYNTH_DECAY_MS * (float)SYNTH_SAMPLE_RATE)) * (1 << 30));
+	for (oscillator& o : oscillators) {
+		o.increment = 0;
+	}
+}
+
+/// @brief Gets the notes of a built-in chime
+/// @param name The name of the chime, "ding-dong" or "westminster"
+/// @return The notes of the chime, or name if it isn't a preset
+String SynthSource::getPreset(const String& name) {
+	if (name == "ding-dong")
+		return "E5:600 C5:1500";
+	if (name == "westminster")
+		return "E5 C5 D5 G4:1000 G4 D5 E5 C5:1500";
+	return name;
+}
+
+/// @brief Prepares the wavetable and reads the notes
+/// @return True if there's at least one valid note
+bool SynthSource::begin() {
+	if (!table_ready) {
+		// A fundamental with fading harmonics sounds close to a struck chime
+		for (int i = 0; i < SYNTH_TABLE_SIZE; i++) {
+			float phase = 2.0f * PI * i / SYNTH_TABLE_SIZE;
+			float value = sinf(phase) + 0.4f * sinf(2 * phase) + 0.2f * sinf(3 * phase) + 0.1f * sinf(4 * phase);
+			table[i] = (int16_t)(value / 1.45f * 32767);
+		}
+		table[SYNTH_TABLE_SIZE] = table[0];
+		table_ready = true;
+	}
+	return parse();
+}
+
+/// @brief Gets the sample rate of the chime
+/// @return The sample rate in Hz
+uint32_t SynthSource::getSampleRate() {
+	return SYNTH_SAMPLE_RATE;
+}
+
+/// @brief Gets the number of channels of the chime
+/// @return Always 1
+uint16_t SynthSource::getChannels() {
+	return 1;
+}
+
+/// @brief Renders the next frames of the chime
+/// @param frames Receives up to SOUND_SOURCE_FRAMES mono frames
+/// @return The number of frames rendered, 0 once every note has faded out
+size_t SynthSource::read(int16_t* frames) {
+	size_t count = 0;
+	for (; count < SOUND_SOURCE_FRAMES; count++, frame++) {
+		while (next_note < notes.size() && notes[next_note].start <= frame) {
+			startNote(notes[next_note++].increment);
+		}
+		int32_t sum = 0;
+		bool ringing = false;
+		for (oscillator& o : oscillators) {
+			if (o.increment == 0) {
+				continue;
+			}
+			int32_t level = o.level >> 15;
+			if (level < SYNTH_SILENT_LEVEL && o.age >= SYNTH_ATTACK_FRAMES) {
+				o.increment = 0;
+				continue;
+			}
+			ringing = true;
+			if (o.age < SYNTH_ATTACK_FRAMES) {
+				level = level * o.age / SYNTH_ATTACK_FRAMES;
+			}
+			// Interpolate between wavetable steps with a 15-bit fraction
+			uint32_t index = o.phase >> 24;
+			int32_t fraction = (o.phase >> 9) & 0x7FFF;
+			int32_t sample = table[index] + (((table[index + 1] - table[index]) * fraction) >> 15);
+			sum += (sample * level) >> 15;
+			o.phase += o.increment;
+			o.level = ((int64_t)o.level * decay) >> 30;
+			o.age++;
+		}
+		if (!ringing && next_note >= notes.size()) {
+			break;
+		}
+		frames[count] = sum > 32767 ? 32767 : (sum < -32768 ? -32768 : sum);
+	}
+	return count;
+}
+
+/// @brief Reads the notes of the chime
+/// @return True if there's at least one valid note
+bool SynthSource::parse() {
+	// Semitones above C of each note name from A to G
+	static const int8_t semitones[7] = { 9, 11, 0, 2, 4, 5, 7 };
+	uint32_t start = 0;
+	int position = 0;
+	text.trim();
+	while (position < text.length() && notes.size() < SYNTH_MAX_NOTES) {
+		int end = text.indexOf(' ', position);
+		if (end < 0)
+			end = text.length();
+		String token = text.substring(position, end);
+		position = end + 1;
+		if (token.isEmpty())
+			continue;
+		char name = toupper(token[0]);
+		if (name < 'A' || name > 'G') {
+			Serial.println("Bad synth note: " + token);
+			return false;
+		}
+		int i = 1;
+		int semitone = semitones[name - 'A'];
+		if (i < token.length() && (token[i] == '#' || token[i] == 'b')) {
+			semitone += token[i] == '#' ? 1 : -1;
+			i++;
+		}
+		if (i >= token.length() || !isDigit(token[i])) {
+			Serial.println("Bad synth note: " + token);
+			return false;
+		}
+		int octave = token[i] - '0';
+		int colon = token.indexOf(':');
+		long gap = SYNTH_DEFAULT_GAP_MS;
+		if (colon > 0) {
+			gap = token.substring(colon + 1).toInt();
+			if (gap < 0) {
+				Serial.println("Bad synth gap: " + token);
+				return false;
+			}
+			if (gap > SYNTH_MAX_GAP_MS)
+				gap = SYNTH_MAX_GAP_MS;
+		}
+		// MIDI note number, A4 is 69 at 440 Hz
+		int midi = (octave + 1) * 12 + semitone;
+		float frequency = 440.0f * powf(2.0f, (midi - 69) / 12.0f);
+		if (frequency >= SYNTH_SAMPLE_RATE / 2) {
+			Serial.println("Synth note too high: " + token);
+			return false;
+		}
+		notes.push_back(note { start, (uint32_t)(frequency * 4294967296.0 / SYNTH_SAMPLE_RATE) });
+		// Can't overflow, SYNTH_MAX_NOTES gaps of SYNTH_MAX_GAP_MS are about 14 million frames
+		start += (uint64_t)gap * SYNTH_SAMPLE_RATE / 1000;
+	}
+	return !notes.empty();
+}
+
+/// @brief Starts a note on a free oscillator, or the quietest one if all are ringing
+/// @param increment Phase step per frame of the note
+void SynthSource::startNote(uint32_t increment) {
+	oscillator* quietest = &oscillators[0];
+	for (oscillator& o : oscillators) {
+		if (o.increment == 0) {
+			quietest = &o;
+			break;
+		}
+		if (o.level < quietest->level)
+			quietest = &o;
+	}
+	quietest->phase = 0;
+	quietest->increment = increment;
+	quietest->level = SYNTH_NOTE_LEVEL << 15;
+	quietest->age = 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <vector>
+#include "SoundSource.h"
+
+/// @brief Marks a sound path as a synthesized chime, followed by a preset name or notes, e.g. "synth:westminster"
+#define SYNTH_PREFIX "synth:"
+
+/// @brief Sample rate synthesized chimes are rendered at
+#define SYNTH_SAMPLE_RATE 22050
+
+/// @brief Number of notes that can ring at once
+#define SYNTH_OSCILLATORS 4
+
+/// @brief Number of steps in the wavetable, a power of 2
+#define SYNTH_TABLE_SIZE 256
+
+/// @brief Peak level of each note
+#define SYNTH_NOTE_LEVEL 9000
+
+/// @brief Length of the attack of each note in frames, about 3 ms
+#define SYNTH_ATTACK_FRAMES 64
+
+/// @brief Time in milliseconds for a note to fade to about a third of its level
+#define SYNTH_DECAY_MS 700
+
+/// @brief Time in milliseconds before the next note if a note doesn't give one
+#define SYNTH_DEFAULT_GAP_MS 500
+
+/// @brief Longest time in milliseconds before the next note, longer gaps are shortened to this
+#define SYNTH_MAX_GAP_MS 10000
+
+/// @brief Notes quieter than this are stopped, about -60 dBFS
+#define SYNTH_SILENT_LEVEL 32
+
+/// @brief Largest number of notes in a chime
+#define SYNTH_MAX_NOTES 64
+
+/// @brief Renders a chime from a list of notes with wavetable oscillators in fixed point, without reading any files.
+/// Notes are written like "E5:600 C5", a note name, optional # or b, octave, and the milliseconds until the next note starts.
+class SynthSource : public SoundSource {
+	public:
+		SynthSource(const String& Notes);
+		bool begin();
+		uint32_t getSampleRate();
+		uint16_t getChannels();
+		size_t read(int16_t* frames);
+		static String getPreset(const String& name);
+
+	private:
+		/// @brief A note of the chime
+		struct note {
+			/// @brief Frame the note starts at
+			uint32_t start;
+
+			/// @brief Phase step per frame, a full cycle is 2^32
+			uint32_t increment;
+		};
+
+		/// @brief A ringing note
+		struct oscillator {
+			/// @brief Position in the wavetable, a full cycle is 2^32
+			uint32_t phase;
+
+			/// @brief Phase step per frame, 0 if the oscillator is free
+			uint32_t increment;
+
+			/// @brief Peak level of the note in 16.15 fixed point, decays every frame
+			int32_t level;
+
+			/// @brief Frames since the note started
+			uint32_t age;
+		};
+
+		/// @brief The notes as written
+		String text;
+
+		/// @brief The notes, in the order they start
+		std::vector<note> notes;
+
+		/// @brief Index into notes of the next note to start
+		size_t next_note = 0;
+
+		/// @brief Number of frames rendered so far
+		uint32_t frame = 0;
+
+		/// @brief The ringing notes
+		oscillator oscillators[SYNTH_OSCILLATORS];
+
+		/// @brief Factor each level is multiplied by every frame, in 2.30 fixed point
+		int32_t decay;
+
+		/// @brief One cycle of a bell-like tone, with the first step repeated at the end for interpolation
+		static int16_t table[SYNTH_TABLE_SIZE + 1];
+
+		/// @brief Set once table has been filled
+		static bool table_ready;
+
+		bool parse();
+		void startNote(uint32_t increment);
+};
@@ -1,54 +1,9 @@
 #include "Storage.h"
-bool Storage::useLittleFS = false;
 
-/// @brief Mount and initiate the storage. Will format if necessary
-/// @param clk The clock pin number
-/// @param cmd The cmd pin number
-/// @param d0 D0 pin number
-/// @param d1 D1 pin number
-/// @param d2 D2 pin number
-/// @param d3 D3 pin number
+/// @brief Mount and initiate the storage chosen at compile time, see StorageBackend
 /// @return True on success
-bool Storage::begin(int clk, int cmd, int d0, int d1, int d2, int d3) {
-	bool success = SD_MMC.setPins(clk, cmd, d0, d1, d2, d3);
-	if (success) {
-		Serial.println("Mounting storage...");
-		if (!SD_MMC.begin("/sd", false, true, 10000)) {
-			Serial.println("Card Mount Failed");
-			success = false;
-		}
-		if (success) {
-			uint8_t cardType = SD_MMC.cardType();
-
-			if(cardType == CARD_NONE) {
-				Serial.println("No SD_MMC card attached");
-				success = false;
-			}
-			if (success) {
-				Serial.print("SD_MMC Card Type: ");
-				if (cardType == CARD_MMC) {
-					Serial.println("MMC");
-				} else if(cardType == CARD_SD) {
-					Serial.println("SDSC");
-				} else if(cardType == CARD_SDHC) {
-					Serial.println("SDHC");
-				} else {
-					Serial.println("UNKNOWN");
-				}
-				uint64_t cardSize = SD_MMC.cardSize() / 1048576; // 1024 * 1024
-				Serial.printf("SD_MMC Card Size: %lluMB\n", cardSize);
-			}
-		}
-	}
-	return success;
-}
-
-/// @brief Mount LittleFS and format if necessary
-/// @return True on successful mount of LittleFS
 bool Storage::begin() {
-	Storage::useLittleFS = true;
-	Serial.println("Mounting  LittleFS, this could take a while, please wait...");
-	return LittleFS.begin(true, "/sd");
+	return StorageBackend::mount();
 }
 
 /// @brief List the files and folders in a directory
@@ -58,11 +13,7 @@ bool Storage::begin() {
 std::vector<String> Storage::listDir(String dirname, uint8_t levels) {
 	Serial.println("Listing directory: " + dirname);
 	std::vector<String> folderContents;
-	File root;
-	if(useLittleFS)
-		root = LittleFS.open(dirname);
-	else
-		root = SD_MMC.open(dirname);
+	File root = getFS().open(dirname);
 
 	if(!root){
 		Serial.println("Failed to open directory");
@@ -94,11 +45,7 @@ std::vector<String> Storage::listDir(String dirname, uint8_t levels) {
 /// @return True if it exists
 bool Storage::fileExists(String path) {
 	Serial.println("Checking for file: " + path);
-	if(useLittleFS)
-		return LittleFS.exists(path);
-	else
-		return SD_MMC.exists(path);
-
+	return getFS().exists(path);
 }
 
 /// @brief Creates a directory on the storage
@@ -106,10 +53,7 @@ bool Storage::fileExists(String path) {
 /// @return True on success
 bool Storage::createDir(String path) {
 	Serial.println("Creating Dir: " + path);
-	if(useLittleFS)
-		return LittleFS.mkdir(path);
-	else
-		return SD_MMC.mkdir(path);
+	return getFS().mkdir(path);
 }
 
 /// @brief Removes a directory from the storage
@@ -117,7 +61,7 @@ bool Storage::createDir(String path) {
 /// @return True on success
 bool Storage::removeDir(String path) {
 	Serial.println("Removing Dir:" + path);
-	return rmdir(path.c_str());
+	return getFS().rmdir(path);
 }
 
 /// @brief Reads the contents of a file from the storage
@@ -125,22 +69,87 @@ bool Storage::removeDir(String path) {
 /// @return A String of the file contents, empty string on failure
 String Storage::readFile(String path) {
 	Serial.println("Reading file: " + path);
-	File file;
-	if(useLittleFS)
-		file = LittleFS.open(path);
-	else
-		file = SD_MMC.open(path);
-
-	if (!file) {
+	File file = getFS().open(path);
+	if (!file || file.isDirectory()) {
 		Serial.println("Failed to open file for reading");
 		return "";
 	}
-	String output = "";
-	while(file.available()){
-		output += file.readString();
+	// Reserved once and filled a chunk at a time, so the contents are never in memory twice
+	size_t size = file.size();
+	String content;
+	if (!content.reserve(size)) {
+		Serial.println("Not enough memory to read file");
+		file.close();
+		return "";
+	}
+	char chunk[STORAGE_READ_CHUNK];
+	size_t length;
+	while (content.length() < size && (length = file.read((uint8_t*)chunk, sizeof(chunk))) > 0) {
+		content.concat(chunk, length);
+	}
+	file.close();
+	if (content.length() != size) {
+		Serial.println("Failed to read file");
+		return "";
+	}
+	return content;
+}
+
+/// @brief Reads the contents of a file from the storage with one allocation and one read, sized from the file
+/// @param path The path of the file to read
+/// @param buffer Set to the contents of the file
+/// @return True on success
+bool Storage::readFile(String path, file_buffer& buffer) {
+	Serial.println("Reading file: " + path);
+	File file = getFS().open(path);
+	if (!file || file.isDirectory()) {
+		Serial.println("Failed to open file for reading");
+		return false;
+	}
+	size_t size = file.size();
+	// Keep large files out of internal RAM
+	char* data = (char*)(size >= STORAGE_PSRAM_THRESHOLD && psramFound() ? ps_malloc(size + 1) : malloc(size + 1));
+	if (data == NULL) {
+		Serial.println("Not enough memory to read file");
+		file.close();
+		return false;
 	}
+	buffer.data = std::shared_ptr<char>(data, free);
+	buffer.size = file.read((uint8_t*)data, size);
+	data[buffer.size] = '\0';
 	file.close();
-	return output;
+	if (buffer.size != size) {
+		Serial.println("Failed to read file");
+		buffer.data.reset();
+		buffer.size = 0;
+		return false;
+	}
+	return true;
+}
+
+/// @brief Opens a file on the storage for direct access
+/// @param path The path of the file to open
+/// @param mode The mode to open the file in (FILE_READ, FILE_WRITE, FILE_APPEND)
+/// @return The file handle, which evaluates to false on failure
+File Storage::openFile(String path, const char* mode) {
+	Serial.println("Opening file: " + path);
+	return getFS().open(path, mode);
+}
+
+/// @brief Gets the size and last modification time of a file
+/// @param path The path of the file
+/// @param size Set to the size of the file in bytes
+/// @param lastWrite Set to the time the file was last written
+/// @return True on success
+bool Storage::getFileInfo(String path, size_t& size, time_t& lastWrite) {
+	File file = getFS().open(path);
+	if (!file || file.isDirectory()) {
+		return false;
+	}
+	size = file.size();
+	lastWrite = file.getLastWrite();
+	file.close();
+	return true;
 }
 
 /// @brief Writes data to a file, creates a file if necessary
@@ -149,11 +158,7 @@ String Storage::readFile(String path) {
 /// @return True on success
 bool Storage::writeFile(String path, String content) {
 	Serial.println("Writing file: " + path);
-	File file;
-	if(useLittleFS)
-		file = LittleFS.open(path, FILE_WRITE);
-	else
-		file = SD_MMC.open(path, FILE_WRITE);
+	File file = getFS().open(path, FILE_WRITE);
 	if (!file) {
 		Serial.println("Failed to open file for writing");
 		return false;
@@ -167,11 +172,7 @@ bool Storage::writeFile(String path, String content) {
 /// @return True on success
 bool Storage::appendFile(String path, String content) {
 	Serial.println("Appending to file: " + path);
-	File file;
-	if(useLittleFS)
-		file = LittleFS.open(path, FILE_APPEND);
-	else
-		file = SD_MMC.open(path, FILE_APPEND);
+	File file = getFS().open(path, FILE_APPEND);
 	if (!file) {
 		Serial.println("Failed to open file for appending");
 		return false;
@@ -185,10 +186,7 @@ bool Storage::appendFile(String path, String content) {
 /// @return True on success
 bool Storage::renameFile(String path1, String path2) {
 	Serial.println("Renaming file" + path1 + " to " + path2);
-	if(useLittleFS)
-		return LittleFS.rename(path1, path2);
-	else
-		return SD_MMC.rename(path1, path2);
+	return getFS().rename(path1, path2);
 }
 
 /// @brief Deletes a file from the storage
@@ -196,8 +194,26 @@ bool Storage::renameFile(String path1, String path2) {
 /// @return True on success
 bool Storage::deleteFile(String path) {
 	Serial.println("Deleting file: " + path);
-	if(useLittleFS)
-		return LittleFS.remove(path);
-	else
-		return SD_MMC.remove(path);
-}
\ No newline at end of file
+	return getFS().remove(path);
+}
+
+/// @brief Quotes text as a JSON string, for files and responses written without a JSON document
+/// @param text The text to quote
+/// @return The quoted and escaped text
+String Storage::quoteJson(const char* text) {
+	String quoted = "\"";
+	for (; *text != '\0'; text++) {
+		char c = *text;
+		if (c == '"' || c == '\\') {
+			quoted += '\\';
+			quoted += c;
+		} else if ((uint8_t)c < 0x20) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04X", c);
+			quoted += escaped;
+		} else {
+			quoted += c;
+		}
+	}
+	return quoted + '"';
+}
@@ -8,28 +8,43 @@
 
 #pragma once
 #include <FS.h>
-#include <SD_MMC.h>
-#include <LittleFS.h>
+#include <memory>
 #include <vector>
+#include "StorageBackend.h"
 
 class Storage {
 	public:
-		bool begin(int clk, int cmd, int d0, int d1, int d2, int d3);
+		/// @brief A file read into memory in one pass, see readFile()
+		struct file_buffer {
+			/// @brief The contents followed by a null, so they can be parsed in place. Freed when the last copy is gone.
+			std::shared_ptr<char> data;
+
+			/// @brief Size of the contents in bytes, not counting the null
+			size_t size;
+		};
+
 		bool begin();
-		/// @brief Checks if the current storage media is LittleFS or SD_MMC
-		/// @return True if LittleFS is being used
-		static bool isUsingLittleFS() { return useLittleFS; }
+		/// @brief Gets the file system of the storage chosen at compile time, for libraries that read files themselves
+		/// @return The file system
+		static fs::FS& getFS() { return StorageBackend::getFS(); }
 		std::vector<String> listDir(String dirname, uint8_t levels);
 		bool fileExists(String path);
 		bool createDir(String path);
 		bool removeDir(String path);
 		String readFile(String path);
+		bool readFile(String path, file_buffer& buffer);
+		File openFile(String path, const char* mode = FILE_READ);
+		bool getFileInfo(String path, size_t& size, time_t& lastWrite);
 		bool writeFile(String path, String content);
 		bool appendFile(String path, String content);
 		bool renameFile(String path1, String path2);
 		bool deleteFile(String path);
-		
+		static String quoteJson(const char* text);
+
 	private:
-		/// @brief Static variable storing what storage medium is being used
-		static bool useLittleFS;
+		/// @brief Files at least this many bytes are read into PSRAM when there is some
+		#define STORAGE_PSRAM_THRESHOLD 16384
+
+		/// @brief Size in bytes of the stack buffer files are read into a String through
+		#define STORAGE_READ_CHUNK 256
 };
\ No newline at end of file
@@ -0,0 +1,337 @@
+#include "StorageBackend.h"
+
+// Only the chosen backend is built, so the others' libraries aren't needed
+#if defined(USE_SDCARD)
+#include <SD_MMC.h>
+
+/// @brief Mount and initiate the SD card. Will format if necessary
+/// @return True on success
+bool SDCardBackend::mount() {
+	bool success = SD_MMC.setPins(SD_CLK_PIN, SD_CMD_PIN, SD_D0_PIN, SD_D1_PIN, SD_D2_PIN, SD_D3_PIN);
+	if (success) {
+		Serial.println("Mounting storage...");
+		if (!SD_MMC.begin("/sd", false, true, 10000)) {
+			Serial.println("Card Mount Failed");
+			success = false;
+		}
+		if (success) {
+			uint8_t cardType = SD_MMC.cardType();
+
+			if(cardType == CARD_NONE) {
+				Serial.println("No SD_MMC card attached");
+				success = false;
+			}
+			if (success) {
+				Serial.print("SD_MMC Card Type: ");
+				if (cardType == CARD_MMC) {
+					Serial.println("MMC");
+				} else if(cardType == CARD_SD) {
+					Serial.println("SDSC");
+				} else if(cardType == CARD_SDHC) {
+					Serial.println("SDHC");
+				} else {
+					Serial.println("UNKNOWN");
+				}
+				uint64_t cardSize = SD_MMC.cardSize() / 1048576; // 1024 * 1024
+				Serial.printf("SD_MMC Card Size: %lluMB\n", cardSize);
+			}
+		}
+	}
+	return success;
+}
+
+/// @brief Gets the file system of the SD card
+/// @return The file system
+fs::FS& SDCardBackend::getFS() {
+	return SD_MMC;
+}
+
+#elif defined(USE_POSIX_STORAGE)
+#include <FSImpl.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// @brief A file or directory in the storage directory, opened with the POSIX file API
+class PosixFile : public fs::FileImpl {
+	public:
+		PosixFile(const String& FullPath, const String& Path, const char* mode);
+		~PosixFile() { close(); }
+		size_t write(const uint8_t *buf, size_t size);
+		size_t read(uint8_t* buf, size_t size);
+		void flush();
+		bool seek(uint32_t pos, fs::SeekMode mode);
+		size_t position() const;
+		size_t size() const;
+		bool setBufferSize(size_t size);
+		void close();
+		time_t getLastWrite();
+		const char* path() const { return file_path.c_str(); }
+		const char* name() const;
+		boolean isDirectory(void) { return dir != NULL; }
+		fs::FileImplPtr openNextFile(const char* mode);
+		boolean seekDir(long position);
+		String getNextFileName(void);
+		String getNextFileName(bool* isDir);
+		void rewindDirectory(void);
+		operator bool() { return file != NULL || dir != NULL; }
+
+	private:
+		/// @brief The path on the machine, including STORAGE_POSIX_ROOT
+		String full_path;
+
+		/// @brief The path on the storage
+		String file_path;
+
+		/// @brief The open file, NULL for a directory
+		FILE* file = NULL;
+
+		/// @brief The open directory, NULL for a file
+		DIR* dir = NULL;
+
+		String nextEntry();
+};
+
+/// @brief Serves STORAGE_POSIX_ROOT through the POSIX file API
+class PosixFS : public fs::FSImpl {
+	public:
+		fs::FileImplPtr open(const char* path, const char* mode, const bool create);
+		bool exists(const char* path);
+		bool rename(const char* pathFrom, const char* pathTo);
+		bool remove(const char* path);
+		bool mkdir(const char *path);
+		bool rmdir(const char *path);
+
+	private:
+		String fullPath(const char* path);
+};
+
+/// @brief Opens a file or directory
+/// @param FullPath The path on the machine
+/// @param Path The path on the storage
+/// @param mode The mode to open a file in, directories are always read
+PosixFile::PosixFile(const String& FullPath, const String& Path, const char* mode) : full_path(FullPath), file_path(Path) {
+	struct stat info;
+	if (stat(full_path.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+		if (mode[0] == 'r') {
+			dir = opendir(full_path.c_str());
+		}
+	} else {
+		file = fopen(full_path.c_str(), mode);
+	}
+}
+
+size_t PosixFile::write(const uint8_t *buf, size_t size) {
+	return file == NULL ? 0 : fwrite(buf, 1, size, file);
+}
+
+size_t PosixFile::read(uint8_t* buf, size_t size) {
+	return file == NULL ? 0 : fread(buf, 1, size, file);
+}
+
+void PosixFile::flush() {
+	if (file != NULL) {
+		fflush(file);
+	}
+}
+
+bool PosixFile::seek(uint32_t pos, fs::SeekMode mode) {
+	// SeekMode has the values of SEEK_SET, SEEK_CUR and SEEK_END
+	return file != NULL && fseek(file, pos, mode) == 0;
+}
+
+size_t PosixFile::position() const {
+	return file == NULL ? 0 : ftell(file);
+}
+
+size_t PosixFile::size() const {
+	if (file == NULL) {
+		return 0;
+	}
+	// Count writes that are still buffered
+	fflush(file);
+	struct stat info;
+	return fstat(fileno(file), &info) == 0 ? info.st_size : 0;
+}
+
+bool PosixFile::setBufferSize(size_t size) {
+	return file != NULL && setvbuf(file, NULL, _IOFBF, size) == 0;
+}
+
+void PosixFile::close() {
+	if (file != NULL) {
+		fclose(file);
+		file = NULL;
+	}
+	if (dir != NULL) {
+		closedir(dir);
+		dir = NULL;
+	}
+}
+
+time_t PosixFile::getLastWrite() {
+	flush();
+	struct stat info;
+	return stat(full_path.c_str(), &info) == 0 ? info.st_mtime : 0;
+}
+
+const char* PosixFile::name() const {
+	int slash = file_path.lastIndexOf('/');
+	return file_path.c_str() + slash + 1;
+}
+
+/// @brief Opens the next file or directory in a directory
+/// @param mode The mode to open a file in
+/// @return The file, NULL when there are no more
+fs::FileImplPtr PosixFile::openNextFile(const char* mode) {
+	String entry = nextEntry();
+	if (entry.isEmpty()) {
+		return fs::FileImplPtr();
+	}
+	String path = file_path.endsWith("/") ? file_path + entry : file_path + "/" + entry;
+	std::shared_ptr<PosixFile> next = std::make_shared<PosixFile>(full_path + "/" + entry, path, mode);
+	if (!*next) {
+		return fs::FileImplPtr();
+	}
+	return next;
+}
+
+boolean PosixFile::seekDir(long position) {
+	if (dir == NULL) {
+		return false;
+	}
+	seekdir(dir, position);
+	return true;
+}
+
+String PosixFile::getNextFileName(void) {
+	bool isDir;
+	return getNextFileName(&isDir);
+}
+
+/// @brief Gets the path of the next file or directory in a directory without opening it
+/// @param isDir Set to true if it is a directory
+/// @return The path, empty when there are no more
+String PosixFile::getNextFileName(bool* isDir) {
+	String entry = nextEntry();
+	if (entry.isEmpty()) {
+		return entry;
+	}
+	struct stat info;
+	*isDir = stat((full_path + "/" + entry).c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+	return file_path.endsWith("/") ? file_path + entry : file_path + "/" + entry;
+}
+
+void PosixFile::rewindDirectory(void) {
+	if (dir != NULL) {
+		rewinddir(dir);
+	}
+}
+
+/// @brief Reads the name of the next entry of the directory, skipping . and ..
+/// @return The name, empty when there are no more
+String PosixFile::nextEntry() {
+	if (dir == NULL) {
+		return "";
+	}
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+			return entry->d_name;
+		}
+	}
+	return "";
+}
+
+/// @brief Opens a file or directory
+/// @param path The path on the storage
+/// @param mode The mode to open a file in
+/// @param create True to create the directories leading to a file opened for writing
+/// @return The file, NULL on failure
+fs::FileImplPtr PosixFS::open(const char* path, const char* mode, const bool create) {
+	String full = fullPath(path);
+	if (mode[0] == 'r' && !exists(path)) {
+		return fs::FileImplPtr();
+	}
+	if (create && mode[0] != 'r') {
+		for (int slash = full.indexOf('/', full.length() - strlen(path) + 1); slash >= 0; slash = full.indexOf('/', slash + 1)) {
+			::mkdir(full.substring(0, slash).c_str(), 0777);
+		}
+	}
+	std::shared_ptr<PosixFile> file = std::make_shared<PosixFile>(full, path, mode);
+	if (!*file) {
+		return fs::FileImplPtr();
+	}
+	return file;
+}
+
+bool PosixFS::exists(const char* path) {
+	struct stat info;
+	return stat(fullPath(path).c_str(), &info) == 0;
+}
+
+bool PosixFS::rename(const char* pathFrom, const char* pathTo) {
+	return ::rename(fullPath(pathFrom).c_str(), fullPath(pathTo).c_str()) == 0;
+}
+
+bool PosixFS::remove(const char* path) {
+	return unlink(fullPath(path).c_str()) == 0;
+}
+
+bool PosixFS::mkdir(const char *path) {
+	return ::mkdir(fullPath(path).c_str(), 0777) == 0;
+}
+
+bool PosixFS::rmdir(const char *path) {
+	return ::rmdir(fullPath(path).c_str()) == 0;
+}
+
+/// @brief Gets the path of a file on the machine
+/// @param path The path on the storage
+/// @return The path under STORAGE_POSIX_ROOT
+String PosixFS::fullPath(const char* path) {
+	return String(mountpoint()) + path;
+}
+
+/// @brief Serves STORAGE_POSIX_ROOT
+static std::shared_ptr<PosixFS> posix_impl = std::make_shared<PosixFS>();
+
+/// @brief The file system of STORAGE_POSIX_ROOT
+static fs::FS posix_fs(posix_impl);
+
+/// @brief Checks the storage directory exists and serves it
+/// @return True on success
+bool PosixBackend::mount() {
+	Serial.println("Using storage directory " STORAGE_POSIX_ROOT);
+	struct stat info;
+	if (stat(STORAGE_POSIX_ROOT, &info) != 0 || !S_ISDIR(info.st_mode)) {
+		Serial.println("Storage directory not found");
+		return false;
+	}
+	posix_impl->mountpoint(STORAGE_POSIX_ROOT);
+	return true;
+}
+
+/// @brief Gets the file system of the storage directory
+/// @return The file system
+fs::FS& PosixBackend::getFS() {
+	return posix_fs;
+}
+
+#else
+#include <LittleFS.h>
+
+/// @brief Mount LittleFS and format if necessary
+/// @return True on successful mount of LittleFS
+bool LittleFSBackend::mount() {
+	Serial.println("Mounting  LittleFS, this could take a while, please wait...");
+	return LittleFS.begin(true, "/sd");
+}
+
+/// @brief Gets the file system of the LittleFS partition
+/// @return The file system
+fs::FS& LittleFSBackend::getFS() {
+	return LittleFS;
+}
+#endif
@@ -0,0 +1,65 @@
+/*
+ * This file and associated .cpp file are licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <FS.h>
+
+/// @brief Storage backends. Each mounts its media and serves it as a file system, and one is chosen at compile time as StorageBackend:
+/// build with -D USE_SDCARD for the SD card, -D USE_POSIX_STORAGE for a directory (e.g. on a development machine), or neither for LittleFS.
+
+/// @brief SD card pins, can be changed with build flags
+#ifndef SD_CLK_PIN
+	#define SD_CLK_PIN 8
+#endif
+#ifndef SD_CMD_PIN
+	#define SD_CMD_PIN 34
+#endif
+#ifndef SD_D0_PIN
+	#define SD_D0_PIN 9
+#endif
+#ifndef SD_D1_PIN
+	#define SD_D1_PIN 37
+#endif
+#ifndef SD_D2_PIN
+	#define SD_D2_PIN 35
+#endif
+#ifndef SD_D3_PIN
+	#define SD_D3_PIN 36
+#endif
+
+/// @brief Directory served by the POSIX backend, can be changed with a build flag
+#ifndef STORAGE_POSIX_ROOT
+	#define STORAGE_POSIX_ROOT "/sd"
+#endif
+
+/// @brief A LittleFS partition of the onboard flash, formatted if needed
+class LittleFSBackend {
+	public:
+		static bool mount();
+		static fs::FS& getFS();
+};
+
+/// @brief An SD card connected with 4 data lines
+class SDCardBackend {
+	public:
+		static bool mount();
+		static fs::FS& getFS();
+};
+
+/// @brief A directory reached through the POSIX file API, STORAGE_POSIX_ROOT. Builds on the device and on a PC (the native environment).
+class PosixBackend {
+	public:
+		static bool mount();
+		static fs::FS& getFS();
+};
+
+#if defined(USE_SDCARD)
+	typedef SDCardBackend StorageBackend;
+#elif defined(USE_POSIX_STORAGE)
+	typedef PosixBackend StorageBackend;
+#else
+	typedef LittleFSBackend StorageBackend;
+#endif
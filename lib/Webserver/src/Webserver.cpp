@@ -7,7 +7,7 @@
 /// @param Storage A reference to storage object
 /// @param Hooks A Webhook object
 /// @param Ringing Reference to a bool that can be used to indicate the bell is ringing
-Webserver::Webserver(AsyncWebServer* webserver, LEDRing* LEDs, SoundPlayer* Player, Storage* Storage, Webhooks* Hooks, bool* Ringing) {
+Webserver::Webserver(AsyncWebServer* webserver, LEDRing* LEDs, SoundPlayer* Player, Storage* Storage, Webhooks* Hooks, volatile bool* Ringing) {
 	server = webserver;
 	leds = LEDs;
 	player = Player;
@@ -27,10 +27,7 @@ bool Webserver::ServerStart() {
 
 	// Add request handler
 	if (storage->fileExists("/www/index.html")) {
-		if (Storage::isUsingLittleFS())
-			server->serveStatic("/", LittleFS, "/www/").setDefaultFile("index.html");
-		else
-			server->serveStatic("/", SD_MMC, "/www/").setDefaultFile("index.html");
+		server->serveStatic("/", Storage::getFS(), "/www/").setDefaultFile("index.html");
 	} else {
 		server->on("/", HTTP_GET, [this](AsyncWebServerRequest *request) {
 			request->send_P(HTTP_CODE_OK, "text/html", index_page);
@@ -40,7 +37,15 @@ bool Webserver::ServerStart() {
 	// Handle file uploads
 	server->on("/upload-www", HTTP_POST, [](AsyncWebServerRequest *request) { request->send(HTTP_CODE_ACCEPTED); }, onUpload_www);
 	server->on("/upload-settings", HTTP_POST, [](AsyncWebServerRequest *request) { request->send(HTTP_CODE_ACCEPTED); }, onUpload_settings);
-	server->on("/upload-chimes", HTTP_POST, [](AsyncWebServerRequest *request) { request->send(HTTP_CODE_ACCEPTED); }, onUpload_chimes);
+	server->on("/upload-chimes", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		chime_upload* upload = (chime_upload*)request->_tempObject;
+		if (upload != NULL && upload->converter.failed())
+			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Could not convert file.");
+		else
+			request->send(HTTP_CODE_ACCEPTED);
+	}, [this](AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
+		onUpload_chimes(request, filename, index, data, len, final);
+	});
 
 	// Retrieve sound settings
 	server->on("/audioSettings", HTTP_GET, [this](AsyncWebServerRequest *request) {
@@ -48,6 +53,11 @@ bool Webserver::ServerStart() {
 		request->send(HTTP_CODE_OK, "text/json", player->getSettings());
 	});
 
+	// Gets the I2S buffer counters of the last playback
+	server->on("/audioStats", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		request->send(HTTP_CODE_OK, "text/json", player->getStats());
+	});
+
 	// Saves the sound settings
 	server->on("/audioSettings", HTTP_POST, [this](AsyncWebServerRequest *request) {
 		Serial.println("Updating audio settings");
@@ -56,6 +66,7 @@ bool Webserver::ServerStart() {
 			if (player->updateSettings(settings)) {
 				request->send(HTTP_CODE_OK);
 				player->saveSettings();
+				leds->BindChimes(player->getFiles());
 			} else {
 				request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Could not parse JSON.");
 			}
@@ -107,26 +118,107 @@ bool Webserver::ServerStart() {
 		}
 	});
 
+	// Adds or replaces a single animation
+	server->on("/animation", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		Serial.println("Updating LED animation");
+		if (request->hasParam("name", true) && request->hasParam("animation", true)) {
+			String name = request->getParam("name", true)->value();
+			String animation = request->getParam("animation", true)->value();
+			if (leds->UpdateAnimation(name, animation)) {
+				request->send(HTTP_CODE_OK);
+			} else {
+				request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad animation data");
+			}
+		} else {
+			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Animation name and data required.");
+		}
+	});
+
+	// Deletes a single animation
+	server->on("/deleteAnimation", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		Serial.println("Deleting LED animation");
+		if (request->hasParam("name", true)) {
+			if (leds->DeleteAnimation(request->getParam("name", true)->value())) {
+				request->send(HTTP_CODE_OK);
+			} else {
+				request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Could not delete animation.");
+			}
+		} else {
+			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Animation name required.");
+		}
+	});
+
+	// Retrieve LED brightness and gamma settings
+	server->on("/ledSettings", HTTP_GET, [this](AsyncWebServerRequest *request) {
+		Serial.println("Getting LED settings");
+		request->send(HTTP_CODE_OK, "text/json", leds->GetSettings());
+	});
+
+	// Saves the LED brightness and gamma settings
+	server->on("/ledSettings", HTTP_POST, [this](AsyncWebServerRequest *request) {
+		Serial.println("Updating LED settings");
+		if (request->hasParam("settings", true)) {
+			String settings = request->getParam("settings", true)->value();
+			if (leds->UpdateSettings(settings)) {
+				request->send(HTTP_CODE_OK);
+				leds->SaveSettings();
+			} else {
+				request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Could not parse JSON.");
+			}
+		} else {
+			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "New settings required.");
+		}
+	});
+
 	// Play sound file
 	server->on("/ring", HTTP_POST, [this](AsyncWebServerRequest *request) {
 		Serial.println("Ringing bell from API");
 		String sound = String();
 		if (request->hasParam("sound", true))
 			sound = request->getParam("sound", true)->value();
-		if (!player->isPlaying()) {
+		// A synthesized chime, a preset name or notes
+		if (request->hasParam("synth", true))
+			sound = SYNTH_PREFIX + request->getParam("synth", true)->value();
+		// A JSON array of chimes to play one after another
+		std::vector<String> sequence;
+		if (request->hasParam("sequence", true)) {
+			String list = request->getParam("sequence", true)->value();
+			DynamicJsonDocument files(512 + list.length() * 2);
+			if (deserializeJson(files, list)) {
+				request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad sequence");
+				return;
+			}
+			for (String path : files.as<JsonArray>()) {
+				sequence.push_back(path);
+			}
+			if (!sequence.empty())
+				sound = sequence[0];
+		}
+		// Lowers any other sound while this one plays, e.g. for an announcement
+		bool duck = request->hasParam("duck", true) && request->getParam("duck", true)->value() == "true";
+		if (!player->isPlaying() || player->canOverlap()) {
+			bool overlapping = player->isPlaying();
+			// Set before playing, the audio task clears it when the sound finishes
+			*ringing = true;
 			bool success;
-			if (sound.isEmpty()) {
-				sound = player->playChimeSound();
+			if (!sequence.empty()) {
+				success = player->playSequence(sequence, duck);
+				leds->AddEventToQueue(LEDRing::Events::BELL_RING_START, sound);
+			} else if (sound.isEmpty()) {
+				int chime;
+				sound = player->playChimeSound(chime);
 				success = !sound.isEmpty();
+				leds->AddEventToQueue(LEDRing::Events::BELL_RING_START, chime);
 			} else { 
-				success = player->playChimeSound(sound);
+				success = player->playChimeSound(sound, duck);
+				leds->AddEventToQueue(LEDRing::Events::BELL_RING_START, sound);
 			}
-			leds->AddEventToQueue(LEDRing::Events::BELL_RING_START, sound.substring(sound.lastIndexOf('/') + 1, sound.indexOf('.')));
 			hooks->AddEventToQueue(LEDRing::Events::BELL_RING_START, sound);
 			if (success) {
-				*ringing = true;
 				request->send(HTTP_CODE_OK);
 			} else {
+				if (!overlapping)
+					*ringing = false;
 				request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Could not play file.");
 			}
 		} else {
@@ -141,6 +233,8 @@ bool Webserver::ServerStart() {
 			Serial.println("Deleting " + path);
 			if (storage->fileExists(path)) {
 				bool success = storage->deleteFile(path);
+				if (success && path.startsWith("/chimes/"))
+					player->removeChime(path);
 				request->send(HTTP_CODE_OK, "text/plain", success ? "OK" : "FAIL");
 			} else {
 				request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "File doesn't exist");
@@ -154,10 +248,7 @@ bool Webserver::ServerStart() {
 	server->on("/reset", HTTP_PUT, [this](AsyncWebServerRequest *request) {
 		Serial.println("Resetting WiFi settings");
 		 if (storage->fileExists("/www/reset.html")) {
-			if (Storage::isUsingLittleFS)
-				request->send(LittleFS, "/www/reset.html", "text/html");
-			else
-				request->send(SD_MMC, "/www/reset.html", "text/html");
+			request->send(Storage::getFS(), "/www/reset.html", "text/html");
 		} else {
 			request->send(HTTP_CODE_OK, "text/plain", "OK");
 		}
@@ -171,10 +262,7 @@ bool Webserver::ServerStart() {
 	// Handle reboot request
 	server->on("/reboot", HTTP_PUT, [this](AsyncWebServerRequest *request) {
 		if (storage->fileExists("/www/reboot.html")) {
-			if (Storage::isUsingLittleFS)
-				request->send(LittleFS, "/www/reboot.html", "text/html");
-			else
-				request->send(SD_MMC, "/www/reboot.html", "text/html");
+			request->send(Storage::getFS(), "/www/reboot.html", "text/html");
 		} else {
 			request->send(HTTP_CODE_OK, "text/plain", "OK");
 		}
@@ -185,7 +273,23 @@ bool Webserver::ServerStart() {
 	server->on("/list", HTTP_GET, [this](AsyncWebServerRequest *request) {
 		if (request->hasParam("path")) {
 			String path = request->getParam("path")->value();
-			if (storage->fileExists(path)) {
+			if (path == "/chimes") {
+				// Chimes are listed from the index a part at a time, so thousands of chimes don't have to be listed or held in memory
+				std::shared_ptr<chime_list> list = std::make_shared<chime_list>();
+				request->send(request->beginChunkedResponse("text/json", [this, list](uint8_t *buffer, size_t max_length, size_t index) -> size_t {
+					while (list->pending.length() < max_length) {
+						String part = player->getChimeListPart(list->part);
+						if (part.isEmpty())
+							break;
+						list->part++;
+						list->pending += part;
+					}
+					size_t length = list->pending.length() < max_length ? list->pending.length() : max_length;
+					memcpy(buffer, list->pending.c_str(), length);
+					list->pending.remove(0, length);
+					return length;
+				}));
+			} else if (storage->fileExists(path)) {
 				std::vector<String> file_list = storage->listDir(path, 0);
 				DynamicJsonDocument files(2048);
 				for (int i = 0; i < file_list.size(); i++) {
@@ -207,18 +311,10 @@ bool Webserver::ServerStart() {
 	server->on("/download", HTTP_GET, [this](AsyncWebServerRequest *request) {
 		if (request->hasParam("path")) {
 			String path = request->getParam("path")->value();
-			if(Storage::isUsingLittleFS) {
-				if (LittleFS.exists(path)) {
-					request->send(LittleFS, path, "application/octet-stream");
-				} else {
-					request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "File doesn't exist");
-				}
+			if (Storage::getFS().exists(path)) {
+				request->send(Storage::getFS(), path, "application/octet-stream");
 			} else {
-				if (SD_MMC.exists(path)) {
-					request->send(SD_MMC, path, "application/octet-stream");
-				} else {
-					request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "File doesn't exist");
-				}
+				request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "File doesn't exist");
 			}
 		} else {
 			request->send(HTTP_CODE_BAD_REQUEST, "text/plain", "Bad request data");
@@ -287,10 +383,7 @@ void Webserver::RebootChecker() {
 /// @param final
 void Webserver::onUpload_www(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
 	if (!index) {  
-		if(Storage::isUsingLittleFS())
-			request->_tempFile = LittleFS.open("/www/" + filename, "w", true);
-		else
-			request->_tempFile = SD_MMC.open("/www/" + filename, "w", true);
+		request->_tempFile = Storage::getFS().open("/www/" + filename, "w", true);
 		Serial.println("Uploading file /www/" + filename);
 	}
 	if (len) {
@@ -312,10 +405,7 @@ void Webserver::onUpload_www(AsyncWebServerRequest *request, String filename, si
 /// @param final
 void Webserver::onUpload_settings(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
 	if (!index) {    
-		if(Storage::isUsingLittleFS())
-			request->_tempFile = LittleFS.open("/settings/" + filename, "w", true);
-		else
-			request->_tempFile = SD_MMC.open("/settings/" + filename, "w", true);
+		request->_tempFile = Storage::getFS().open("/settings/" + filename, "w", true);
 		Serial.println("Uploading file /settings/" + filename);
 	}
 	if (len) {
@@ -328,7 +418,7 @@ void Webserver::onUpload_settings(AsyncWebServerRequest *request, String filenam
 	}
 }
 
-/// @brief Handle file uploads to chimes folder.
+/// @brief Handle file uploads to chimes folder, converting WAV files if requested and adding them to the chime index.
 /// @param request
 /// @param filename
 /// @param index
@@ -336,20 +426,42 @@ void Webserver::onUpload_settings(AsyncWebServerRequest *request, String filenam
 /// @param len
 /// @param final
 void Webserver::onUpload_chimes(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
-	if (!index) {    
-		if(Storage::isUsingLittleFS())
-			request->_tempFile = LittleFS.open("/chimes/" + filename, "w", true);
-		else
-			request->_tempFile = SD_MMC.open("/chimes/" + filename, "w", true);
-		Serial.println("Uploading file /chimes/" + filename);
+	if (!index) {
+		String path = "/chimes/" + filename;
+		// WAV files can be converted to a device-native chime that plays without a decoder
+		String convert = request->hasParam("convert") ? request->getParam("convert")->value() : "";
+		String extension = filename.substring(filename.lastIndexOf('.'));
+		extension.toLowerCase();
+		if ((convert == "pcm" || convert == "adpcm") && extension == ".wav") {
+			void* memory = malloc(sizeof(chime_upload));
+			if (memory != NULL) {
+				request->_tempObject = new (memory) chime_upload(&request->_tempFile, convert == "pcm" ? ChimeConverter::CHIME_PCM : ChimeConverter::CHIME_ADPCM);
+				path = path.substring(0, path.lastIndexOf('.')) + CHIME_EXTENSION;
+			}
+		}
+		request->_tempFile = Storage::getFS().open(path, "w", true);
+		Serial.println("Uploading file " + path);
 	}
+	chime_upload* upload = (chime_upload*)request->_tempObject;
 	if (len) {
 		// Stream the incoming chunk to the opened file
-		request->_tempFile.write(data, len);
+		if (upload != NULL)
+			upload->converter.write(data, len);
+		else
+			request->_tempFile.write(data, len);
 	}
 	if (final) {
+		String path = request->_tempFile.path();
+		if (upload != NULL && upload->converter.finish())
+			Serial.println("Converted to " + path + " with gain " + String(upload->converter.getHeader().gain / (float)CHIME_UNITY_GAIN));
 		// Close the file handle as the upload is now done
 		request->_tempFile.close();
+		if (upload != NULL && upload->converter.failed()) {
+			Serial.println("Could not convert " + filename);
+			Storage::getFS().remove(path);
+		} else {
+			player->addChime(path);
+		}
 	}
 }
 
@@ -388,4 +500,15 @@ void Webserver::onUpdate(AsyncWebServerRequest *request, String filename, size_t
 			Update.printError(Serial);
 		}
 	}
-}
\ No newline at end of file
+}
+
+/// @brief Overwrites part of the chime being uploaded
+/// @param offset The offset of the data to overwrite
+/// @param data The new data
+/// @param size The number of bytes to overwrite
+/// @return True on success
+bool Webserver::ChimeFileSink::patch(size_t offset, const void* data, size_t size) {
+	size_t end = file->position();
+	bool success = file->seek(offset) && file->write((const uint8_t*)data, size) == size;
+	return file->seek(end) && success;
+}
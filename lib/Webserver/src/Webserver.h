@@ -11,8 +11,6 @@
 #pragma once
 #include <ESPAsyncWebServer.h>
 #include <Update.h>
-#include <SD_MMC.h>
-#include <LittleFS.h>
 #include <HTTPClient.h>
 #include <LEDRing.h>
 #include <Storage.h>
@@ -20,6 +18,8 @@
 #include <SoundPlayer.h>
 #include <Webhooks.h>
 #include <vector>
+#include <new>
+#include <memory>
 
 /// @brief Local web server.
 class Webserver {
@@ -27,7 +27,7 @@ class Webserver {
 		/// @brief Reboot on firmware update flag
 		bool shouldReboot = false;
 		
-		Webserver(AsyncWebServer* webserver, LEDRing* LEDs, SoundPlayer* Player, Storage* Storage, Webhooks* Hooks, bool* Ringing);
+		Webserver(AsyncWebServer* webserver, LEDRing* LEDs, SoundPlayer* Player, Storage* Storage, Webhooks* Hooks, volatile bool* Ringing);
 		bool ServerStart();
 		void ServerStop();
 		static void RebootCheckerTaskWrapper(void* arg);
@@ -50,11 +50,43 @@ class Webserver {
 		Webhooks* hooks;
 
 		/// @brief Reference to a bool that can be used to indicate the bell is ringing
-		bool* ringing;
+		volatile bool* ringing;
+
+		/// @brief Writes a converted chime to the file being uploaded
+		class ChimeFileSink : public ChimeConverter::Sink {
+			public:
+				ChimeFileSink(File* File) : file(File) {}
+				bool write(const void* data, size_t size) { return file->write((const uint8_t*)data, size) == size; }
+				bool patch(size_t offset, const void* data, size_t size);
+
+			private:
+				/// @brief The file being uploaded
+				File* file;
+		};
+
+		/// @brief Conversion of a chime upload, kept in the request. It's freed with the request without being destroyed, so it must not own anything.
+		struct chime_upload {
+			chime_upload(File* File, uint16_t Format) : sink(File), converter(&sink, Format) {}
+
+			/// @brief Writes to the file of the request
+			ChimeFileSink sink;
+
+			/// @brief Converts the uploaded WAV file
+			ChimeConverter converter;
+		};
+
+		/// @brief Progress of sending the chime list
+		struct chime_list {
+			/// @brief The next part of the list to get
+			size_t part = 0;
+
+			/// @brief Text of the list not sent yet
+			String pending;
+		};
 
 		static void onUpload_www(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final);
 		static void onUpload_settings(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final);
-		static void onUpload_chimes(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final);
+		void onUpload_chimes(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final);
 		static void onUpdate(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final);
 		void RebootChecker();
 };
@@ -0,0 +1,110 @@
+# Generates lib/LEDRing/src/DefaultAnimations.h from animations.json.default so the built-in
+# animations are compiled into flash instead of being parsed at boot.
+#
+# Runs automatically before each PlatformIO build, or can be run by hand: python scripts/generate_default_animations.py
+
+import json
+import os
+
+try:
+    Import("env")
+    project_dir = env["PROJECT_DIR"]
+except NameError:
+    project_dir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+source = os.path.join(project_dir, "animations.json.default")
+target = os.path.join(project_dir, "lib", "LEDRing", "src", "DefaultAnimations.h")
+
+
+# Names of the effects in AnimationCompiler::effects
+EFFECTS = {
+    "spinner": "EFFECT_SPINNER",
+    "breathe": "EFFECT_BREATHE",
+    "chase": "EFFECT_CHASE",
+    "rainbow": "EFFECT_RAINBOW",
+    "audio": "EFFECT_AUDIO",
+}
+
+# Values of AnimationCompiler::easings
+EASINGS = {
+    "none": 0,
+    "linear": 1,
+    "ease-in": 2,
+    "ease-out": 3,
+    "ease-in-out": 4,
+}
+
+
+def parse_color(color):
+    if isinstance(color, str):
+        return int(color, 0)
+    return int(color)
+
+
+def generate():
+    with open(source) as f:
+        animations = json.load(f)["animations"]
+
+    lines = [
+        "/*",
+        " * Generated from animations.json.default by scripts/generate_default_animations.py, do not edit.",
+        " */",
+        "",
+        "#pragma once",
+        "#include <AnimationCompiler.h>",
+        "",
+    ]
+    entries = []
+    for name, animation in animations.items():
+        words = []
+        frames = animation.get("frames", [])
+        if "effect" in animation:
+            # Same layout and defaults as AnimationCompiler::effect_params
+            effect = animation["effect"]
+            period = effect.get("period", 1000)
+            words.append("AnimationCompiler::%s, 0x%06X, 0x%06X, %d, %d, %s, %d, %d" % (
+                EFFECTS[effect.get("type", "spinner")],
+                parse_color(effect.get("color", 0xFFFFFF)),
+                parse_color(effect.get("background", 0)),
+                period,
+                effect.get("width", 1),
+                "(uint32_t)-1" if effect.get("direction", 1) < 0 else "1",
+                effect.get("duration", period),
+                effect.get("interval", 20)))
+            animation_type = "ANIMATION_EFFECT"
+        else:
+            for frame in frames:
+                colors = [parse_color(c) for c in frame["colors"]]
+                # The easing shares a word with the color count, see ANIMATION_FRAME_EASING_SHIFT
+                count = "%d" % len(colors)
+                easing = EASINGS[frame.get("easing", "none")]
+                if easing:
+                    count = "0x%08X" % (len(colors) | easing << 24)
+                words.append("%d, %s, " % (frame["duration"], count) + ", ".join("0x%06X" % c for c in colors))
+            animation_type = "ANIMATION_FRAMES"
+        lines.append("/// @brief Data of the built-in %s animation" % name)
+        lines.append("static constexpr uint32_t default_%s_data[] = {" % name)
+        lines.extend("\t%s," % w for w in words)
+        lines.append("};")
+        lines.append("")
+        entries.append("\t{ \"%s\", %d, %s, %d, AnimationCompiler::%s, default_%s_data }," % (
+            name, animation["repetitions"], "true" if animation["clearOnDone"] else "false", len(frames), animation_type, name))
+
+    lines.append("/// @brief The built-in animations, shown before storage is available and overridden by custom animations")
+    lines.append("static constexpr AnimationCompiler::animation default_animations[] = {")
+    lines.extend(entries)
+    lines.append("};")
+    lines.append("")
+    content = "\n".join(lines)
+
+    # Only touch the header when it changes to avoid needless rebuilds
+    if os.path.exists(target):
+        with open(target) as f:
+            if f.read() == content:
+                return
+    with open(target, "w") as f:
+        f.write(content)
+    print("Generated " + target)
+
+
+generate()
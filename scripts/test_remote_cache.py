@@ -0,0 +1,167 @@
+# Checks the remote chime cache of a running doorbell against a local HTTP server. The server hands out
+# fixture sounds with an ETag and a Last-Modified date, answers conditional requests with 304, and logs
+# every request so the script can check what the doorbell downloaded.
+#
+# The script checks, in order:
+#   1. New URLs are downloaded (200) and stored in /remote.
+#   2. After a reboot, downloaded sounds are checked with conditional requests and not downloaded again (304).
+#   3. A sound that doesn't fit in the budget evicts the least recently used one, so /remote stays within budget.
+#
+# The audio settings are restored afterwards. Run with: python scripts/test_remote_cache.py <doorbell address> <address of this machine>
+
+import argparse
+import email.utils
+import hashlib
+import json
+import os
+import tempfile
+import threading
+import time
+import urllib.parse
+import urllib.request
+from http.server import SimpleHTTPRequestHandler, ThreadingHTTPServer
+
+# Size of each fixture sound, the budget fits two of them but not three
+FIXTURE_SIZE = 40 * 1024
+BUDGET_KB = 100
+
+# How long to wait for the doorbell to download or check the sounds
+TIMEOUT = 60
+
+requests = []
+requests_lock = threading.Lock()
+
+
+class FixtureHandler(SimpleHTTPRequestHandler):
+    """Serves the fixtures with validators and honours If-None-Match and If-Modified-Since"""
+
+    def do_GET(self):
+        path = self.translate_path(self.path)
+        if not os.path.isfile(path):
+            self.log_request_status(404)
+            self.send_error(404)
+            return
+        with open(path, "rb") as f:
+            content = f.read()
+        etag = '"%s"' % hashlib.md5(content).hexdigest()
+        modified = email.utils.formatdate(os.path.getmtime(path), usegmt=True)
+        status = 200
+        if self.headers.get("If-None-Match") == etag or self.headers.get("If-Modified-Since") == modified:
+            status = 304
+        self.log_request_status(status)
+        self.send_response(status)
+        self.send_header("ETag", etag)
+        self.send_header("Last-Modified", modified)
+        if status == 304:
+            self.end_headers()
+            return
+        self.send_header("Content-Type", "audio/mpeg")
+        self.send_header("Content-Length", str(len(content)))
+        self.end_headers()
+        self.wfile.write(content)
+
+    def log_request_status(self, status):
+        with requests_lock:
+            requests.append((self.path, status))
+
+    def log_message(self, format, *args):
+        pass
+
+
+def device_get(device, path):
+    with urllib.request.urlopen(device + path, timeout=10) as response:
+        return response.read().decode()
+
+
+def device_request(device, path, method, fields=None):
+    data = urllib.parse.urlencode(fields).encode() if fields is not None else None
+    request = urllib.request.Request(device + path, data=data, method=method)
+    with urllib.request.urlopen(request, timeout=10) as response:
+        return response.status
+
+
+def set_audio_settings(device, settings):
+    device_request(device, "/audioSettings", "POST", {"settings": json.dumps(settings)})
+
+
+def remote_files(device):
+    return json.loads(device_get(device, "/list?path=/remote")).get("files", [])
+
+
+def wait_for(description, check):
+    deadline = time.time() + TIMEOUT
+    while time.time() < deadline:
+        if check():
+            print("PASS " + description)
+            return
+        time.sleep(1)
+    raise AssertionError("FAIL " + description)
+
+
+def saw(path, status):
+    with requests_lock:
+        return (path, status) in requests
+
+
+def wait_for_device(device):
+    deadline = time.time() + TIMEOUT
+    while time.time() < deadline:
+        try:
+            device_get(device, "/audioSettings")
+            return
+        except OSError:
+            time.sleep(2)
+    raise AssertionError("FAIL doorbell came back after reboot")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Checks the remote chime cache of a doorbell")
+    parser.add_argument("device", help="Address of the doorbell, e.g. 192.168.1.50")
+    parser.add_argument("host", help="Address of this machine as seen from the doorbell")
+    parser.add_argument("--port", type=int, default=8123, help="Port to serve the fixtures on")
+    args = parser.parse_args()
+    device = "http://" + args.device
+
+    fixtures = tempfile.mkdtemp()
+    names = ["remote-a.mp3", "remote-b.mp3", "remote-c.mp3"]
+    for name in names:
+        with open(os.path.join(fixtures, name), "wb") as f:
+            f.write(os.urandom(FIXTURE_SIZE))
+    handler = lambda *handler_args: FixtureHandler(*handler_args, directory=fixtures)
+    server = ThreadingHTTPServer(("", args.port), handler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    urls = ["http://%s:%d/%s" % (args.host, args.port, name) for name in names]
+    paths = ["/" + name for name in names]
+
+    original = json.loads(device_get(device, "/audioSettings"))
+    settings = dict(original)
+    settings["remoteCacheSize"] = BUDGET_KB
+    try:
+        # 1. Two sounds fit in the budget and are downloaded
+        settings["files"] = urls[:2]
+        set_audio_settings(device, settings)
+        wait_for("sounds are downloaded", lambda: saw(paths[0], 200) and saw(paths[1], 200))
+        wait_for("sounds are stored", lambda: len(remote_files(device)) == 2)
+
+        # 2. Downloaded sounds are only checked for changes after a reboot
+        with requests_lock:
+            requests.clear()
+        device_request(device, "/reboot", "PUT")
+        time.sleep(5)
+        wait_for_device(device)
+        wait_for("unchanged sounds are not downloaded again", lambda: saw(paths[0], 304) and saw(paths[1], 304))
+        with requests_lock:
+            assert (paths[0], 200) not in requests and (paths[1], 200) not in requests, "FAIL unchanged sound downloaded again"
+
+        # 3. A third sound doesn't fit, so the least recently used one is evicted
+        settings["files"] = urls
+        set_audio_settings(device, settings)
+        wait_for("third sound is downloaded", lambda: saw(paths[2], 200))
+        wait_for("cache stays within budget", lambda: len(remote_files(device)) == 2)
+    finally:
+        set_audio_settings(device, original)
+        server.shutdown()
+
+
+if __name__ == "__main__":
+    main()
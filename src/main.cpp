@@ -7,19 +7,26 @@
 #include <LEDRing.h>
 #include <Webhooks.h>
 #include <SoundPlayer.h>
+#include <AudioAnalyzer.h>
+#ifdef USE_INTERCOM
+#include <Intercom.h>
+#endif
 #include <UMS3.h>
 
-/// @brief Uncomment to enable use of SD card instead of LittleFS
-//#define USE_SDCARD
-
 /// @brief Doorbell button pin number
 #define BUTTON_PIN 2
 
 /// @brief TinyS3 helper
 UMS3 ums3;
 
-/// @brief Set true while the bell is ringing
-bool ringing = false;
+/// @brief Set true while the bell is ringing, written by the main loop, the audio task and the web server
+volatile bool ringing = false;
+
+/// @brief Set by the interrupt when the doorbell button is pressed
+volatile bool button_pressed = false;
+
+/// @brief Time in microseconds the doorbell button was pressed
+volatile uint32_t ring_time = 0;
 
 /// @brief AsyncWebServer object (passed to WfiFiConfig and WebServer)
 AsyncWebServer server(80);
@@ -27,20 +34,29 @@ AsyncWebServer server(80);
 /// @brief Storage object
 Storage storage;
 
+/// @brief Analyzes the chime being played for the LED ring
+AudioAnalyzer analyzer;
+
 /// @brief LED ring
-LEDRing leds(&storage, "/settings/animations.json");
+LEDRing leds(&storage, "/settings/animations.json", "/settings/led_settings.json", &analyzer);
 
 /// @brief Contains webhooks to call on ring
 Webhooks hooks(&storage, "/settings/webhooks.json");
 
 /// @brief Player for ringer sounds
-SoundPlayer player(&storage, "/settings/audio_settings.json");
+SoundPlayer player(&storage, "/settings/audio_settings.json", &analyzer);
+
+#ifdef USE_INTERCOM
+	/// @brief Streams the microphone to the web interface
+	Intercom intercom(&server);
+#endif
 
 /// @brief Webserver handling all requests, needs access to all data
 Webserver webserver(&server, &leds, &player, &storage, &hooks, &ringing);
 
 // put function declarations here:
 void IRAM_ATTR RING_ISR();
+void RingFinished();
 
 void setup() {
 	
@@ -60,19 +76,14 @@ void setup() {
 	leds.begin();
 
 	// Start event processor loop
-	xTaskCreate(LEDRing::ProcessEventTaskWrapper, "Event Processor Loop", 2000, &leds, 1, NULL);
+	// Keep the LEDs on core 0 so they don't compete with the audio task on core 1
+	xTaskCreatePinnedToCore(LEDRing::ProcessEventTaskWrapper, "Event Processor Loop", 4096, &leds, 1, NULL, 0);
 
 	Serial.print("PSRAM: ");
 	Serial.println(ESP.getPsramSize());
 	delay(250);
-	bool storageMounted = false;
-	#ifdef USE_SDCARD
-		// Mount and start the SD card: clk, cmd, d0, d1, d2, d3
-		storageMounted = storage.begin(8, 34, 9, 37, 35, 36);
-	#else
-		storageMounted = storage.begin();
-	#endif
-	if (!storageMounted) {
+	// Mount the storage chosen in platformio.ini
+	if (!storage.begin()) {
 		Serial.println("Could not connect to SD card, aborting.");
 		leds.AddEventToQueue(LEDRing::Events::STORAGE_ERROR);
 		while(true) {delay(500);}
@@ -87,8 +98,9 @@ void setup() {
 		}
 	}
 
-	// Load saved animations now that SD card is ready
+	// Load saved animations and LED settings now that SD card is ready
 	leds.LoadAnimations();
+	leds.LoadSettings();
 
 	// Configure WiFi
 	DNSServer dns;
@@ -104,18 +116,30 @@ void setup() {
 	webserver.ServerStart();
 	xTaskCreate(Webserver::RebootCheckerTaskWrapper, "Reboot Checker Loop", 1000, &webserver, 1, NULL);
 
+	#ifdef USE_INTERCOM
+		// Start the intercom microphone, the doorbell works without it
+		if (!intercom.begin(6, 7, 38)) {
+			Serial.println("Could not initialize intercom microphone");
+		}
+	#endif
+
 	if (!player.begin(5, 4, 21)) {
 		Serial.println("Could not initialize audio device, aborting.");
 		leds.AddEventToQueue(LEDRing::Events::I2S_PLAYER_ERROR);
 		while(true) {delay(500);}
 	}
 
+	// Start audio task, pinned to core 1 above loop() so sound keeps flowing whatever the main loop is doing
+	player.setFinishedHandler(RingFinished);
+	xTaskCreatePinnedToCore(SoundPlayer::processCommandTaskWrapper, "Audio Loop", 8192, &player, 3, NULL, 1);
+
 	// Load audio player settings
 	if (!player.loadSettings()) {
 		Serial.println("Could not load audio device settings, aborting.");
 		leds.AddEventToQueue(LEDRing::Events::I2S_PLAYER_ERROR);
 		while(true) {delay(500);}
 	}
+	leds.BindChimes(player.getFiles());
 
 	// Load webhooks
 	if (!hooks.LoadSettings()) {
@@ -141,9 +165,6 @@ void setup() {
 ulong wifiCheck = millis() + 30000;
 
 void loop() {
-	// Maintenance call to sound player loop
-	player.callLoop();
-
 	// Ensure WiFi is connected
 	if(millis() > wifiCheck) {
 		wifiCheck = millis() + 30000;
@@ -154,35 +175,43 @@ void loop() {
 	}
 	 
 	// Check if bell should be ringing
-	if (ringing) {
+	if (button_pressed) {
 		// Check if button has been pushed for a sufficient amount of time (prevents false positives)
 		delay(25);
-		if (!digitalRead(BUTTON_PIN)) {
-			// Check if bell is not already ringing
-			if (!player.isPlaying()) {
-				String file = player.playChimeSound();
-				leds.AddEventToQueue(LEDRing::Events::BELL_RING_START, file.substring(file.lastIndexOf('/') + 1, file.indexOf('.')));
+		// Check if bell is not already ringing, or the new chime can be mixed over the one ringing
+		if (!digitalRead(BUTTON_PIN) && (!ringing || player.canOverlap())) {
+			bool overlapping = ringing;
+			ringing = true;
+			int chime;
+			player.setTriggerTime(ring_time);
+			String file = player.playChimeSound(chime);
+			// If a chime couldn't be mixed over the one ringing, that one just keeps going
+			if (!file.isEmpty() || !overlapping) {
+				leds.AddEventToQueue(LEDRing::Events::BELL_RING_START, chime);
 				hooks.AddEventToQueue(LEDRing::Events::BELL_RING_START, file);
+				// The audio task calls RingFinished() once the sound is done
+				if (file.isEmpty())
+					RingFinished();
 			}
-			// Wait for sound to finish playing
-			do {
-				player.callLoop();
-			} while (player.isPlaying());
-			leds.AddEventToQueue(LEDRing::Events::BELL_RING_END);
-			hooks.AddEventToQueue(LEDRing::Events::BELL_RING_END);
-			ringing = false;
-		} else {
-			// False positive
-			ringing = false;
 		}
+		button_pressed = false;
 	}
+	delay(1);
 }
 
 // put function definitions here:
 
 /// @brief Interrupt service routine for doorbell button pushed 
 void IRAM_ATTR RING_ISR() {
-	if (ringing)
+	if (button_pressed)
 		return;
-	ringing = true;
+	ring_time = micros();
+	button_pressed = true;
+}
+
+/// @brief Called by the audio task when a chime has finished playing
+void RingFinished() {
+	leds.AddEventToQueue(LEDRing::Events::BELL_RING_END);
+	hooks.AddEventToQueue(LEDRing::Events::BELL_RING_END);
+	ringing = false;
 }
\ No newline at end of file
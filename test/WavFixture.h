@@ -0,0 +1,105 @@
+/*
+ * This file is licensed under the GPLv3 License Copyright (c) 2024 Sam Groveman
+ *
+ * Contributors: Sam Groveman
+ */
+
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+/// @brief Sample sounds and WAV files built in memory, shared by the native test suites
+
+/// @brief Appends a little-endian value to a file
+/// @param file The file
+/// @param value The value
+/// @param bytes The size of the value in bytes
+inline void appendLE(std::vector<uint8_t>& file, uint32_t value, int bytes) {
+	for (int i = 0; i < bytes; i++) {
+		file.push_back((value >> (i * 8)) & 0xFF);
+	}
+}
+
+/// @brief Builds a PCM WAV file
+/// @param samples The samples, interleaved by channel, as 16-bit values
+/// @param channels The number of channels
+/// @param sample_rate The sample rate in Hz
+/// @param bits Bits per sample in the file, 8, 16 or 24. 8-bit samples keep the top 8 bits, 24-bit samples add a low byte.
+/// @param extra_chunk True to put an odd-sized chunk before the samples, as tagging tools do
+/// @return The file
+inline std::vector<uint8_t> makeWav(const std::vector<int16_t>& samples, uint16_t channels, uint32_t sample_rate, uint16_t bits, bool extra_chunk = false) {
+	uint32_t data_size = samples.size() * (bits / 8);
+	std::vector<uint8_t> file;
+	file.insert(file.end(), { 'R', 'I', 'F', 'F' });
+	appendLE(file, 0, 4);
+	file.insert(file.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+	appendLE(file, 16, 4);
+	appendLE(file, 1, 2);
+	appendLE(file, channels, 2);
+	appendLE(file, sample_rate, 4);
+	appendLE(file, sample_rate * channels * (bits / 8), 4);
+	appendLE(file, channels * (bits / 8), 2);
+	appendLE(file, bits, 2);
+	if (extra_chunk) {
+		file.insert(file.end(), { 'L', 'I', 'S', 'T' });
+		appendLE(file, 5, 4);
+		file.insert(file.end(), { 'I', 'N', 'F', 'O', 'x', 0 });
+	}
+	file.insert(file.end(), { 'd', 'a', 't', 'a' });
+	appendLE(file, data_size, 4);
+	for (int16_t sample : samples) {
+		if (bits == 8) {
+			file.push_back((uint8_t)((sample >> 8) + 128));
+		} else if (bits == 24) {
+			file.push_back(0x5A);
+			appendLE(file, (uint16_t)sample, 2);
+		} else {
+			appendLE(file, (uint16_t)sample, 2);
+		}
+	}
+	uint32_t riff_size = file.size() - 8;
+	memcpy(file.data() + 4, &riff_size, 4);
+	return file;
+}
+
+/// @brief Makes a sine tone
+/// @param frequency The frequency in Hz
+/// @param amplitude The peak sample value
+/// @param frames The number of frames
+/// @param channels The number of channels, all get the same tone
+/// @param sample_rate The sample rate in Hz
+/// @return The samples, interleaved by channel
+inline std::vector<int16_t> makeTone(double frequency, double amplitude, size_t frames, uint16_t channels, uint32_t sample_rate) {
+	std::vector<int16_t> samples(frames * channels);
+	for (size_t i = 0; i < frames; i++) {
+		int16_t value = lround(amplitude * sin(2 * M_PI * frequency * i / sample_rate));
+		for (uint16_t c = 0; c < channels; c++) {
+			samples[i * channels + c] = value;
+		}
+	}
+	return samples;
+}
+
+/// @brief Makes a chime-like sound: a decaying chord sweeping upwards with a little noise, different on each channel
+/// @param frames The number of frames
+/// @param channels The number of channels
+/// @param sample_rate The sample rate in Hz
+/// @return The samples, interleaved by channel
+inline std::vector<int16_t> makeChime(size_t frames, uint16_t channels, uint32_t sample_rate) {
+	std::vector<int16_t> samples(frames * channels);
+	uint32_t noise = 12345;
+	for (size_t i = 0; i < frames; i++) {
+		double t = (double)i / sample_rate;
+		double decay = exp(-2 * t);
+		for (uint16_t c = 0; c < channels; c++) {
+			double base = 440 + 220 * c + 200 * t;
+			double value = sin(2 * M_PI * base * t) + 0.5 * sin(2 * M_PI * base * 1.5 * t) + 0.25 * sin(2 * M_PI * base * 3 * t);
+			noise = noise * 1103515245 + 12345;
+			value += ((int32_t)(noise >> 16 & 0x7FFF) - 16384) / 16384.0 * 0.02;
+			samples[i * channels + c] = lround(value * decay * 14000);
+		}
+	}
+	return samples;
+}
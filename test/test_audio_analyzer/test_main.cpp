@@ -0,0 +1,109 @@
+#include <Arduino.h>
+#include <AudioAnalyzer.h>
+#include <unity.h>
+#include <chrono>
+#include <vector>
+
+/// @brief Tests the audio analyzer on tones and times its kernel
+
+/// @brief Sample rate of the test tones
+#define ANALYZER_SAMPLE_RATE 44100
+
+/// @brief Seconds of sound fed to the benchmark
+#define ANALYZER_BENCH_SECONDS 60
+
+AudioAnalyzer analyzer;
+
+void setUp() {
+	analyzer.reset();
+}
+
+void tearDown() {}
+
+/// @brief Makes a stereo sine tone
+/// @param frequency The frequency in Hz
+/// @param amplitude The peak sample value
+/// @param frames The number of frames
+/// @return The samples, interleaved by channel
+std::vector<int16_t> tone(double frequency, double amplitude, size_t frames) {
+	std::vector<int16_t> samples(frames * 2);
+	for (size_t i = 0; i < frames; i++) {
+		samples[i * 2] = samples[i * 2 + 1] = lround(amplitude * sin(2 * M_PI * frequency * i / ANALYZER_SAMPLE_RATE));
+	}
+	return samples;
+}
+
+/// @brief Feeds samples to the analyzer
+/// @param samples The samples, interleaved by channel
+void feed(const std::vector<int16_t>& samples) {
+	for (size_t i = 0; i < samples.size(); i += 2) {
+		analyzer.addSample(samples[i], samples[i + 1]);
+	}
+}
+
+void test_silence_is_dark() {
+	feed(std::vector<int16_t>(ANALYZER_SAMPLE_RATE * 2, 0));
+	TEST_ASSERT_EQUAL(0, analyzer.getLevel());
+	TEST_ASSERT_EQUAL(0, analyzer.getBalance());
+}
+
+void test_level_follows_loudness() {
+	feed(tone(1000, 16000, ANALYZER_SAMPLE_RATE / 2));
+	uint8_t loud = analyzer.getLevel();
+	TEST_ASSERT_GREATER_THAN(200, loud);
+	// A quieter passage after the loud one shows as a lower level once the release has settled
+	feed(tone(1000, 4000, ANALYZER_SAMPLE_RATE / 2));
+	uint8_t quiet = analyzer.getLevel();
+	TEST_ASSERT_LESS_THAN(loud / 2, quiet);
+	TEST_ASSERT_GREATER_THAN(0, quiet);
+}
+
+void test_balance_follows_tone() {
+	feed(tone(100, 16000, ANALYZER_SAMPLE_RATE / 2));
+	uint8_t bass = analyzer.getBalance();
+	analyzer.reset();
+	feed(tone(5000, 16000, ANALYZER_SAMPLE_RATE / 2));
+	uint8_t treble = analyzer.getBalance();
+	TEST_ASSERT_LESS_THAN(64, bass);
+	TEST_ASSERT_GREATER_THAN(192, treble);
+}
+
+void test_benchmark() {
+	// Music-like input: a bass line under a melody, so every branch of the envelope followers is taken
+	std::vector<int16_t> samples = tone(110, 8000, ANALYZER_SAMPLE_RATE);
+	std::vector<int16_t> melody = tone(1760, 6000, ANALYZER_SAMPLE_RATE);
+	for (size_t i = 0; i < samples.size(); i++) {
+		samples[i] += melody[i] * (i / 2 % 11025 < 5512);
+	}
+	uint32_t checksum = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int second = 0; second < ANALYZER_BENCH_SECONDS; second++) {
+		feed(samples);
+		checksum += analyzer.getLevel();
+	}
+	double add_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ((double)ANALYZER_SAMPLE_RATE * ANALYZER_BENCH_SECONDS);
+
+	// The LED task reads the analyzer once per frame
+	const int reads = 1000000;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < reads; i++) {
+		checksum += analyzer.getLevel() + analyzer.getBalance();
+	}
+	double read_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / reads;
+	TEST_ASSERT_GREATER_THAN(0, checksum);
+
+	char message[128];
+	snprintf(message, sizeof(message), "addSample: %.2f ns per frame, %.3f%% of a core at %d Hz", add_ns, add_ns * ANALYZER_SAMPLE_RATE / 1e7, ANALYZER_SAMPLE_RATE);
+	TEST_MESSAGE(message);
+	snprintf(message, sizeof(message), "getLevel + getBalance: %.2f ns per LED frame", read_ns);
+	TEST_MESSAGE(message);
+}
+
+int main(int argc, char** argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_silence_is_dark);
+	RUN_TEST(test_level_follows_loudness);
+	RUN_TEST(test_balance_follows_tone);
+	RUN_TEST(test_benchmark);
+	return UNITY_END();
+}
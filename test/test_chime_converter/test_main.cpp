@@ -0,0 +1,194 @@
+#include <ChimeConverter.cpp>
+#include <unity.h>
+#include <math.h>
+#include <vector>
+#include "../WavFixture.h"
+
+/// @brief Converts sample WAV files into PCM and ADPCM chimes, decodes them again and compares them with the source
+
+/// @brief Sample rate of the sample files
+#define CONVERTER_SAMPLE_RATE 22050
+
+/// @brief Length of the sample files, not a whole number of blocks so the last block is padded
+#define CONVERTER_FRAMES (CHIME_BLOCK_FRAMES * 3 + 100)
+
+/// @brief Smallest signal to noise ratio in dB accepted from ADPCM
+#define CONVERTER_MIN_ADPCM_SNR 20
+
+/// @brief Collects a converted chime in memory
+class MemorySink : public ChimeConverter::Sink {
+	public:
+		std::vector<uint8_t> data;
+
+		bool write(const void* bytes, size_t size) {
+			data.insert(data.end(), (const uint8_t*)bytes, (const uint8_t*)bytes + size);
+			return true;
+		}
+
+		bool patch(size_t offset, const void* bytes, size_t size) {
+			if (offset + size > data.size()) {
+				return false;
+			}
+			memcpy(data.data() + offset, bytes, size);
+			return true;
+		}
+};
+
+void setUp() {}
+
+void tearDown() {}
+
+/// @brief Converts a WAV file, fed in chunks as an upload would be
+/// @param wav The WAV file
+/// @param format The encoding, one of ChimeConverter::formats
+/// @param chunk The number of bytes fed at once
+/// @return The chime
+std::vector<uint8_t> convert(const std::vector<uint8_t>& wav, uint16_t format, size_t chunk) {
+	MemorySink sink;
+	ChimeConverter converter(&sink, format);
+	for (size_t offset = 0; offset < wav.size(); offset += chunk) {
+		TEST_ASSERT_TRUE(converter.write(wav.data() + offset, std::min(chunk, wav.size() - offset)));
+	}
+	TEST_ASSERT_TRUE(converter.finish());
+	TEST_ASSERT_FALSE(converter.failed());
+	return sink.data;
+}
+
+/// @brief Decodes a chime as the player does
+/// @param chime The chime
+/// @param header Set to the header of the chime
+/// @return The samples, interleaved by channel
+std::vector<int16_t> decode(const std::vector<uint8_t>& chime, ChimeConverter::chime_header& header) {
+	TEST_ASSERT_GREATER_OR_EQUAL(sizeof(header), chime.size());
+	memcpy(&header, chime.data(), sizeof(header));
+	TEST_ASSERT_EQUAL_UINT32(CHIME_MAGIC, header.magic);
+	TEST_ASSERT_EQUAL(CHIME_VERSION, header.version);
+	TEST_ASSERT_EQUAL(CHIME_BLOCK_FRAMES, header.block_frames);
+	TEST_ASSERT_EQUAL(chime.size() - sizeof(header), header.data_size);
+	const uint8_t* data = chime.data() + sizeof(header);
+	std::vector<int16_t> samples;
+	if (header.format == ChimeConverter::CHIME_PCM) {
+		TEST_ASSERT_EQUAL(header.frame_count * header.channels * sizeof(int16_t), header.data_size);
+		samples.resize(header.frame_count * header.channels);
+		memcpy(samples.data(), data, header.data_size);
+		return samples;
+	}
+	size_t block_bytes = ChimeConverter::blockBytes(header);
+	TEST_ASSERT_EQUAL(0, header.data_size % block_bytes);
+	int16_t frames[CHIME_BLOCK_FRAMES * 2];
+	for (size_t offset = 0; offset < header.data_size; offset += block_bytes) {
+		ChimeConverter::decodeBlock(data + offset, header.channels, frames);
+		samples.insert(samples.end(), frames, frames + CHIME_BLOCK_FRAMES * header.channels);
+	}
+	// The last block is padded
+	TEST_ASSERT_GREATER_OR_EQUAL(header.frame_count * header.channels, samples.size());
+	samples.resize(header.frame_count * header.channels);
+	return samples;
+}
+
+/// @brief Measures how close decoded samples are to the source, for one channel
+/// @param source The source samples
+/// @param decoded The decoded samples
+/// @param channels The number of channels
+/// @param channel The channel to compare
+/// @return The signal to noise ratio in dB
+double snr(const std::vector<int16_t>& source, const std::vector<int16_t>& decoded, uint16_t channels, uint16_t channel) {
+	double signal = 0;
+	double noise = 0;
+	for (size_t i = channel; i < source.size(); i += channels) {
+		double error = (double)decoded[i] - source[i];
+		signal += (double)source[i] * source[i];
+		noise += error * error;
+	}
+	return noise == 0 ? INFINITY : 10 * log10(signal / noise);
+}
+
+void test_pcm_16bit_is_exact() {
+	for (uint16_t channels = 1; channels <= 2; channels++) {
+		std::vector<int16_t> source = makeChime(CONVERTER_FRAMES, channels, CONVERTER_SAMPLE_RATE);
+		ChimeConverter::chime_header header;
+		std::vector<int16_t> decoded = decode(convert(makeWav(source, channels, CONVERTER_SAMPLE_RATE, 16), ChimeConverter::CHIME_PCM, 512), header);
+		TEST_ASSERT_EQUAL(ChimeConverter::CHIME_PCM, header.format);
+		TEST_ASSERT_EQUAL(channels, header.channels);
+		TEST_ASSERT_EQUAL(CONVERTER_SAMPLE_RATE, header.sample_rate);
+		TEST_ASSERT_EQUAL(CONVERTER_FRAMES, header.frame_count);
+		TEST_ASSERT_EQUAL_INT16_ARRAY(source.data(), decoded.data(), source.size());
+	}
+}
+
+void test_pcm_8bit_and_24bit_keep_the_top_bits() {
+	std::vector<int16_t> source = makeChime(CONVERTER_FRAMES, 2, CONVERTER_SAMPLE_RATE);
+	ChimeConverter::chime_header header;
+	std::vector<int16_t> decoded = decode(convert(makeWav(source, 2, CONVERTER_SAMPLE_RATE, 24), ChimeConverter::CHIME_PCM, 512), header);
+	TEST_ASSERT_EQUAL_INT16_ARRAY(source.data(), decoded.data(), source.size());
+
+	decoded = decode(convert(makeWav(source, 2, CONVERTER_SAMPLE_RATE, 8), ChimeConverter::CHIME_PCM, 512), header);
+	TEST_ASSERT_EQUAL(source.size(), decoded.size());
+	for (size_t i = 0; i < source.size(); i++) {
+		TEST_ASSERT_EQUAL((int16_t)(source[i] & 0xFF00), decoded[i]);
+	}
+}
+
+void test_adpcm_is_close() {
+	for (uint16_t channels = 1; channels <= 2; channels++) {
+		std::vector<int16_t> source = makeChime(CONVERTER_FRAMES, channels, CONVERTER_SAMPLE_RATE);
+		std::vector<uint8_t> chime = convert(makeWav(source, channels, CONVERTER_SAMPLE_RATE, 16), ChimeConverter::CHIME_ADPCM, 512);
+		ChimeConverter::chime_header header;
+		std::vector<int16_t> decoded = decode(chime, header);
+		TEST_ASSERT_EQUAL(ChimeConverter::CHIME_ADPCM, header.format);
+		TEST_ASSERT_EQUAL(CONVERTER_FRAMES, header.frame_count);
+		// A quarter of the size of 16-bit PCM, plus a header per block and the padding
+		TEST_ASSERT_EQUAL((CONVERTER_FRAMES / CHIME_BLOCK_FRAMES + 1) * channels * CHIME_ADPCM_BLOCK_BYTES, header.data_size);
+		for (uint16_t c = 0; c < channels; c++) {
+			double ratio = snr(source, decoded, channels, c);
+			char message[64];
+			snprintf(message, sizeof(message), "ADPCM channel %d of %d: %.1f dB SNR", c + 1, channels, ratio);
+			TEST_MESSAGE(message);
+			TEST_ASSERT_GREATER_THAN(CONVERTER_MIN_ADPCM_SNR, ratio);
+		}
+		// Each block starts from an exact sample
+		for (size_t frame = 0; frame < CONVERTER_FRAMES; frame += CHIME_BLOCK_FRAMES) {
+			for (uint16_t c = 0; c < channels; c++) {
+				TEST_ASSERT_EQUAL(source[frame * channels + c], decoded[frame * channels + c]);
+			}
+		}
+	}
+}
+
+void test_chunk_size_does_not_matter() {
+	std::vector<uint8_t> wav = makeWav(makeChime(CHIME_BLOCK_FRAMES + 10, 2, CONVERTER_SAMPLE_RATE), 2, CONVERTER_SAMPLE_RATE, 16, true);
+	for (uint16_t format : { ChimeConverter::CHIME_PCM, ChimeConverter::CHIME_ADPCM }) {
+		std::vector<uint8_t> whole = convert(wav, format, wav.size());
+		TEST_ASSERT_TRUE(whole == convert(wav, format, 1));
+		TEST_ASSERT_TRUE(whole == convert(wav, format, 7));
+	}
+}
+
+void test_invalid_files_fail() {
+	MemorySink sink;
+	ChimeConverter not_wav(&sink, ChimeConverter::CHIME_PCM);
+	const uint8_t mp3[] = "ID3\x04\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+	TEST_ASSERT_FALSE(not_wav.write(mp3, sizeof(mp3)));
+	TEST_ASSERT_TRUE(not_wav.failed());
+
+	// A file cut off before its samples
+	std::vector<uint8_t> wav = makeWav(makeChime(100, 1, CONVERTER_SAMPLE_RATE), 1, CONVERTER_SAMPLE_RATE, 16);
+	ChimeConverter truncated(&sink, ChimeConverter::CHIME_PCM);
+	TEST_ASSERT_TRUE(truncated.write(wav.data(), 30));
+	TEST_ASSERT_FALSE(truncated.finish());
+
+	// Only PCM WAV files can be converted
+	wav[20] = 3;
+	ChimeConverter floats(&sink, ChimeConverter::CHIME_PCM);
+	TEST_ASSERT_FALSE(floats.write(wav.data(), wav.size()));
+}
+
+int main(int argc, char** argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_pcm_16bit_is_exact);
+	RUN_TEST(test_pcm_8bit_and_24bit_keep_the_top_bits);
+	RUN_TEST(test_adpcm_is_close);
+	RUN_TEST(test_chunk_size_does_not_matter);
+	RUN_TEST(test_invalid_files_fail);
+	return UNITY_END();
+}
@@ -0,0 +1,123 @@
+#include <ChimeConverter.cpp>
+#include <unity.h>
+#include <math.h>
+#include <vector>
+#include "../WavFixture.h"
+
+/// @brief Checks the upload-time loudness analysis and normalization gain against reference PCM with a known RMS
+
+/// @brief Sample rate of the reference sounds
+#define NORMALIZATION_SAMPLE_RATE 44100
+
+/// @brief How far the RMS of a normalized sound may be from CHIME_TARGET_RMS, in percent
+#define NORMALIZATION_TOLERANCE 1
+
+/// @brief Ignores the converted chime, only the header is checked
+class NullSink : public ChimeConverter::Sink {
+	public:
+		bool write(const void* data, size_t size) { return true; }
+		bool patch(size_t offset, const void* data, size_t size) { return true; }
+};
+
+void setUp() {}
+
+void tearDown() {}
+
+/// @brief Calculates the normalization gain of a sound, counting every sample
+/// @param samples The samples
+/// @return The gain in 8.8 fixed point
+uint16_t gainOf(const std::vector<int16_t>& samples) {
+	uint64_t energy = 0;
+	int32_t peak = 0;
+	for (int16_t sample : samples) {
+		energy += (int32_t)sample * sample;
+		peak = std::max(peak, abs((int32_t)sample));
+	}
+	return ChimeConverter::normalizationGain(energy, samples.size(), peak);
+}
+
+/// @brief Calculates the RMS of a sound played with a gain, as the mixer applies it
+/// @param samples The samples
+/// @param gain The gain in 8.8 fixed point
+/// @return The RMS
+double rmsWithGain(const std::vector<int16_t>& samples, uint16_t gain) {
+	double energy = 0;
+	for (int16_t sample : samples) {
+		double value = ((int32_t)sample * gain) >> 8;
+		energy += value * value;
+	}
+	return sqrt(energy / samples.size());
+}
+
+/// @brief Converts a sound and gets the gain stored in its header
+/// @param samples The samples
+/// @return The gain in 8.8 fixed point
+uint16_t convertedGain(const std::vector<int16_t>& samples) {
+	NullSink sink;
+	ChimeConverter converter(&sink, ChimeConverter::CHIME_PCM);
+	std::vector<uint8_t> wav = makeWav(samples, 1, NORMALIZATION_SAMPLE_RATE, 16);
+	TEST_ASSERT_TRUE(converter.write(wav.data(), wav.size()));
+	TEST_ASSERT_TRUE(converter.finish());
+	return converter.getHeader().gain;
+}
+
+void test_silence_keeps_unity_gain() {
+	TEST_ASSERT_EQUAL(CHIME_UNITY_GAIN, ChimeConverter::normalizationGain(0, 0, 0));
+	TEST_ASSERT_EQUAL(CHIME_UNITY_GAIN, ChimeConverter::normalizationGain(0, NORMALIZATION_SAMPLE_RATE, 0));
+	TEST_ASSERT_EQUAL(CHIME_UNITY_GAIN, convertedGain(std::vector<int16_t>(NORMALIZATION_SAMPLE_RATE, 0)));
+}
+
+void test_tones_reach_the_target() {
+	// Sines of a known RMS (amplitude / sqrt(2)): 1061, 2063 and 5657, quieter and louder than the target
+	for (double amplitude : { 1500.0, 2917.0, 8000.0 }) {
+		std::vector<int16_t> tone = makeTone(1000, amplitude, NORMALIZATION_SAMPLE_RATE, 1, NORMALIZATION_SAMPLE_RATE);
+		uint16_t gain = gainOf(tone);
+		TEST_ASSERT_UINT_WITHIN(1, lround(CHIME_TARGET_RMS * CHIME_UNITY_GAIN / (amplitude / sqrt(2))), gain);
+		TEST_ASSERT_FLOAT_WITHIN(CHIME_TARGET_RMS * NORMALIZATION_TOLERANCE / 100.0, CHIME_TARGET_RMS, rmsWithGain(tone, gain));
+	}
+}
+
+void test_peak_limits_the_gain() {
+	// A quiet tone with a few loud clicks would clip at the full gain
+	std::vector<int16_t> tone = makeTone(1000, 1414, NORMALIZATION_SAMPLE_RATE, 1, NORMALIZATION_SAMPLE_RATE);
+	for (size_t i = 0; i < tone.size(); i += NORMALIZATION_SAMPLE_RATE / 4) {
+		tone[i] = 30000;
+	}
+	uint16_t gain = gainOf(tone);
+	TEST_ASSERT_EQUAL(32767 * CHIME_UNITY_GAIN / 30000, gain);
+	TEST_ASSERT_LESS_OR_EQUAL(32767, 30000 * gain >> 8);
+}
+
+void test_gain_is_clamped() {
+	// Would need about 20 times louder
+	std::vector<int16_t> faint = makeTone(1000, 283, NORMALIZATION_SAMPLE_RATE, 1, NORMALIZATION_SAMPLE_RATE);
+	TEST_ASSERT_EQUAL(CHIME_MAX_GAIN, gainOf(faint));
+	// A full scale square wave would need about 8 times quieter
+	std::vector<int16_t> square(NORMALIZATION_SAMPLE_RATE);
+	for (size_t i = 0; i < square.size(); i++) {
+		square[i] = i / 50 % 2 ? 32767 : -32767;
+	}
+	TEST_ASSERT_EQUAL(CHIME_MIN_GAIN, gainOf(square));
+}
+
+void test_silence_is_left_out_of_the_loudness() {
+	std::vector<int16_t> tone = makeTone(1000, 2917, CHIME_BLOCK_FRAMES * 20, 1, NORMALIZATION_SAMPLE_RATE);
+	uint16_t gain = convertedGain(tone);
+	TEST_ASSERT_UINT_WITHIN(1, 512, gain);
+
+	// Whole blocks of near silence, below the gate, before and after the tone
+	std::vector<int16_t> padded = makeTone(1000, 20, CHIME_BLOCK_FRAMES * 20, 1, NORMALIZATION_SAMPLE_RATE);
+	padded.insert(padded.end(), tone.begin(), tone.end());
+	padded.insert(padded.end(), CHIME_BLOCK_FRAMES * 40, 0);
+	TEST_ASSERT_EQUAL(gain, convertedGain(padded));
+}
+
+int main(int argc, char** argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_silence_keeps_unity_gain);
+	RUN_TEST(test_tones_reach_the_target);
+	RUN_TEST(test_peak_limits_the_gain);
+	RUN_TEST(test_gain_is_clamped);
+	RUN_TEST(test_silence_is_left_out_of_the_loudness);
+	return UNITY_END();
+}
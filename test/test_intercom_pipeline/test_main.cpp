@@ -0,0 +1,183 @@
+#include <ChimeConverter.cpp>
+#include <SampleRing.cpp>
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+#include "../WavFixture.h"
+
+/// @brief Feeds a WAV file through the intercom's capture pipeline, the ring buffer and the ADPCM encoder, and measures its throughput.
+/// Uses a generated recording, or the 16-bit mono WAV file named by the INTERCOM_BENCH_WAV environment variable.
+
+/// @brief The pipeline settings of Intercom.h
+#define PIPELINE_SAMPLE_RATE 16000
+#define PIPELINE_READ_SAMPLES 256
+#define PIPELINE_BLOCK_SAMPLES 505
+#define PIPELINE_BLOCK_BYTES (4 + (PIPELINE_BLOCK_SAMPLES - 1) / 2)
+#define PIPELINE_RING_SAMPLES 4096
+
+/// @brief Seconds of generated recording, a two second chime over and over
+#define PIPELINE_SECONDS 120
+
+/// @brief The samples of the recording
+std::vector<int16_t> recording;
+
+void setUp() {}
+
+void tearDown() {}
+
+/// @brief Finds the samples of a 16-bit mono WAV file
+/// @param wav The file
+/// @param samples Set to the samples
+/// @return True if the file is a 16-bit mono WAV file
+bool readWav(const std::vector<uint8_t>& wav, std::vector<int16_t>& samples) {
+	if (wav.size() < 12 || memcmp(wav.data(), "RIFF", 4) != 0 || memcmp(wav.data() + 8, "WAVE", 4) != 0) {
+		return false;
+	}
+	bool mono16 = false;
+	for (size_t offset = 12; offset + 8 <= wav.size();) {
+		uint32_t size = readLE32(wav.data() + offset + 4);
+		const uint8_t* chunk = wav.data() + offset + 8;
+		if (memcmp(wav.data() + offset, "fmt ", 4) == 0) {
+			mono16 = readLE16(chunk) == 1 && readLE16(chunk + 2) == 1 && readLE16(chunk + 14) == 16;
+		} else if (memcmp(wav.data() + offset, "data", 4) == 0 && mono16) {
+			size = std::min((size_t)size, wav.size() - offset - 8);
+			samples.resize(size / 2);
+			memcpy(samples.data(), chunk, samples.size() * 2);
+			return true;
+		}
+		offset += 8 + size + (size & 1);
+	}
+	return false;
+}
+
+/// @brief Loads the recording once
+void loadRecording() {
+	if (!recording.empty()) {
+		return;
+	}
+	std::vector<uint8_t> wav;
+	const char* path = getenv("INTERCOM_BENCH_WAV");
+	if (path != NULL) {
+		FILE* file = fopen(path, "rb");
+		TEST_ASSERT_NOT_NULL(file);
+		uint8_t chunk[4096];
+		size_t count;
+		while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+			wav.insert(wav.end(), chunk, chunk + count);
+		}
+		fclose(file);
+	} else {
+		std::vector<int16_t> chime = makeChime(PIPELINE_SAMPLE_RATE * 2, 1, PIPELINE_SAMPLE_RATE);
+		std::vector<int16_t> samples;
+		for (int i = 0; i < PIPELINE_SECONDS / 2; i++) {
+			samples.insert(samples.end(), chime.begin(), chime.end());
+		}
+		wav = makeWav(samples, 1, PIPELINE_SAMPLE_RATE, 16);
+	}
+	TEST_ASSERT_TRUE_MESSAGE(readWav(wav, recording), "Not a 16-bit mono WAV file");
+	TEST_ASSERT_GREATER_OR_EQUAL(PIPELINE_BLOCK_SAMPLES, recording.size());
+}
+
+/// @brief Runs the pipeline in one thread, as reads and encodes take turns on the device
+/// @param blocks Receives the encoded blocks
+/// @param most_queued Set to the most samples waiting in the ring
+/// @return The time taken in nanoseconds
+double runSerial(std::vector<uint8_t>& blocks, size_t& most_queued) {
+	SampleRing ring(PIPELINE_RING_SAMPLES);
+	int16_t samples[PIPELINE_BLOCK_SAMPLES];
+	uint8_t block[PIPELINE_BLOCK_BYTES];
+	int32_t index = 0;
+	most_queued = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t offset = 0; offset < recording.size(); offset += PIPELINE_READ_SAMPLES) {
+		size_t count = std::min((size_t)PIPELINE_READ_SAMPLES, recording.size() - offset);
+		TEST_ASSERT_EQUAL(count, ring.write(recording.data() + offset, count));
+		most_queued = std::max(most_queued, ring.available());
+		while (ring.available() >= PIPELINE_BLOCK_SAMPLES) {
+			ring.read(samples, PIPELINE_BLOCK_SAMPLES);
+			ChimeConverter::encodeAdpcm(samples, PIPELINE_BLOCK_SAMPLES, 1, index, block);
+			blocks.insert(blocks.end(), block, block + PIPELINE_BLOCK_BYTES);
+		}
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+void test_ring_is_lossless_across_threads() {
+	loadRecording();
+	std::vector<uint8_t> expected;
+	size_t most_queued;
+	runSerial(expected, most_queued);
+	TEST_ASSERT_EQUAL(recording.size() / PIPELINE_BLOCK_SAMPLES * PIPELINE_BLOCK_BYTES, expected.size());
+
+	// The capture and stream tasks run on different cores on the device
+	SampleRing ring(PIPELINE_RING_SAMPLES);
+	std::thread capture([&]() {
+		for (size_t offset = 0; offset < recording.size();) {
+			size_t count = std::min((size_t)PIPELINE_READ_SAMPLES, recording.size() - offset);
+			offset += ring.write(recording.data() + offset, count);
+		}
+	});
+	std::vector<uint8_t> blocks;
+	int16_t samples[PIPELINE_BLOCK_SAMPLES];
+	uint8_t block[PIPELINE_BLOCK_BYTES];
+	int32_t index = 0;
+	for (size_t encoded = 0; encoded + PIPELINE_BLOCK_SAMPLES <= recording.size();) {
+		if (ring.available() < PIPELINE_BLOCK_SAMPLES) {
+			std::this_thread::yield();
+			continue;
+		}
+		encoded += ring.read(samples, PIPELINE_BLOCK_SAMPLES);
+		ChimeConverter::encodeAdpcm(samples, PIPELINE_BLOCK_SAMPLES, 1, index, block);
+		blocks.insert(blocks.end(), block, block + PIPELINE_BLOCK_BYTES);
+	}
+	capture.join();
+	TEST_ASSERT_TRUE(blocks == expected);
+}
+
+void test_ring_drops_what_does_not_fit() {
+	SampleRing ring(3000);
+	TEST_ASSERT_EQUAL(PIPELINE_RING_SAMPLES, ring.getCapacity());
+	std::vector<int16_t> samples(PIPELINE_RING_SAMPLES + 100, 1);
+	TEST_ASSERT_EQUAL(PIPELINE_RING_SAMPLES, ring.write(samples.data(), samples.size()));
+	TEST_ASSERT_EQUAL(100, ring.skip(100));
+	TEST_ASSERT_EQUAL(PIPELINE_RING_SAMPLES - 100, ring.available());
+}
+
+void test_benchmark() {
+	loadRecording();
+	std::vector<uint8_t> blocks;
+	blocks.reserve(recording.size() / PIPELINE_BLOCK_SAMPLES * PIPELINE_BLOCK_BYTES);
+	size_t most_queued;
+	double pipeline_ns = runSerial(blocks, most_queued);
+
+	// The ring alone, to separate its cost from the encoder's
+	SampleRing ring(PIPELINE_RING_SAMPLES);
+	int16_t samples[PIPELINE_READ_SAMPLES];
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t offset = 0; offset + PIPELINE_READ_SAMPLES <= recording.size(); offset += PIPELINE_READ_SAMPLES) {
+		ring.write(recording.data() + offset, PIPELINE_READ_SAMPLES);
+		ring.read(samples, PIPELINE_READ_SAMPLES);
+	}
+	double ring_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	TEST_ASSERT_EQUAL(0, ring.available());
+
+	double seconds = (double)recording.size() / PIPELINE_SAMPLE_RATE;
+	char message[160];
+	snprintf(message, sizeof(message), "%.0f s of audio: %.2f ns per sample through ring and encoder, %.0fx real time", seconds, pipeline_ns / recording.size(), seconds * 1e9 / pipeline_ns);
+	TEST_MESSAGE(message);
+	snprintf(message, sizeof(message), "Ring write + read: %.2f ns per sample, encoder: %.2f ns per sample", ring_ns / recording.size(), (pipeline_ns - ring_ns) / recording.size());
+	TEST_MESSAGE(message);
+	snprintf(message, sizeof(message), "Most samples queued: %d (%.1f ms), %d bytes of ADPCM per second", (int)most_queued, most_queued * 1000.0 / PIPELINE_SAMPLE_RATE, (int)(blocks.size() / seconds));
+	TEST_MESSAGE(message);
+}
+
+int main(int argc, char** argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_ring_is_lossless_across_threads);
+	RUN_TEST(test_ring_drops_what_does_not_fit);
+	RUN_TEST(test_benchmark);
+	return UNITY_END();
+}
@@ -0,0 +1,138 @@
+#include <Arduino.h>
+#include <Storage.h>
+#include <unity.h>
+#include <chrono>
+#include <filesystem>
+
+/// @brief Compares the allocations and time of reading 10 KB, 100 KB and 1 MB files before and after readFile() was sized from the file
+
+/// @brief Number of times each read is timed
+#define READ_BENCH_RUNS 5
+
+/// @brief Most allocations a read may make, the same for every size: the log and path Strings, opening the file and one buffer
+#define READ_MAX_ALLOCATIONS 24
+
+/// @brief Number of allocations made so far, only counted with glibc
+static size_t allocations = 0;
+
+#ifdef __GLIBC__
+extern "C" {
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* ptr, size_t size);
+
+	void* malloc(size_t size) {
+		allocations++;
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t count, size_t size) {
+		allocations++;
+		return __libc_calloc(count, size);
+	}
+
+	void* realloc(void* ptr, size_t size) {
+		allocations++;
+		return __libc_realloc(ptr, size);
+	}
+}
+#endif
+
+Storage storage;
+
+void setUp() {
+	std::filesystem::remove_all(STORAGE_POSIX_ROOT);
+	std::filesystem::create_directories(STORAGE_POSIX_ROOT);
+	TEST_ASSERT_TRUE(storage.begin());
+}
+
+void tearDown() {}
+
+/// @brief readFile() as it was, appending what readString() returns
+/// @param path The path of the file to read
+/// @return The contents of the file
+String legacyReadFile(String path) {
+	File file = storage.openFile(path);
+	String output;
+	// The ESP32 core also waits the Stream timeout, a second, at the end of the file. That's left out to compare the copies.
+	file.setTimeout(0);
+	while (file.available()) {
+		output += file.readString();
+	}
+	file.close();
+	return output;
+}
+
+/// @brief The result of timing a read
+struct result {
+	/// @brief Mean allocations per read
+	size_t allocations;
+
+	/// @brief Mean time per read in microseconds
+	double micros;
+};
+
+/// @brief Times a read and counts its allocations
+/// @param read The read, returns the number of bytes read
+/// @param size The size of the file
+/// @return The mean allocations and time per read
+template <typename T> result measure(T read, size_t size) {
+	size_t before = allocations;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < READ_BENCH_RUNS; i++) {
+		TEST_ASSERT_EQUAL(size, read());
+	}
+	double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	return { (allocations - before) / READ_BENCH_RUNS, elapsed / READ_BENCH_RUNS };
+}
+
+/// @brief Compares the reads on one file size
+/// @param size The size of the file in bytes
+void compare(size_t size) {
+	String content;
+	content.reserve(size);
+	for (size_t i = 0; i < size; i++) {
+		content += (char)('a' + i % 26);
+	}
+	String path = "/file-" + String((unsigned long)size);
+	TEST_ASSERT_TRUE(storage.writeFile(path, content));
+	TEST_ASSERT_TRUE(legacyReadFile(path) == content);
+	TEST_ASSERT_TRUE(storage.readFile(path) == content);
+
+	result before = measure([&]() { return legacyReadFile(path).length(); }, size);
+	result string = measure([&]() { return storage.readFile(path).length(); }, size);
+	result buffer = measure([&]() {
+		Storage::file_buffer file;
+		return storage.readFile(path, file) ? file.size : 0;
+	}, size);
+
+	char message[160];
+	snprintf(message, sizeof(message), "%7lu bytes, before: %8lu allocations %10.1f us | String: %3lu allocations %8.1f us | file_buffer: %3lu allocations %8.1f us",
+		(unsigned long)size, (unsigned long)before.allocations, before.micros, (unsigned long)string.allocations, string.micros, (unsigned long)buffer.allocations, buffer.micros);
+	TEST_MESSAGE(message);
+#ifdef __GLIBC__
+	TEST_ASSERT_GREATER_THAN(size / 2, before.allocations);
+	TEST_ASSERT_LESS_OR_EQUAL(READ_MAX_ALLOCATIONS, string.allocations);
+	TEST_ASSERT_LESS_OR_EQUAL(READ_MAX_ALLOCATIONS, buffer.allocations);
+#endif
+}
+
+void test_10kb() {
+	compare(10 * 1024);
+}
+
+void test_100kb() {
+	compare(100 * 1024);
+}
+
+void test_1mb() {
+	compare(1024 * 1024);
+}
+
+int main(int argc, char** argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_10kb);
+	RUN_TEST(test_100kb);
+	RUN_TEST(test_1mb);
+	return UNITY_END();
+}
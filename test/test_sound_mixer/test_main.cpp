@@ -0,0 +1,156 @@
+#include <Arduino.h>
+#include <SoundMixer.cpp>
+#include <unity.h>
+#include <chrono>
+#include <vector>
+#include "../WavFixture.h"
+
+/// @brief Tests the mixer and measures the CPU cost of each voice at the output sample rate
+
+/// @brief Output sample rate of the benchmark
+#define MIXER_SAMPLE_RATE 44100
+
+/// @brief Seconds of output mixed for each benchmark case
+#define MIXER_BENCH_SECONDS 20
+
+/// @brief Plays samples from memory, looping them until a number of frames has been read
+class FixedSource : public SoundSource {
+	public:
+		FixedSource(const std::vector<int16_t>& Samples, uint16_t Channels, uint32_t Rate, size_t Frames) : samples(Samples), channels(Channels), rate(Rate), left(Frames) {}
+		uint32_t getSampleRate() { return rate; }
+		uint16_t getChannels() { return channels; }
+
+		size_t read(int16_t* frames) {
+			size_t count = std::min(left, (size_t)SOUND_SOURCE_FRAMES);
+			for (size_t f = 0; f < count; f++) {
+				for (uint16_t c = 0; c < channels; c++) {
+					frames[f * channels + c] = samples[position * channels + c];
+				}
+				position = (position + 1) % (samples.size() / channels);
+			}
+			left -= count;
+			return count;
+		}
+
+	private:
+		/// @brief The samples, interleaved by channel
+		const std::vector<int16_t>& samples;
+
+		/// @brief Number of channels of the samples
+		uint16_t channels;
+
+		/// @brief Sample rate of the samples
+		uint32_t rate;
+
+		/// @brief Frames still to be read
+		size_t left;
+
+		/// @brief Next frame of samples to read
+		size_t position = 0;
+};
+
+/// @brief One second of a chime at the output rate, in stereo
+std::vector<int16_t> stereo = makeChime(MIXER_SAMPLE_RATE, 2, MIXER_SAMPLE_RATE);
+
+/// @brief One second of a chime at half the output rate, in mono, so it's resampled
+std::vector<int16_t> mono = makeChime(MIXER_SAMPLE_RATE / 2, 1, MIXER_SAMPLE_RATE / 2);
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_single_voice_is_unchanged() {
+	SoundMixer mixer;
+	TEST_ASSERT_EQUAL(0, mixer.addVoice(new FixedSource(stereo, 2, MIXER_SAMPLE_RATE, SOUND_MIXER_FRAMES * 4), CHIME_UNITY_GAIN, false));
+	int16_t output[SOUND_MIXER_FRAMES * 2];
+	// The first mix fades the voice in
+	TEST_ASSERT_EQUAL(SOUND_MIXER_FRAMES, mixer.mix(output));
+	TEST_ASSERT_EQUAL(SOUND_MIXER_FRAMES, mixer.mix(output));
+	TEST_ASSERT_EQUAL_INT16_ARRAY(stereo.data() + SOUND_MIXER_FRAMES * 2, output, SOUND_MIXER_FRAMES * 2);
+	TEST_ASSERT_EQUAL(SOUND_MIXER_FRAMES, mixer.mix(output));
+	// The voice ends part way through the last mix and is removed
+	TEST_ASSERT_EQUAL(SOUND_MIXER_FRAMES, mixer.mix(output));
+	TEST_ASSERT_FALSE(mixer.isActive());
+	TEST_ASSERT_EQUAL(0, mixer.mix(output));
+}
+
+void test_ducking_lowers_other_voices() {
+	SoundMixer mixer;
+	std::vector<int16_t> tone = makeTone(1000, 8000, MIXER_SAMPLE_RATE, 2, MIXER_SAMPLE_RATE);
+	std::vector<int16_t> silence(MIXER_SAMPLE_RATE * 2, 0);
+	mixer.addVoice(new FixedSource(tone, 2, MIXER_SAMPLE_RATE, MIXER_SAMPLE_RATE), CHIME_UNITY_GAIN, false);
+	mixer.addVoice(new FixedSource(silence, 2, MIXER_SAMPLE_RATE, MIXER_SAMPLE_RATE), CHIME_UNITY_GAIN, true);
+	int16_t output[SOUND_MIXER_FRAMES * 2];
+	mixer.mix(output);
+	mixer.mix(output);
+	int16_t peak = 0;
+	for (int16_t sample : output) {
+		peak = std::max(peak, sample);
+	}
+	TEST_ASSERT_INT_WITHIN(8000 / 64, 8000 * SOUND_MIXER_DUCK_GAIN / CHIME_UNITY_GAIN, peak);
+	mixer.stopAll();
+	TEST_ASSERT_FALSE(mixer.isActive());
+}
+
+void test_sum_saturates() {
+	SoundMixer mixer;
+	std::vector<int16_t> full(SOUND_MIXER_FRAMES * 2, 30000);
+	for (int i = 0; i < SOUND_MIXER_VOICES; i++) {
+		TEST_ASSERT_EQUAL(i, mixer.addVoice(new FixedSource(full, 2, MIXER_SAMPLE_RATE, MIXER_SAMPLE_RATE), CHIME_MAX_GAIN, false));
+	}
+	TEST_ASSERT_FALSE(mixer.hasFreeVoice());
+	int16_t output[SOUND_MIXER_FRAMES * 2];
+	mixer.mix(output);
+	mixer.mix(output);
+	for (int16_t sample : output) {
+		TEST_ASSERT_EQUAL(32767, sample);
+	}
+}
+
+/// @brief Mixes voices for MIXER_BENCH_SECONDS and prints the time per voice per output frame
+/// @param name The name of the case
+/// @param voices The number of voices
+/// @param resampled True to play the voices from mono at half the output rate
+void bench(const char* name, int voices, bool resampled) {
+	SoundMixer mixer;
+	size_t frames = MIXER_SAMPLE_RATE * MIXER_BENCH_SECONDS;
+	// The first voice sets the output rate, so it's always at the output rate
+	mixer.addVoice(new FixedSource(stereo, 2, MIXER_SAMPLE_RATE, frames + SOUND_MIXER_FRAMES), CHIME_UNITY_GAIN / 2, false);
+	for (int i = 1; i < voices; i++) {
+		if (resampled) {
+			mixer.addVoice(new FixedSource(mono, 1, MIXER_SAMPLE_RATE / 2, frames / 2 + SOUND_MIXER_FRAMES), CHIME_UNITY_GAIN / 2, false);
+		} else {
+			mixer.addVoice(new FixedSource(stereo, 2, MIXER_SAMPLE_RATE, frames + SOUND_MIXER_FRAMES), CHIME_UNITY_GAIN / 2, false);
+		}
+	}
+	int16_t output[SOUND_MIXER_FRAMES * 2];
+	int64_t checksum = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t mixed = 0; mixed < frames; mixed += SOUND_MIXER_FRAMES) {
+		TEST_ASSERT_EQUAL(SOUND_MIXER_FRAMES, mixer.mix(output));
+		checksum += output[0];
+	}
+	double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	double per_voice = elapsed / frames / voices;
+	char message[160];
+	snprintf(message, sizeof(message), "%-22s %6.2f ns per voice per frame, %.3f%% of a core per voice at %d Hz (checksum %lld)", name, per_voice, per_voice * MIXER_SAMPLE_RATE / 1e7, MIXER_SAMPLE_RATE, (long long)checksum);
+	TEST_MESSAGE(message);
+	mixer.stopAll();
+}
+
+void test_benchmark() {
+	bench("1 voice", 1, false);
+	bench("2 voices", 2, false);
+	bench("3 voices", 3, false);
+	bench("4 voices", 4, false);
+	bench("4 voices, 3 resampled", 4, true);
+}
+
+int main(int argc, char** argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_single_voice_is_unchanged);
+	RUN_TEST(test_ducking_lowers_other_voices);
+	RUN_TEST(test_sum_saturates);
+	RUN_TEST(test_benchmark);
+	return UNITY_END();
+}
@@ -0,0 +1,164 @@
+#include <Arduino.h>
+#include <Storage.h>
+#include <unity.h>
+#include <chrono>
+#include <filesystem>
+
+/// @brief Tests the storage layer on the POSIX backend, in STORAGE_POSIX_ROOT, and times each operation
+
+/// @brief Number of times each operation is timed
+#define STORAGE_BENCH_RUNS 1000
+
+Storage storage;
+
+void setUp() {
+	std::filesystem::remove_all(STORAGE_POSIX_ROOT);
+	std::filesystem::create_directories(STORAGE_POSIX_ROOT);
+	TEST_ASSERT_TRUE(storage.begin());
+}
+
+void tearDown() {}
+
+void test_write_and_read() {
+	TEST_ASSERT_TRUE(storage.writeFile("/settings.json", "{\"volume\":10}"));
+	TEST_ASSERT_TRUE(storage.fileExists("/settings.json"));
+	TEST_ASSERT_EQUAL_STRING("{\"volume\":10}", storage.readFile("/settings.json").c_str());
+
+	Storage::file_buffer buffer;
+	TEST_ASSERT_TRUE(storage.readFile("/settings.json", buffer));
+	TEST_ASSERT_EQUAL(13, buffer.size);
+	TEST_ASSERT_EQUAL_STRING("{\"volume\":10}", buffer.data.get());
+
+	size_t size;
+	time_t last_write;
+	TEST_ASSERT_TRUE(storage.getFileInfo("/settings.json", size, last_write));
+	TEST_ASSERT_EQUAL(13, size);
+	TEST_ASSERT_GREATER_THAN(0, last_write);
+}
+
+void test_append() {
+	TEST_ASSERT_TRUE(storage.writeFile("/journal", "one\n"));
+	TEST_ASSERT_TRUE(storage.appendFile("/journal", "two\n"));
+	TEST_ASSERT_EQUAL_STRING("one\ntwo\n", storage.readFile("/journal").c_str());
+	TEST_ASSERT_TRUE(storage.writeFile("/journal", "three\n"));
+	TEST_ASSERT_EQUAL_STRING("three\n", storage.readFile("/journal").c_str());
+}
+
+void test_missing_file() {
+	TEST_ASSERT_FALSE(storage.fileExists("/missing"));
+	TEST_ASSERT_EQUAL_STRING("", storage.readFile("/missing").c_str());
+	Storage::file_buffer buffer;
+	TEST_ASSERT_FALSE(storage.readFile("/missing", buffer));
+	TEST_ASSERT_FALSE(storage.openFile("/missing"));
+	size_t size;
+	time_t last_write;
+	TEST_ASSERT_FALSE(storage.getFileInfo("/missing", size, last_write));
+}
+
+void test_directories() {
+	TEST_ASSERT_TRUE(storage.createDir("/chimes"));
+	TEST_ASSERT_TRUE(storage.writeFile("/chimes/a.mp3", "a"));
+	TEST_ASSERT_TRUE(storage.writeFile("/chimes/b.mp3", "bb"));
+	TEST_ASSERT_TRUE(storage.createDir("/chimes/nested"));
+	std::vector<String> files = storage.listDir("/chimes", 0);
+	std::sort(files.begin(), files.end());
+	TEST_ASSERT_EQUAL(2, files.size());
+	TEST_ASSERT_EQUAL_STRING("/chimes/a.mp3", files[0].c_str());
+	TEST_ASSERT_EQUAL_STRING("/chimes/b.mp3", files[1].c_str());
+
+	File dir = storage.openFile("/chimes");
+	TEST_ASSERT_TRUE(dir.isDirectory());
+	File file = dir.openNextFile();
+	TEST_ASSERT_TRUE(file);
+	TEST_ASSERT_TRUE(String(file.path()).startsWith("/chimes/"));
+	TEST_ASSERT_EQUAL_STRING(String(file.path()).substring(8).c_str(), file.name());
+
+	// A directory with files in it isn't removed
+	TEST_ASSERT_FALSE(storage.removeDir("/chimes"));
+	TEST_ASSERT_TRUE(storage.removeDir("/chimes/nested"));
+	TEST_ASSERT_TRUE(storage.deleteFile("/chimes/a.mp3"));
+	TEST_ASSERT_TRUE(storage.deleteFile("/chimes/b.mp3"));
+	TEST_ASSERT_TRUE(storage.removeDir("/chimes"));
+	TEST_ASSERT_FALSE(storage.fileExists("/chimes"));
+}
+
+void test_rename() {
+	TEST_ASSERT_TRUE(storage.writeFile("/upload.tmp", "chime"));
+	TEST_ASSERT_TRUE(storage.renameFile("/upload.tmp", "/chime.mp3"));
+	TEST_ASSERT_FALSE(storage.fileExists("/upload.tmp"));
+	TEST_ASSERT_EQUAL_STRING("chime", storage.readFile("/chime.mp3").c_str());
+	TEST_ASSERT_FALSE(storage.deleteFile("/upload.tmp"));
+}
+
+void test_open_and_seek() {
+	File file = storage.openFile("/data.bin", FILE_WRITE);
+	TEST_ASSERT_TRUE(file);
+	const uint8_t data[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	TEST_ASSERT_EQUAL(sizeof(data), file.write(data, sizeof(data)));
+	TEST_ASSERT_EQUAL(sizeof(data), file.size());
+	file.close();
+
+	file = storage.openFile("/data.bin");
+	TEST_ASSERT_EQUAL(8, file.available());
+	TEST_ASSERT_TRUE(file.seek(6));
+	TEST_ASSERT_EQUAL(7, file.peek());
+	TEST_ASSERT_EQUAL(7, file.read());
+	TEST_ASSERT_EQUAL(1, file.available());
+	TEST_ASSERT_TRUE(file.seek(2, SeekCur));
+	TEST_ASSERT_EQUAL(-1, file.read());
+	TEST_ASSERT_TRUE(file.seek(0, SeekEnd));
+	TEST_ASSERT_EQUAL(8, file.position());
+	TEST_ASSERT_TRUE(file.seek(5));
+	uint8_t tail[3];
+	TEST_ASSERT_EQUAL(3, file.read(tail, sizeof(tail)));
+	TEST_ASSERT_EQUAL_MEMORY(data + 5, tail, sizeof(tail));
+	file.close();
+	TEST_ASSERT_FALSE(file);
+}
+
+/// @brief Times an operation and prints the mean time per call
+/// @param name The name of the operation
+/// @param operation The operation, returns true on success
+template <typename T> void bench(const char* name, T operation) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < STORAGE_BENCH_RUNS; i++) {
+		TEST_ASSERT_TRUE(operation());
+	}
+	double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	char message[96];
+	snprintf(message, sizeof(message), "%-20s %8.2f us per call", name, elapsed / STORAGE_BENCH_RUNS);
+	TEST_MESSAGE(message);
+}
+
+void test_benchmark() {
+	String content;
+	for (int i = 0; i < 4096; i++) {
+		content += (char)('a' + i % 26);
+	}
+	TEST_ASSERT_TRUE(storage.createDir("/bench"));
+	for (int i = 0; i < 16; i++) {
+		TEST_ASSERT_TRUE(storage.writeFile("/bench/" + String(i), content));
+	}
+	size_t size;
+	time_t last_write;
+	Storage::file_buffer buffer;
+	bench("writeFile 4KB", [&]() { return storage.writeFile("/bench.txt", content); });
+	bench("appendFile 16B", [&]() { return storage.appendFile("/journal", "0123456789abcdef"); });
+	bench("fileExists", [&]() { return storage.fileExists("/bench.txt"); });
+	bench("getFileInfo", [&]() { return storage.getFileInfo("/bench.txt", size, last_write); });
+	bench("readFile 4KB String", [&]() { return storage.readFile("/bench.txt").length() == 4096; });
+	bench("readFile 4KB buffer", [&]() { return storage.readFile("/bench.txt", buffer) && buffer.size == 4096; });
+	bench("listDir 16 files", [&]() { return storage.listDir("/bench", 0).size() == 16; });
+}
+
+int main(int argc, char** argv) {
+	UNITY_BEGIN();
+	RUN_TEST(test_write_and_read);
+	RUN_TEST(test_append);
+	RUN_TEST(test_missing_file);
+	RUN_TEST(test_directories);
+	RUN_TEST(test_rename);
+	RUN_TEST(test_open_and_seek);
+	RUN_TEST(test_benchmark);
+	return UNITY_END();
+}
@@ -0,0 +1,100 @@
+// IMA ADPCM step sizes, the same as the doorbell's encoder
+const adpcm_steps = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+];
+const adpcm_index_changes = [-1, -1, -1, -1, 2, 4, 6, 8];
+
+// Audio waiting to be played is kept between these many seconds, so the delay stays short
+const min_buffer = 0.05;
+const max_buffer = 0.25;
+
+var socket = null;
+var context = null;
+var sample_rate = 16000;
+var next_time = 0;
+
+document.addEventListener("DOMContentLoaded", () => {
+    document.getElementById("listen").onclick = function () {
+        if (socket == null)
+            startListening();
+        else
+            stopListening();
+    };
+});
+
+function startListening() {
+    socket = new WebSocket("ws://" + location.host + "/intercom");
+    socket.binaryType = "arraybuffer";
+    socket.onmessage = function (event) {
+        if (typeof event.data === "string") {
+            // The first message describes the stream
+            sample_rate = JSON.parse(event.data).sampleRate;
+            // Created here, since browsers only allow audio after a click
+            context = new AudioContext({ sampleRate: sample_rate });
+            next_time = 0;
+        } else if (context != null) {
+            playBlock(decodeBlock(new Uint8Array(event.data)));
+        }
+    };
+    socket.onopen = function () {
+        document.getElementById("message").innerHTML = "Listening";
+        document.getElementById("listen").innerHTML = "Stop";
+    };
+    socket.onclose = function () {
+        document.getElementById("message").innerHTML = "Not listening";
+        document.getElementById("listen").innerHTML = "Listen";
+        if (context != null)
+            context.close();
+        context = null;
+        socket = null;
+    };
+}
+
+function stopListening() {
+    socket.close();
+}
+
+// Decodes an IMA ADPCM block: the first sample and step index, then two samples per byte
+function decodeBlock(block) {
+    let samples = new Float32Array(1 + (block.length - 4) * 2);
+    let predictor = (block[0] | (block[1] << 8)) << 16 >> 16;
+    let index = Math.min(block[2], 88);
+    samples[0] = predictor / 32768;
+    for (let i = 1; i < samples.length; i++) {
+        let code = (i - 1) & 1 ? block[4 + ((i - 1) >> 1)] >> 4 : block[4 + ((i - 1) >> 1)] & 0x0F;
+        let step = adpcm_steps[index];
+        let diff = step >> 3;
+        if (code & 4)
+            diff += step;
+        if (code & 2)
+            diff += step >> 1;
+        if (code & 1)
+            diff += step >> 2;
+        predictor = Math.max(-32768, Math.min(32767, predictor + (code & 8 ? -diff : diff)));
+        index = Math.max(0, Math.min(88, index + adpcm_index_changes[code & 7]));
+        samples[i] = predictor / 32768;
+    }
+    return samples;
+}
+
+// Plays a block right after the previous one, skipping it if too much is already waiting
+function playBlock(samples) {
+    let now = context.currentTime;
+    if (next_time < now + 0.005) {
+        // Ran dry, build up a little audio again
+        next_time = now + min_buffer;
+    } else if (next_time > now + max_buffer) {
+        return;
+    }
+    let buffer = context.createBuffer(1, samples.length, sample_rate);
+    buffer.copyToChannel(samples, 0);
+    let source = context.createBufferSource();
+    source.buffer = buffer;
+    source.connect(context.destination);
+    source.start(next_time);
+    next_time += buffer.duration;
+}
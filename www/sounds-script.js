@@ -1,9 +1,18 @@
 var vol_slider;
 var vol_display;
+var sequence = [];
+var saved_settings = {};
 document.addEventListener("DOMContentLoaded", () => {
     getFileList();
     getSettings();
     document.getElementById("update").onclick = updateSettings;
+    document.getElementById("play-sequence").onclick = playSequence;
+    document.getElementById("clear-sequence").onclick = clearSequence;
+    document.getElementById("test-fallback").onclick = function () {
+        let fallback = document.getElementById("fallback").value;
+        if (fallback != "")
+            playSound("synth:" + fallback);
+    };
     vol_slider = document.getElementById("volume");
     vol_display = document.getElementById("volume-val");
     vol_display .innerHTML = vol_slider.value;
@@ -23,12 +32,27 @@ function getSettings() {
             let response = xhr.response;
             console.log(response);
             if (response != null) {
+                saved_settings = response;
                 vol_slider.value = response.volume.toString();
+                if (response.fallback != null) {
+                    let fallback = document.getElementById("fallback");
+                    if (!fallback.querySelector('option[value="' + response.fallback + '"]'))
+                        fallback.innerHTML += '<option value="' + response.fallback + '">Custom</option>';
+                    fallback.value = response.fallback;
+                }
                 vol_display .innerHTML = response.volume;
                 if (response.files.length > 0) {
+                    let urls = [];
                     for (let i = 0; i < response.files.length; i++) {
-                        document.querySelector('.sound-selector[data-name="' + response.files[i] +'"]').checked = true;
+                        if (isRemote(response.files[i])) {
+                            urls.push(response.files[i]);
+                        } else {
+                            let selector = document.querySelector('.sound-selector[data-name="' + response.files[i] +'"]');
+                            if (selector != null)
+                                selector.checked = true;
+                        }
                     }
+                    document.getElementById("remote-chimes").value = urls.join("\n");
                 }
             }
         }
@@ -37,10 +61,12 @@ function getSettings() {
 }
 
 function updateSettings() {
-    let settings = {
+    // Keep settings this page doesn't show, like the cache size
+    let settings = Object.assign({}, saved_settings, {
         volume: document.getElementById("volume").value,
+        fallback: document.getElementById("fallback").value,
         files: []
-    };
+    });
 
     let selected = document.querySelectorAll('.sound-selector:checked');
     if (selected.length > 0) {
@@ -48,9 +74,20 @@ function updateSettings() {
             settings.files.push(selected[i].getAttribute('data-name'));
         }
     }
+    // Remote chimes, one URL per line
+    let urls = document.getElementById("remote-chimes").value.split("\n");
+    for (let i = 0; i < urls.length; i++) {
+        let url = urls[i].trim();
+        if (isRemote(url))
+            settings.files.push(url);
+    }
     sendSettings(JSON.stringify(settings));
 }
 
+function isRemote(sound) {
+    return sound.startsWith("http://") || sound.startsWith("https://");
+}
+
 function sendSettings(settings) {
     let xhr = new XMLHttpRequest(), data = new FormData();
     data.append('settings', settings);
@@ -67,7 +104,10 @@ function sendSettings(settings) {
 
 function playSound(path) {    
     let xhr = new XMLHttpRequest(), data = new FormData();
-    data.append('sound', path);
+    if (path.startsWith("synth:"))
+        data.append('synth', path.substring(6));
+    else
+        data.append('sound', path);
     xhr.open('POST', '/ring');
     xhr.onload = function () {
         if (this.status != 200) {
@@ -79,6 +119,37 @@ function playSound(path) {
     xhr.send(data);    
 }
 
+function addToSequence(path) {
+    sequence.push(path);
+    showSequence();
+}
+
+function clearSequence() {
+    sequence = [];
+    showSequence();
+}
+
+function showSequence() {
+    let names = sequence.map(path => path.substring(path.lastIndexOf("/") + 1));
+    document.getElementById("sequence").innerHTML = names.length > 0 ? names.join(" &rarr; ") : "No chimes added";
+}
+
+function playSequence() {
+    if (sequence.length == 0)
+        return;
+    let xhr = new XMLHttpRequest(), data = new FormData();
+    data.append('sequence', JSON.stringify(sequence));
+    xhr.open('POST', '/ring');
+    xhr.onload = function () {
+        if (this.status != 200) {
+            document.getElementById('message').innerHTML = 'ERROR!';
+        } else {
+            document.getElementById('message').innerHTML = 'Playing sequence';
+        }
+    };
+    xhr.send(data);
+}
+
 function getFileList() {
     let xhr = new XMLHttpRequest();
     xhr.responseType = 'json';
@@ -97,7 +168,9 @@ function getFileList() {
                         <tr class="file">
                             <td><input class="sound-selector" data-name=` + response.files[i] + ` type="checkbox"></td>
                             <td>` + response.files[i].substring(response.files[i].lastIndexOf("/") + 1) + `</td>
+                            <td>` + (response.chimes ? (response.chimes[i].duration / 1000).toFixed(1) + 's' : '') + `</td>
                             <td class="download" onclick="playSound('` + response.files[i] + `')">Play</td>
+                            ` + (response.files[i].endsWith(".chime") ? `<td class="download" onclick="addToSequence('` + response.files[i] + `')">Add</td>` : `<td></td>`) + `
                         </tr>`;
                 }
             }
@@ -58,7 +58,8 @@ document.addEventListener("DOMContentLoaded", () => {
     };
 
     document.getElementById("up-chimes").onclick = function () {
-        uprog.upload('/upload-chimes');
+        let convert = document.getElementById("up-convert").value;
+        uprog.upload(convert == '' ? '/upload-chimes' : '/upload-chimes?convert=' + convert);
     };
 });
 